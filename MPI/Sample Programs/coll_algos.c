@@ -0,0 +1,311 @@
+#include "coll_algos.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define COLL_TAG 77
+
+const char *allreduce_algo_names[ALLREDUCE_NALGOS] = {
+    "mpi", "ring", "recursive_doubling", "rabenseifner", "auto"
+};
+const char *bcast_algo_names[BCAST_NALGOS] = {
+    "mpi", "binomial", "pipelined"
+};
+
+int coll_segment_bytes = COLL_SEGMENT_BYTES;
+
+int coll_find_algo(const char *name, const char **names, int nalgos) {
+    int i;
+    for (i = 0; i < nalgos; i++)
+        if (strcmp(name, names[i]) == 0)
+            return i;
+    return -1;
+}
+
+/* Split `count` elements into `parts` nearly equal contiguous blocks */
+static void split_blocks(int count, int parts, int *cnts, int *displs) {
+    int i, base = count / parts, extra = count % parts;
+    for (i = 0; i < parts; i++) {
+        cnts[i] = base + (i < extra ? 1 : 0);
+        displs[i] = (i == 0) ? 0 : displs[i - 1] + cnts[i - 1];
+    }
+}
+
+/* Largest power of two that is not larger than p */
+static int power_of_two_below(int p) {
+    int pof2 = 1;
+    while (pof2 * 2 <= p)
+        pof2 *= 2;
+    return pof2;
+}
+
+/* Non-power-of-two ranks: the first 2*rem ranks pair up and the even rank of each pair
+   hands its vector to the odd one, leaving pof2 ranks. Returns the rank among those
+   pof2 survivors, or -1 for a rank that dropped out. */
+static int fold_in(void *recvbuf, void *tmp, int count, MPI_Datatype type, MPI_Op op,
+                   MPI_Comm comm, int rank, int rem) {
+    if (rank < 2 * rem) {
+        if (rank % 2 == 0) {
+            MPI_Send(recvbuf, count, type, rank + 1, COLL_TAG, comm);
+            return -1;
+        }
+        MPI_Recv(tmp, count, type, rank - 1, COLL_TAG, comm, MPI_STATUS_IGNORE);
+        MPI_Reduce_local(tmp, recvbuf, count, type, op);
+        return rank / 2;
+    }
+    return rank - rem;
+}
+
+/* Undo fold_in: the odd rank of each pair returns the final result to its partner */
+static void fold_out(void *recvbuf, int count, MPI_Datatype type, MPI_Comm comm, int rank, int rem) {
+    if (rank < 2 * rem) {
+        if (rank % 2 == 1)
+            MPI_Send(recvbuf, count, type, rank - 1, COLL_TAG, comm);
+        else
+            MPI_Recv(recvbuf, count, type, rank + 1, COLL_TAG, comm, MPI_STATUS_IGNORE);
+    }
+}
+
+/* Real rank of a survivor of fold_in */
+static int unfold_rank(int newrank, int rem) {
+    return (newrank < rem) ? newrank * 2 + 1 : newrank + rem;
+}
+
+static int allreduce_ring(void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+    int rank, p, step, send_idx, recv_idx, maxcnt;
+    int *cnts, *displs;
+    MPI_Aint lb, extent;
+    char *buf = (char *)recvbuf, *tmp;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+    MPI_Type_get_extent(type, &lb, &extent);
+
+    cnts = (int *)malloc(2 * p * sizeof(int));
+    displs = cnts + p;
+    split_blocks(count, p, cnts, displs);
+    maxcnt = cnts[0];
+    tmp = (char *)malloc((maxcnt > 0 ? maxcnt : 1) * extent);
+
+    int right = (rank + 1) % p, left = (rank - 1 + p) % p;
+
+    /* Reduce-scatter: after p-1 steps block (rank+1) % p holds the full result */
+    for (step = 0; step < p - 1; step++) {
+        send_idx = (rank - step + p) % p;
+        recv_idx = (rank - step - 1 + p) % p;
+        MPI_Sendrecv(buf + displs[send_idx] * extent, cnts[send_idx], type, right, COLL_TAG,
+                     tmp, cnts[recv_idx], type, left, COLL_TAG, comm, MPI_STATUS_IGNORE);
+        MPI_Reduce_local(tmp, buf + displs[recv_idx] * extent, cnts[recv_idx], type, op);
+    }
+
+    /* Allgather: circulate the reduced blocks around the ring */
+    for (step = 0; step < p - 1; step++) {
+        send_idx = (rank + 1 - step + p) % p;
+        recv_idx = (rank - step + p) % p;
+        MPI_Sendrecv(buf + displs[send_idx] * extent, cnts[send_idx], type, right, COLL_TAG,
+                     buf + displs[recv_idx] * extent, cnts[recv_idx], type, left, COLL_TAG,
+                     comm, MPI_STATUS_IGNORE);
+    }
+
+    free(tmp);
+    free(cnts);
+    return MPI_SUCCESS;
+}
+
+static int allreduce_recursive_doubling(void *recvbuf, int count, MPI_Datatype type, MPI_Op op,
+                                        MPI_Comm comm) {
+    int rank, p, pof2, rem, newrank, mask, dst;
+    MPI_Aint lb, extent;
+    void *tmp;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+    MPI_Type_get_extent(type, &lb, &extent);
+    tmp = malloc((count > 0 ? count : 1) * extent);
+
+    pof2 = power_of_two_below(p);
+    rem = p - pof2;
+    newrank = fold_in(recvbuf, tmp, count, type, op, comm, rank, rem);
+
+    if (newrank != -1) {
+        for (mask = 1; mask < pof2; mask <<= 1) {
+            dst = unfold_rank(newrank ^ mask, rem);
+            MPI_Sendrecv(recvbuf, count, type, dst, COLL_TAG, tmp, count, type, dst, COLL_TAG,
+                         comm, MPI_STATUS_IGNORE);
+            MPI_Reduce_local(tmp, recvbuf, count, type, op);
+        }
+    }
+
+    fold_out(recvbuf, count, type, comm, rank, rem);
+    free(tmp);
+    return MPI_SUCCESS;
+}
+
+static int allreduce_rabenseifner(void *recvbuf, int count, MPI_Datatype type, MPI_Op op,
+                                  MPI_Comm comm) {
+    int rank, p, pof2, rem, newrank, mask, dst, newdst;
+    int lo, hi, mid, send_lo, send_hi, keep_lo, keep_hi, width;
+    int *cnts, *displs;
+    MPI_Aint lb, extent;
+    char *buf = (char *)recvbuf, *tmp;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+    MPI_Type_get_extent(type, &lb, &extent);
+    tmp = (char *)malloc((count > 0 ? count : 1) * extent);
+
+    pof2 = power_of_two_below(p);
+    rem = p - pof2;
+    newrank = fold_in(recvbuf, tmp, count, type, op, comm, rank, rem);
+
+    if (newrank != -1) {
+        cnts = (int *)malloc(2 * pof2 * sizeof(int));
+        displs = cnts + pof2;
+        split_blocks(count, pof2, cnts, displs);
+
+        /* Reduce-scatter by recursive halving: each step exchanges half of the
+           blocks still owned, until block `newrank` alone is left */
+        lo = 0;
+        hi = pof2;
+        for (mask = pof2 / 2; mask > 0; mask >>= 1) {
+            newdst = newrank ^ mask;
+            dst = unfold_rank(newdst, rem);
+            mid = (lo + hi) / 2;
+            if (newrank < newdst) {
+                keep_lo = lo;  keep_hi = mid;
+                send_lo = mid; send_hi = hi;
+            } else {
+                keep_lo = mid; keep_hi = hi;
+                send_lo = lo;  send_hi = mid;
+            }
+            int send_cnt = displs[send_hi - 1] + cnts[send_hi - 1] - displs[send_lo];
+            int keep_cnt = displs[keep_hi - 1] + cnts[keep_hi - 1] - displs[keep_lo];
+            MPI_Sendrecv(buf + displs[send_lo] * extent, send_cnt, type, dst, COLL_TAG,
+                         tmp, keep_cnt, type, dst, COLL_TAG, comm, MPI_STATUS_IGNORE);
+            MPI_Reduce_local(tmp, buf + displs[keep_lo] * extent, keep_cnt, type, op);
+            lo = keep_lo;
+            hi = keep_hi;
+        }
+
+        /* Allgather by recursive doubling: the owned range doubles every step */
+        for (mask = 1; mask < pof2; mask <<= 1) {
+            newdst = newrank ^ mask;
+            dst = unfold_rank(newdst, rem);
+            width = hi - lo;
+            int other_lo = (newrank < newdst) ? hi : lo - width;
+            int other_hi = other_lo + width;
+            int my_cnt = displs[hi - 1] + cnts[hi - 1] - displs[lo];
+            int other_cnt = displs[other_hi - 1] + cnts[other_hi - 1] - displs[other_lo];
+            MPI_Sendrecv(buf + displs[lo] * extent, my_cnt, type, dst, COLL_TAG,
+                         buf + displs[other_lo] * extent, other_cnt, type, dst, COLL_TAG,
+                         comm, MPI_STATUS_IGNORE);
+            if (other_lo < lo) lo = other_lo;
+            if (other_hi > hi) hi = other_hi;
+        }
+        free(cnts);
+    }
+
+    fold_out(recvbuf, count, type, comm, rank, rem);
+    free(tmp);
+    return MPI_SUCCESS;
+}
+
+int coll_allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type,
+                   MPI_Op op, MPI_Comm comm, int algo) {
+    int p, size;
+    MPI_Aint lb, extent;
+
+    if (algo == ALLREDUCE_MPI)
+        return MPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+
+    MPI_Comm_size(comm, &p);
+    MPI_Type_get_extent(type, &lb, &extent);
+    if (sendbuf != MPI_IN_PLACE)
+        memcpy(recvbuf, sendbuf, count * extent);
+    if (p == 1)
+        return MPI_SUCCESS;
+
+    if (algo == ALLREDUCE_AUTO) {
+        MPI_Type_size(type, &size);
+        algo = ((long)count * size <= COLL_SMALL_BYTES || count < p)
+             ? ALLREDUCE_RECURSIVE_DOUBLING : ALLREDUCE_RABENSEIFNER;
+    }
+
+    switch (algo) {
+    case ALLREDUCE_RING:
+        return allreduce_ring(recvbuf, count, type, op, comm);
+    case ALLREDUCE_RECURSIVE_DOUBLING:
+        return allreduce_recursive_doubling(recvbuf, count, type, op, comm);
+    case ALLREDUCE_RABENSEIFNER:
+        return allreduce_rabenseifner(recvbuf, count, type, op, comm);
+    }
+    return MPI_ERR_ARG;
+}
+
+static int bcast_binomial(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    int rank, p, vrank, mask;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+    vrank = (rank - root + p) % p;
+
+    /* Receive from the parent: the rank that differs in the lowest set bit of vrank */
+    mask = 1;
+    while (mask < p) {
+        if (vrank & mask) {
+            MPI_Recv(buf, count, type, (rank - mask + p) % p, COLL_TAG, comm, MPI_STATUS_IGNORE);
+            break;
+        }
+        mask <<= 1;
+    }
+
+    /* Forward to the children below that bit */
+    mask >>= 1;
+    while (mask > 0) {
+        if (vrank + mask < p)
+            MPI_Send(buf, count, type, (rank + mask) % p, COLL_TAG, comm);
+        mask >>= 1;
+    }
+    return MPI_SUCCESS;
+}
+
+static int bcast_pipelined(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    int rank, p, vrank, size, seg, off, n;
+    MPI_Aint lb, extent;
+    MPI_Request sreq = MPI_REQUEST_NULL;
+    char *cbuf = (char *)buf;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+    MPI_Type_get_extent(type, &lb, &extent);
+    MPI_Type_size(type, &size);
+    vrank = (rank - root + p) % p;
+
+    int prev = (rank - 1 + p) % p, next = (rank + 1) % p;
+    seg = coll_segment_bytes / size;
+    if (seg < 1) seg = 1;
+
+    /* Each segment flows down the chain root, root+1, ...; a rank forwards segment i
+       while segment i+1 is still arriving */
+    for (off = 0; off < count; off += seg) {
+        n = (count - off < seg) ? count - off : seg;
+        if (vrank > 0)
+            MPI_Recv(cbuf + off * extent, n, type, prev, COLL_TAG, comm, MPI_STATUS_IGNORE);
+        MPI_Wait(&sreq, MPI_STATUS_IGNORE);
+        if (vrank < p - 1)
+            MPI_Isend(cbuf + off * extent, n, type, next, COLL_TAG, comm, &sreq);
+    }
+    MPI_Wait(&sreq, MPI_STATUS_IGNORE);
+    return MPI_SUCCESS;
+}
+
+int coll_bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, int algo) {
+    switch (algo) {
+    case BCAST_MPI:
+        return MPI_Bcast(buf, count, type, root, comm);
+    case BCAST_BINOMIAL:
+        return bcast_binomial(buf, count, type, root, comm);
+    case BCAST_PIPELINED:
+        return bcast_pipelined(buf, count, type, root, comm);
+    }
+    return MPI_ERR_ARG;
+}
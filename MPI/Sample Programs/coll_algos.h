@@ -0,0 +1,50 @@
+#ifndef COLL_ALGOS_H
+#define COLL_ALGOS_H
+
+#include "mpi.h"
+
+/*
+ * Hand-written collective algorithms built only on point-to-point routines.
+ * Every routine has the same argument list as its MPI counterpart plus an
+ * algorithm selector, so callers can switch algorithms at runtime and compare
+ * them against the library's own implementation (the *_MPI entries).
+ *
+ * The reductions call MPI_Reduce_local, so any predefined datatype and
+ * operation works. The operation must be commutative, and the datatype must
+ * be contiguous (MPI_DOUBLE, MPI_INT, ...).
+ */
+
+typedef enum {
+    ALLREDUCE_MPI,                  /* MPI_Allreduce from the library */
+    ALLREDUCE_RING,                 /* ring reduce-scatter + ring allgather */
+    ALLREDUCE_RECURSIVE_DOUBLING,   /* log(p) exchanges of the full vector */
+    ALLREDUCE_RABENSEIFNER,         /* recursive-halving reduce-scatter + recursive-doubling allgather */
+    ALLREDUCE_AUTO,                 /* recursive doubling for small vectors, Rabenseifner for large */
+    ALLREDUCE_NALGOS
+} allreduce_algo;
+
+typedef enum {
+    BCAST_MPI,                      /* MPI_Bcast from the library */
+    BCAST_BINOMIAL,                 /* binomial tree, whole message per edge */
+    BCAST_PIPELINED,                /* chain of ranks, message split into segments */
+    BCAST_NALGOS
+} bcast_algo;
+
+extern const char *allreduce_algo_names[ALLREDUCE_NALGOS];
+extern const char *bcast_algo_names[BCAST_NALGOS];
+
+/* Vectors at or below this many bytes count as "small" for ALLREDUCE_AUTO */
+#define COLL_SMALL_BYTES     8192
+/* Default segment size of the pipelined broadcast */
+#define COLL_SEGMENT_BYTES   65536
+
+extern int coll_segment_bytes;
+
+/* Look up an algorithm by name; returns -1 if `name` is not in `names` */
+int coll_find_algo(const char *name, const char **names, int nalgos);
+
+int coll_allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type,
+                   MPI_Op op, MPI_Comm comm, int algo);
+int coll_bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, int algo);
+
+#endif
@@ -0,0 +1,235 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coll_algos.h"
+
+#define  MASTER       0
+#define  MAX_BYTES    (16 * 1024 * 1024)   /* Largest per-rank vector in the sweep */
+#define  ITERATIONS   200                  /* Repetitions for small vectors */
+#define  WARMUP       5
+
+enum { OP_BCAST, OP_REDUCE, OP_ALLREDUCE, OP_ALLTOALL, OP_SCAN };
+
+double *sendbuf, *recvbuf, *checkbuf;
+
+int iterations_for(long bytes, int iters) {
+    long n = (bytes <= 16384) ? iters : (long)iters * 16384 / bytes;
+    return (n < 5) ? 5 : (int)n;
+}
+
+/* Integer-valued data so every summation order gives the same exact result */
+void fill(double *buf, int count, int rank) {
+    int i;
+    for (i = 0; i < count; i++)
+        buf[i] = (double)((rank + 1) * (i % 13 + 1));
+}
+
+void run_once(int op, int algo, int count, MPI_Comm comm) {
+    int p;
+    MPI_Comm_size(comm, &p);
+
+    switch (op) {
+    case OP_BCAST:
+        coll_bcast(recvbuf, count, MPI_DOUBLE, MASTER, comm, algo);
+        break;
+    case OP_REDUCE:
+        MPI_Reduce(sendbuf, recvbuf, count, MPI_DOUBLE, MPI_SUM, MASTER, comm);
+        break;
+    case OP_ALLREDUCE:
+        coll_allreduce(sendbuf, recvbuf, count, MPI_DOUBLE, MPI_SUM, comm, algo);
+        break;
+    case OP_ALLTOALL:
+        MPI_Alltoall(sendbuf, count / p, MPI_DOUBLE, recvbuf, count / p, MPI_DOUBLE, comm);
+        break;
+    case OP_SCAN:
+        MPI_Scan(sendbuf, recvbuf, count, MPI_DOUBLE, MPI_SUM, comm);
+        break;
+    }
+}
+
+/* Average time of one call, taken as the maximum over all ranks of `comm` */
+double time_op(int op, int algo, int count, int iters, MPI_Comm comm) {
+    double t, tmax;
+    int i;
+
+    for (i = 0; i < WARMUP; i++)
+        run_once(op, algo, count, comm);
+    MPI_Barrier(comm);
+    t = MPI_Wtime();
+    for (i = 0; i < iters; i++)
+        run_once(op, algo, count, comm);
+    t = (MPI_Wtime() - t) / iters;
+    MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return tmax;
+}
+
+/* Check a hand-written algorithm against the library collective; returns 1 if they agree */
+int verify(int op, int algo, int count, MPI_Comm comm) {
+    int rank, ok, all_ok;
+
+    MPI_Comm_rank(comm, &rank);
+    fill(sendbuf, count, rank);
+    if (op == OP_BCAST) {
+        fill(recvbuf, count, rank);
+        fill(checkbuf, count, MASTER);
+        coll_bcast(recvbuf, count, MPI_DOUBLE, MASTER, comm, algo);
+    } else {
+        MPI_Allreduce(sendbuf, checkbuf, count, MPI_DOUBLE, MPI_SUM, comm);
+        coll_allreduce(sendbuf, recvbuf, count, MPI_DOUBLE, MPI_SUM, comm, algo);
+    }
+    ok = (memcmp(recvbuf, checkbuf, count * sizeof(double)) == 0);
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    return all_ok;
+}
+
+void sweep(MPI_Comm comm, long max_bytes, int base_iters, int only_allreduce) {
+    int rank, p, count, iters, algo, best;
+    long bytes;
+    double t[ALLREDUCE_NALGOS];
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+
+    if (rank == MASTER) {
+        printf("\n==================== %d ranks ====================\n", p);
+        printf("Library collectives, time per call (us):\n");
+        printf("%12s %12s %12s %12s %12s %12s\n", "Bytes", "Bcast", "Reduce", "Allreduce",
+               "Alltoall", "Scan");
+    }
+    for (bytes = 8; bytes <= max_bytes; bytes *= 2) {
+        count = bytes / sizeof(double);
+        iters = iterations_for(bytes, base_iters);
+        fill(sendbuf, count, rank);
+        double tb = time_op(OP_BCAST, BCAST_MPI, count, iters, comm);
+        double tr = time_op(OP_REDUCE, 0, count, iters, comm);
+        double ta = time_op(OP_ALLREDUCE, ALLREDUCE_MPI, count, iters, comm);
+        double tt = (count >= p) ? time_op(OP_ALLTOALL, 0, count, iters, comm) : 0.0;
+        double ts = time_op(OP_SCAN, 0, count, iters, comm);
+        if (rank == MASTER) {
+            printf("%12ld %12.2f %12.2f %12.2f ", bytes, tb * 1e6, tr * 1e6, ta * 1e6);
+            if (count >= p) printf("%12.2f ", tt * 1e6);
+            else printf("%12s ", "-");
+            printf("%12.2f\n", ts * 1e6);
+        }
+    }
+
+    if (rank == MASTER) {
+        printf("\nAllreduce algorithms, time per call (us):\n");
+        printf("%12s", "Bytes");
+        for (algo = 0; algo < ALLREDUCE_NALGOS; algo++)
+            if (only_allreduce < 0 || algo == only_allreduce || algo == ALLREDUCE_MPI)
+                printf(" %19s", allreduce_algo_names[algo]);
+        printf("  %s\n", "fastest");
+    }
+    for (bytes = 8; bytes <= max_bytes; bytes *= 2) {
+        count = bytes / sizeof(double);
+        iters = iterations_for(bytes, base_iters);
+        best = ALLREDUCE_MPI;
+        for (algo = 0; algo < ALLREDUCE_NALGOS; algo++) {
+            t[algo] = -1.0;
+            if (only_allreduce >= 0 && algo != only_allreduce && algo != ALLREDUCE_MPI)
+                continue;
+            if (!verify(OP_ALLREDUCE, algo, count, comm)) {
+                if (rank == MASTER)
+                    printf("ERROR: %s allreduce gave a wrong result for %ld bytes\n",
+                           allreduce_algo_names[algo], bytes);
+                continue;
+            }
+            t[algo] = time_op(OP_ALLREDUCE, algo, count, iters, comm);
+            if (t[algo] < t[best])
+                best = algo;
+        }
+        if (rank == MASTER) {
+            printf("%12ld", bytes);
+            for (algo = 0; algo < ALLREDUCE_NALGOS; algo++)
+                if (only_allreduce < 0 || algo == only_allreduce || algo == ALLREDUCE_MPI)
+                    printf(" %19.2f", t[algo] * 1e6);
+            printf("  %s\n", allreduce_algo_names[best]);
+        }
+    }
+
+    if (rank == MASTER) {
+        printf("\nBcast algorithms, time per call (us):\n");
+        printf("%12s", "Bytes");
+        for (algo = 0; algo < BCAST_NALGOS; algo++)
+            printf(" %12s", bcast_algo_names[algo]);
+        printf("  %s\n", "fastest");
+    }
+    for (bytes = 8; bytes <= max_bytes; bytes *= 2) {
+        count = bytes / sizeof(double);
+        iters = iterations_for(bytes, base_iters);
+        best = BCAST_MPI;
+        for (algo = 0; algo < BCAST_NALGOS; algo++) {
+            t[algo] = -1.0;
+            if (!verify(OP_BCAST, algo, count, comm)) {
+                if (rank == MASTER)
+                    printf("ERROR: %s bcast gave a wrong result for %ld bytes\n",
+                           bcast_algo_names[algo], bytes);
+                continue;
+            }
+            t[algo] = time_op(OP_BCAST, algo, count, iters, comm);
+            if (t[algo] < t[best])
+                best = algo;
+        }
+        if (rank == MASTER) {
+            printf("%12ld", bytes);
+            for (algo = 0; algo < BCAST_NALGOS; algo++)
+                printf(" %12.2f", t[algo] * 1e6);
+            printf("  %s\n", bcast_algo_names[best]);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int numtasks, rank, nranks;
+    long max_bytes = (argc > 1) ? atol(argv[1]) : MAX_BYTES;
+    int base_iters = (argc > 2) ? atoi(argv[2]) : ITERATIONS;
+    int only_allreduce = -1;
+    MPI_Comm comm;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    /* Optional third argument restricts the allreduce sweep to one algorithm (plus MPI) */
+    if (argc > 3) {
+        only_allreduce = coll_find_algo(argv[3], allreduce_algo_names, ALLREDUCE_NALGOS);
+        if (only_allreduce < 0) {
+            if (rank == MASTER)
+                printf("Unknown allreduce algorithm '%s'\n", argv[3]);
+            MPI_Finalize();
+            exit(0);
+        }
+    }
+
+    sendbuf = (double *)malloc(max_bytes);
+    recvbuf = (double *)malloc(max_bytes);
+    checkbuf = (double *)malloc(max_bytes);
+    if (!sendbuf || !recvbuf || !checkbuf) {
+        printf("Task %d: could not allocate %ld byte buffers\n", rank, max_bytes);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    memset(recvbuf, 0, max_bytes);
+    memset(checkbuf, 0, max_bytes);
+
+    /* Sweep rank counts 2, 4, 8, ... and finally all tasks */
+    for (nranks = 2; ; nranks *= 2) {
+        if (nranks > numtasks)
+            nranks = numtasks;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < nranks ? 0 : MPI_UNDEFINED, rank, &comm);
+        if (comm != MPI_COMM_NULL) {
+            sweep(comm, max_bytes, base_iters, only_allreduce);
+            MPI_Comm_free(&comm);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (nranks == numtasks)
+            break;
+    }
+
+    free(sendbuf);
+    free(recvbuf);
+    free(checkbuf);
+    MPI_Finalize();
+    return 0;
+}
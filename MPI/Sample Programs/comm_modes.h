@@ -0,0 +1,275 @@
+#ifndef COMM_MODES_H
+#define COMM_MODES_H
+
+#include "mpi.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/*
+ * The same repeated neighbour exchange done four ways, selected at run time, so an
+ * application can switch modes and compare them.
+ *
+ *   NeighborExchange ex(comm, COMM_PERSISTENT);
+ *   ex.add_send(next, sbuf, n, MPI_DOUBLE, RIGHT);    data for `next`, tagged RIGHT
+ *   ex.add_recv(prev, rbuf, n, MPI_DOUBLE, RIGHT);    data from `prev`, tagged RIGHT
+ *   ex.commit();                                      collective over comm
+ *   for (...) { fill sbuf; ex.exchange(); use rbuf; }
+ *
+ * A send and a receive match when they name each other's rank and the same tag. No two
+ * channels of one direction may share both peer and tag. Sends and receives to
+ * MPI_PROC_NULL are dropped. The buffers stay registered from commit() until the object
+ * is destroyed, which is collective too. When exchange() returns, every receive buffer
+ * holds its data and every send buffer may be reused.
+ *
+ *   COMM_ISEND          fresh MPI_Irecv / MPI_Isend for every exchange, then MPI_Waitall;
+ *                       what non_blocking_pass.c and the stencil do
+ *   COMM_PERSISTENT     MPI_Recv_init / MPI_Send_init once, MPI_Startall per exchange;
+ *                       the argument checking and matching setup are paid once
+ *   COMM_RMA_LOCK_ALL   the receive buffers are attached to a dynamic window that stays
+ *                       under MPI_Win_lock_all. A receiver tells each sender that its
+ *                       buffer is free; the sender then MPI_Puts, flushes, and raises the
+ *                       receiver's arrival counter. The counters live in a second window
+ *                       and are set with MPI_Accumulate and read with MPI_Fetch_and_op.
+ *   COMM_RMA_PSCW       MPI_Puts into the same dynamic window inside a general active
+ *                       target epoch: MPI_Win_post to the ranks that send here,
+ *                       MPI_Win_start to the ranks sent to, then complete and wait
+ *
+ * The RMA modes put with the sender's count and type at the receiver's address, so a
+ * receive must use the same count and type as its matching send. A DatatypeCache type
+ * for the same shape of piece works on both sides.
+ */
+
+enum CommMode { COMM_ISEND, COMM_PERSISTENT, COMM_RMA_LOCK_ALL, COMM_RMA_PSCW, COMM_NMODES };
+
+static const char *comm_mode_names[COMM_NMODES] = {"Isend/Irecv", "persistent", "Put+lock_all", "Put+PSCW"};
+
+class NeighborExchange {
+public:
+    NeighborExchange(MPI_Comm comm, CommMode mode) : mode(mode) {
+        MPI_Comm_dup(comm, &this->comm);
+        MPI_Comm_rank(this->comm, &rank);
+    }
+
+    NeighborExchange(const NeighborExchange &) = delete;
+    NeighborExchange &operator=(const NeighborExchange &) = delete;
+
+    ~NeighborExchange() {
+        for (MPI_Request &r : persistent)
+            MPI_Request_free(&r);
+        if (data_win != MPI_WIN_NULL) {
+            if (mode == COMM_RMA_LOCK_ALL) {
+                MPI_Win_unlock_all(data_win);
+                MPI_Win_unlock_all(flag_win);
+                MPI_Win_free(&flag_win);
+            }
+            for (const std::pair<MPI_Aint, MPI_Aint> &r : attached)
+                MPI_Win_detach(data_win, (void *)r.first);
+            MPI_Win_free(&data_win);
+        }
+        if (sources != MPI_GROUP_NULL) {
+            MPI_Group_free(&sources);
+            MPI_Group_free(&targets);
+        }
+        MPI_Comm_free(&comm);
+    }
+
+    void add_send(int peer, const void *buf, int count, MPI_Datatype type, int tag) {
+        if (peer != MPI_PROC_NULL)
+            sends.push_back({peer, (void *)buf, count, type, tag, 0, 0});
+    }
+
+    void add_recv(int peer, void *buf, int count, MPI_Datatype type, int tag) {
+        if (peer != MPI_PROC_NULL)
+            recvs.push_back({peer, buf, count, type, tag, 0, 0});
+    }
+
+    void commit() {
+        if (mode == COMM_PERSISTENT) {
+            persistent.resize(recvs.size() + sends.size());
+            int i = 0;
+            for (Channel &c : recvs)
+                MPI_Recv_init(c.buf, c.count, c.type, c.peer, c.tag, comm, &persistent[i++]);
+            for (Channel &c : sends)
+                MPI_Send_init(c.buf, c.count, c.type, c.peer, c.tag, comm, &persistent[i++]);
+        } else if (mode == COMM_RMA_LOCK_ALL || mode == COMM_RMA_PSCW) {
+            setup_rma();
+        }
+    }
+
+    void exchange() {
+        switch (mode) {
+        case COMM_ISEND: {
+            std::vector<MPI_Request> req(recvs.size() + sends.size());
+            int i = 0;
+            for (Channel &c : recvs)
+                MPI_Irecv(c.buf, c.count, c.type, c.peer, c.tag, comm, &req[i++]);
+            for (Channel &c : sends)
+                MPI_Isend(c.buf, c.count, c.type, c.peer, c.tag, comm, &req[i++]);
+            MPI_Waitall(req.size(), req.data(), MPI_STATUSES_IGNORE);
+            break;
+        }
+        case COMM_PERSISTENT:
+            MPI_Startall(persistent.size(), persistent.data());
+            MPI_Waitall(persistent.size(), persistent.data(), MPI_STATUSES_IGNORE);
+            break;
+        case COMM_RMA_LOCK_ALL:
+            exchange_lock_all();
+            break;
+        case COMM_RMA_PSCW:
+            if (!recvs.empty())
+                MPI_Win_post(sources, 0, data_win);
+            if (!sends.empty()) {
+                MPI_Win_start(targets, 0, data_win);
+                for (Channel &c : sends)
+                    MPI_Put(c.buf, c.count, c.type, c.peer, c.disp, c.count, c.type, data_win);
+                MPI_Win_complete(data_win);
+            }
+            if (!recvs.empty())
+                MPI_Win_wait(data_win);
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    /* disp: for a send, the receive buffer's address at the peer. slot: the counter this
+       channel raises at the peer, ready for a receive and arrived for a send. */
+    struct Channel {
+        int peer;
+        void *buf;
+        int count;
+        MPI_Datatype type;
+        int tag;
+        MPI_Aint disp;
+        MPI_Aint slot;
+    };
+
+    CommMode mode;
+    MPI_Comm comm;
+    int rank;
+    std::vector<Channel> sends, recvs;
+    std::vector<MPI_Request> persistent;
+    MPI_Win data_win = MPI_WIN_NULL, flag_win = MPI_WIN_NULL;
+    MPI_Group sources = MPI_GROUP_NULL, targets = MPI_GROUP_NULL;
+    std::vector<std::pair<MPI_Aint, MPI_Aint>> attached;   /* address, bytes */
+    long generation = 0;
+
+    /* Counter `slot` of this rank; slots [0, sends) are ready flags, the rest arrivals */
+    long read_flag(int slot) {
+        long v;
+        MPI_Fetch_and_op(nullptr, &v, MPI_LONG, rank, slot, MPI_NO_OP, flag_win);
+        MPI_Win_flush(rank, flag_win);
+        return v;
+    }
+
+    void raise_flag(int peer, MPI_Aint slot) {
+        MPI_Accumulate(&generation, 1, MPI_LONG, peer, slot, 1, MPI_LONG, MPI_REPLACE, flag_win);
+    }
+
+    void exchange_lock_all() {
+        generation++;
+        for (Channel &c : recvs)
+            raise_flag(c.peer, c.slot);
+        MPI_Win_flush_all(flag_win);
+        for (size_t s = 0; s < sends.size(); s++) {
+            while (read_flag(s) < generation)
+                ;
+            Channel &c = sends[s];
+            MPI_Put(c.buf, c.count, c.type, c.peer, c.disp, c.count, c.type, data_win);
+        }
+        MPI_Win_flush_all(data_win);
+        for (Channel &c : sends)
+            raise_flag(c.peer, c.slot);
+        MPI_Win_flush_all(flag_win);
+        for (size_t r = 0; r < recvs.size(); r++)
+            while (read_flag(sends.size() + r) < generation)
+                ;
+        MPI_Win_sync(data_win);
+    }
+
+    /* Attach the receive buffers, tell every sender where its data goes and which arrival
+       counter to raise, and every receiver which ready counter to raise */
+    void setup_rma() {
+        MPI_Win_create_dynamic(MPI_INFO_NULL, comm, &data_win);
+
+        /* Buffers of derived types may interleave (two columns of one array), and
+           attached regions may not overlap, so attach their merged extents */
+        std::vector<std::pair<MPI_Aint, MPI_Aint>> spans;
+        for (Channel &c : recvs) {
+            MPI_Aint lb, extent, tlb, textent, base;
+            MPI_Type_get_extent(c.type, &lb, &extent);
+            MPI_Type_get_true_extent(c.type, &tlb, &textent);
+            MPI_Get_address(c.buf, &base);
+            if (c.count > 0)
+                spans.push_back({base + tlb, base + tlb + (c.count - 1) * extent + textent});
+        }
+        std::sort(spans.begin(), spans.end());
+        for (const std::pair<MPI_Aint, MPI_Aint> &s : spans) {
+            if (!attached.empty() && s.first <= attached.back().first + attached.back().second)
+                attached.back().second = std::max(attached.back().second, s.second - attached.back().first);
+            else
+                attached.push_back({s.first, s.second - s.first});
+        }
+        for (const std::pair<MPI_Aint, MPI_Aint> &a : attached)
+            MPI_Win_attach(data_win, (void *)a.first, a.second);
+
+        std::vector<MPI_Request> req;
+        std::vector<MPI_Aint> out(3 * recvs.size() + sends.size()), in(2 * sends.size() + recvs.size());
+        for (size_t r = 0; r < recvs.size(); r++) {
+            MPI_Get_address(recvs[r].buf, &out[2 * r]);
+            out[2 * r + 1] = sends.size() + r;
+            req.emplace_back();
+            MPI_Isend(&out[2 * r], 2, MPI_AINT, recvs[r].peer, 2 * recvs[r].tag, comm, &req.back());
+        }
+        for (size_t s = 0; s < sends.size(); s++) {
+            out[2 * recvs.size() + s] = s;
+            req.emplace_back();
+            MPI_Isend(&out[2 * recvs.size() + s], 1, MPI_AINT, sends[s].peer, 2 * sends[s].tag + 1, comm,
+                      &req.back());
+            req.emplace_back();
+            MPI_Irecv(&in[2 * s], 2, MPI_AINT, sends[s].peer, 2 * sends[s].tag, comm, &req.back());
+        }
+        for (size_t r = 0; r < recvs.size(); r++) {
+            req.emplace_back();
+            MPI_Irecv(&in[2 * sends.size() + r], 1, MPI_AINT, recvs[r].peer, 2 * recvs[r].tag + 1, comm,
+                      &req.back());
+        }
+        MPI_Waitall(req.size(), req.data(), MPI_STATUSES_IGNORE);
+        for (size_t s = 0; s < sends.size(); s++) {
+            sends[s].disp = in[2 * s];
+            sends[s].slot = in[2 * s + 1];
+        }
+        for (size_t r = 0; r < recvs.size(); r++)
+            recvs[r].slot = in[2 * sends.size() + r];
+
+        if (mode == COMM_RMA_LOCK_ALL) {
+            long *flags;
+            long nflags = sends.size() + recvs.size();
+            MPI_Win_allocate(std::max(1L, nflags) * sizeof(long), sizeof(long), MPI_INFO_NULL, comm,
+                             &flags, &flag_win);
+            std::fill(flags, flags + nflags, 0L);
+            MPI_Win_lock_all(MPI_MODE_NOCHECK, flag_win);
+            MPI_Win_lock_all(MPI_MODE_NOCHECK, data_win);
+            MPI_Win_sync(flag_win);
+            MPI_Barrier(comm);
+        } else {
+            MPI_Group all;
+            MPI_Comm_group(comm, &all);
+            auto group_of = [&](const std::vector<Channel> &chans, MPI_Group *g) {
+                std::vector<int> peers;
+                for (const Channel &c : chans)
+                    peers.push_back(c.peer);
+                std::sort(peers.begin(), peers.end());
+                peers.erase(std::unique(peers.begin(), peers.end()), peers.end());
+                MPI_Group_incl(all, peers.size(), peers.data(), g);
+            };
+            group_of(recvs, &sources);
+            group_of(sends, &targets);
+            MPI_Group_free(&all);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "comm_modes.h"
+#include "mpi_types.h"
+
+#define  MASTER      0
+#define  ITERATIONS  2000        /* Exchanges timed for the smallest messages */
+#define  TARGET      (256 << 20) /* Bytes per rank that set the exchanges for larger ones */
+#define  WARMUP      10
+
+using namespace std;
+
+/*
+ * The four modes of comm_modes.h on two repeated exchanges:
+ *
+ *   ring   every task sends a buffer to the next task and receives one from the
+ *          previous, as non_blocking_pass.c does with one int
+ *   halo   a periodic 2D grid of tasks, each with an n x n block and a one-cell halo;
+ *          rows go as contiguous doubles and columns as a DatatypeCache column type,
+ *          straight from and into the block
+ *
+ * Every exchange carries new data, and every received value is checked. Only the
+ * exchanges are timed; the times are the average per exchange of the slowest task.
+ */
+
+enum { TO_NORTH, TO_SOUTH, TO_WEST, TO_EAST, RIGHT };
+
+int iterations_for(double bytes) {
+    return max(20, (int)min((double)ITERATIONS, TARGET / max(bytes, 1.0)));
+}
+
+/* Time `iters` exchanges; fill(it) writes the data of exchange `it`, check(it) counts
+   the wrong values received */
+template <typename Fill, typename Check>
+double run(NeighborExchange &ex, int iters, Fill fill, Check check, long &wrong) {
+    double t = 0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int it = -WARMUP; it < iters; it++) {
+        fill(it);
+        double t0 = MPI_Wtime();
+        ex.exchange();
+        if (it >= 0)
+            t += MPI_Wtime() - t0;
+        wrong += check(it);
+    }
+    t /= iters;
+    double tmax;
+    MPI_Reduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+    return tmax;
+}
+
+double value(int rank, long i, int it) {
+    return rank * 1e9 + i * 1e3 + it;
+}
+
+double ring(CommMode mode, long n, long &wrong) {
+    int rank, p;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+    int next = (rank + 1) % p, prev = (rank + p - 1) % p;
+    vector<double> sbuf(n), rbuf(n);
+    NeighborExchange ex(MPI_COMM_WORLD, mode);
+    ex.add_send(next, sbuf.data(), n, MPI_DOUBLE, RIGHT);
+    ex.add_recv(prev, rbuf.data(), n, MPI_DOUBLE, RIGHT);
+    ex.commit();
+    return run(ex, iterations_for(n * 8.0), [&](int it) {
+        for (long i = 0; i < n; i++)
+            sbuf[i] = value(rank, i, it);
+    }, [&](int it) {
+        long bad = 0;
+        for (long i = 0; i < n; i++)
+            bad += rbuf[i] != value(prev, i, it);
+        return bad;
+    }, wrong);
+}
+
+double halo(CommMode mode, int n, long &wrong) {
+    int p, rank, dims[2] = {0, 0}, periods[2] = {1, 1}, north, south, west, east;
+    MPI_Comm cart;
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+    MPI_Dims_create(p, 2, dims);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &cart);
+    MPI_Comm_rank(cart, &rank);
+    MPI_Cart_shift(cart, 0, 1, &north, &south);
+    MPI_Cart_shift(cart, 1, 1, &west, &east);
+
+    long ld = n + 2;
+    vector<double> u(ld * ld, 0.0);
+    DatatypeCache types;
+    MPI_Datatype col = types.column(n, ld);
+    double *a = u.data();
+    NeighborExchange ex(cart, mode);
+    ex.add_send(north, a + ld + 1, n, MPI_DOUBLE, TO_NORTH);
+    ex.add_send(south, a + n * ld + 1, n, MPI_DOUBLE, TO_SOUTH);
+    ex.add_send(west, a + ld + 1, 1, col, TO_WEST);
+    ex.add_send(east, a + ld + n, 1, col, TO_EAST);
+    ex.add_recv(north, a + 1, n, MPI_DOUBLE, TO_SOUTH);
+    ex.add_recv(south, a + (n + 1) * ld + 1, n, MPI_DOUBLE, TO_NORTH);
+    ex.add_recv(west, a + ld, 1, col, TO_EAST);
+    ex.add_recv(east, a + ld + n + 1, 1, col, TO_WEST);
+    ex.commit();
+
+    /* Interior point (i, j), 1-based, holds value(rank, i * ld + j, it); only the edge
+       points are sent, so only they are written */
+    double t = run(ex, iterations_for(4.0 * n * 8), [&](int it) {
+        for (long x = 1; x <= n; x++) {
+            a[ld + x] = value(rank, ld + x, it);
+            a[n * ld + x] = value(rank, n * ld + x, it);
+            a[x * ld + 1] = value(rank, x * ld + 1, it);
+            a[x * ld + n] = value(rank, x * ld + n, it);
+        }
+    }, [&](int it) {
+        long bad = 0;
+        for (long x = 1; x <= n; x++) {
+            bad += a[x] != value(north, n * ld + x, it);
+            bad += a[(n + 1) * ld + x] != value(south, ld + x, it);
+            bad += a[x * ld] != value(west, x * ld + n, it);
+            bad += a[x * ld + n + 1] != value(east, x * ld + 1, it);
+        }
+        return bad;
+    }, wrong);
+    MPI_Comm_free(&cart);
+    return t;
+}
+
+int main(int argc, char *argv[]) {
+    int rank, numtasks;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    if (rank == MASTER) {
+        printf("Microseconds per exchange, %d tasks\n", numtasks);
+        printf("  %-6s %10s", "test", "bytes/msg");
+        for (int m = 0; m < COMM_NMODES; m++)
+            printf(" %13s", comm_mode_names[m]);
+        printf("   correct\n");
+    }
+    for (int test = 0; test < 2; test++) {
+        const long sizes[2][4] = {{1, 64, 4096, 131072}, {8, 64, 512, 2048}};
+        for (int s = 0; s < 4; s++) {
+            long n = sizes[test][s];
+            double t[COMM_NMODES];
+            long wrong = 0, all;
+            for (int m = 0; m < COMM_NMODES; m++)
+                t[m] = test == 0 ? ring((CommMode)m, n, wrong) : halo((CommMode)m, n, wrong);
+            MPI_Reduce(&wrong, &all, 1, MPI_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+            if (rank == MASTER) {
+                printf("  %-6s %10ld", test == 0 ? "ring" : "halo", n * 8);
+                for (int m = 0; m < COMM_NMODES; m++)
+                    printf(" %13.2f", t[m] * 1e6);
+                printf("   %s\n", all ? "NO" : "yes");
+            }
+        }
+    }
+    MPI_Finalize();
+    return 0;
+}
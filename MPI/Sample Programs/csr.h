@@ -0,0 +1,114 @@
+#ifndef CSR_H
+#define CSR_H
+
+#include <omp.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/*
+ * The CSR part of the OpenMP sparse matrix-vector library (OpenMP/SamplePrograms/spmv.h),
+ * copied here so that the MPI programs build on their own: triplet and CSR storage, the
+ * conversion between them, and y = A * x with threads taking rows that hold about the
+ * same number of nonzeros.
+ */
+
+/* Coordinate (triplet) form; indices are 0-based */
+struct Coo {
+    int nrows = 0, ncols = 0;
+    std::vector<int> row, col;
+    std::vector<double> val;
+};
+
+struct Csr {
+    int nrows = 0, ncols = 0;
+    std::vector<long> rowptr;   /* nrows + 1 */
+    std::vector<int> col;
+    std::vector<double> val;
+    std::vector<int> part;      /* row bounds per thread, balanced by nonzeros */
+};
+
+/* Split rows [0, nrows) into `parts` ranges of about equal cost, where a row costs its
+   number of entries plus one (the row itself: loading rowptr and storing y) */
+inline std::vector<int> partition_by_nnz(const std::vector<long> &ptr, int nrows, int parts) {
+    std::vector<int> bounds(parts + 1, nrows);
+    long total = ptr[nrows] + nrows;
+    bounds[0] = 0;
+    for (int t = 1; t < parts; t++) {
+        long target = total * t / parts;
+        int lo = bounds[t - 1], hi = nrows;
+        while (lo < hi) {               /* first row r with ptr[r] + r >= target */
+            int mid = lo + (hi - lo) / 2;
+            if (ptr[mid] + mid < target)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        bounds[t] = lo;
+    }
+    return bounds;
+}
+
+/* COO -> CSR by counting sort on rows; columns are sorted within each row */
+inline void coo_to_csr(const Coo &a, Csr &m) {
+    long nnz = a.val.size();
+    m.nrows = a.nrows;
+    m.ncols = a.ncols;
+    m.rowptr.assign(a.nrows + 1, 0);
+    m.col.resize(nnz);
+    m.val.resize(nnz);
+    for (long e = 0; e < nnz; e++)
+        m.rowptr[a.row[e] + 1]++;
+    for (int i = 0; i < a.nrows; i++)
+        m.rowptr[i + 1] += m.rowptr[i];
+    std::vector<long> next(m.rowptr.begin(), m.rowptr.end() - 1);
+    for (long e = 0; e < nnz; e++) {
+        long k = next[a.row[e]]++;
+        m.col[k] = a.col[e];
+        m.val[k] = a.val[e];
+    }
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < m.nrows; i++) {
+        long b = m.rowptr[i], len = m.rowptr[i + 1] - b;
+        std::vector<std::pair<int, double>> r(len);
+        for (long k = 0; k < len; k++)
+            r[k] = std::make_pair(m.col[b + k], m.val[b + k]);
+        std::sort(r.begin(), r.end(),
+                  [](const std::pair<int, double> &p, const std::pair<int, double> &q) {
+                      return p.first < q.first;
+                  });
+        for (long k = 0; k < len; k++) {
+            m.col[b + k] = r[k].first;
+            m.val[b + k] = r[k].second;
+        }
+    }
+    m.part = partition_by_nnz(m.rowptr, m.nrows, omp_get_max_threads());
+}
+
+/* Sparse dot product of one CSR row with x */
+inline double csr_row_dot(const long *rowptr, const int *col, const double *val,
+                          const double *x, int i) {
+    double sum = 0.0;
+    #pragma omp simd reduction(+ : sum)
+    for (long k = rowptr[i]; k < rowptr[i + 1]; k++)
+        sum += val[k] * x[col[k]];
+    return sum;
+}
+
+/* y = A * x, every thread taking rows holding the same number of nonzeros */
+inline void spmv_csr(const Csr &m, const double *x, double *y) {
+    const long *rowptr = m.rowptr.data();
+    const int *col = m.col.data();
+    const double *val = m.val.data();
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        int r0 = m.part[(long)t * (m.part.size() - 1) / nt];
+        int r1 = m.part[(long)(t + 1) * (m.part.size() - 1) / nt];
+        for (int i = r0; i < r1; i++)
+            y[i] = csr_row_dot(rowptr, col, val, x, i);
+    }
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "mpi_types.h"
+
+#define  NX3D     200     /* Default interior points per axis of the 3D array */
+#define  NX2D     4096    /* Default order of the matrix */
+#define  TARGET   (64 << 20)   /* Bytes moved per timing, which sets the repetitions */
+
+using namespace std;
+
+/*
+ * Ping-pong between tasks 0 and 1 of strided pieces of arrays: the three halo faces of a
+ * 3D array with a one-cell halo, and a column and a quarter block of a matrix. Each piece
+ * goes three ways:
+ *
+ *   contiguous     the same number of doubles from a contiguous buffer, the upper bound
+ *   pack loop      copied into a contiguous buffer, sent, and copied out on the other side
+ *   derived type   sent and received in place with a type from DatatypeCache
+ *
+ * Every way is checked once: the receiver's array must hold the sender's values exactly
+ * where the piece lies and nothing anywhere else. The last lines compare building and
+ * freeing a type each time with looking it up in the cache.
+ */
+
+/* A strided piece: counts and element strides of three dimensions, outermost first */
+struct Shape {
+    const char *name;
+    int count[3];
+    long stride[3];
+    long first;        /* element of the array where the piece starts */
+    long elems() const { return (long)count[0] * count[1] * count[2]; }
+};
+
+void pack(const double *x, const Shape &s, double *buf) {
+    for (int a = 0; a < s.count[0]; a++)
+        for (int b = 0; b < s.count[1]; b++) {
+            const double *row = x + s.first + a * s.stride[0] + b * s.stride[1];
+            if (s.stride[2] == 1) {
+                memcpy(buf, row, s.count[2] * sizeof(double));
+                buf += s.count[2];
+            } else {
+                for (int c = 0; c < s.count[2]; c++)
+                    *buf++ = row[c * s.stride[2]];
+            }
+        }
+}
+
+void unpack(double *x, const Shape &s, const double *buf) {
+    for (int a = 0; a < s.count[0]; a++)
+        for (int b = 0; b < s.count[1]; b++) {
+            double *row = x + s.first + a * s.stride[0] + b * s.stride[1];
+            if (s.stride[2] == 1) {
+                memcpy(row, buf, s.count[2] * sizeof(double));
+                buf += s.count[2];
+            } else {
+                for (int c = 0; c < s.count[2]; c++)
+                    row[c * s.stride[2]] = *buf++;
+            }
+        }
+}
+
+enum { CONTIGUOUS, PACK_LOOP, DERIVED };
+const char *way_names[3] = {"contiguous", "pack loop", "derived type"};
+
+/* One round trip of piece s of x between tasks 0 and 1 */
+void round_trip(int way, double *x, const Shape &s, double *buf, MPI_Datatype type, int rank,
+                MPI_Comm pair) {
+    int peer = 1 - rank;
+    long n = s.elems();
+    for (int leg = 0; leg < 2; leg++) {
+        bool sending = (leg == 0) == (rank == 0);
+        if (sending) {
+            if (way == DERIVED) {
+                MPI_Send(x + s.first, 1, type, peer, 0, pair);
+            } else {
+                if (way == PACK_LOOP)
+                    pack(x, s, buf);
+                MPI_Send(buf, n, MPI_DOUBLE, peer, 0, pair);
+            }
+        } else {
+            if (way == DERIVED) {
+                MPI_Recv(x + s.first, 1, type, peer, 0, pair, MPI_STATUS_IGNORE);
+            } else {
+                MPI_Recv(buf, n, MPI_DOUBLE, peer, 0, pair, MPI_STATUS_IGNORE);
+                if (way == PACK_LOOP)
+                    unpack(x, s, buf);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int rank, numtasks;
+    MPI_Comm pair;
+    int nx = (argc > 1) ? atoi(argv[1]) : NX3D;
+    int m = (argc > 2) ? atoi(argv[2]) : NX2D;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+    if (numtasks < 2) {
+        printf("Needs at least 2 tasks\n");
+        MPI_Finalize();
+        return 1;
+    }
+    MPI_Comm_split(MPI_COMM_WORLD, rank < 2 ? 0 : MPI_UNDEFINED, rank, &pair);
+
+    /* The 3D array has extents e x e x e including the halo */
+    long e = nx + 2, si = e * e, sj = e;
+    Shape shapes[5] = {
+        {"3D i-face", {1, nx, nx}, {si, sj, 1}, si + sj + 1},
+        {"3D j-face", {nx, 1, nx}, {si, sj, 1}, si + sj + 1},
+        {"3D k-face", {nx, nx, 1}, {si, sj, 1}, si + sj + 1},
+        {"matrix column", {1, 1, m}, {0, 0, m}, 7},
+        {"matrix block", {1, m / 2, m / 2}, {0, m, 1}, (long)(m / 4) * m + m / 4},
+    };
+    long size[5] = {e * e * e, e * e * e, e * e * e, (long)m * m, (long)m * m};
+    DatatypeCache types;
+
+    if (rank == 0)
+        printf("Ping-pong of strided pieces between 2 of %d tasks; one-way MiB/s of payload\n"
+               "  %-14s %10s   %-13s %-13s %-13s   %s\n", numtasks, "piece", "KiB",
+               way_names[0], way_names[1], way_names[2], "correct");
+    for (int sh = 0; sh < 5 && rank < 2; sh++) {
+        const Shape &s = shapes[sh];
+        vector<double> x(size[sh]), buf(s.elems());
+        MPI_Datatype type = types.box(3, s.count, s.stride);
+        double bytes = s.elems() * sizeof(double);
+        int reps = max(2, (int)min(2000.0, TARGET / bytes));
+        double rate[3];
+        bool ok = true;
+        for (int way = 0; way < 3; way++) {
+            /* Check: task 0 holds its indices, task 1 zeros, and one leg of the trip */
+            for (long i = 0; i < size[sh]; i++)
+                x[i] = rank == 0 ? (double)i : 0.0;
+            if (way == CONTIGUOUS)
+                for (long i = 0; i < s.elems(); i++)
+                    buf[i] = rank == 0 ? (double)i : 0.0;
+            round_trip(way, x.data(), s, buf.data(), type, rank, pair);
+            if (rank == 1 && way != CONTIGUOUS) {
+                vector<double> expect(size[sh], 0.0), from(size[sh]);
+                for (long i = 0; i < size[sh]; i++)
+                    from[i] = (double)i;
+                vector<double> tmp(s.elems());
+                pack(from.data(), s, tmp.data());
+                unpack(expect.data(), s, tmp.data());
+                ok = ok && x == expect;
+            }
+
+            MPI_Barrier(pair);
+            double t = MPI_Wtime();
+            for (int r = 0; r < reps; r++)
+                round_trip(way, x.data(), s, buf.data(), type, rank, pair);
+            t = MPI_Wtime() - t;
+            rate[way] = 2.0 * reps * bytes / (1 << 20) / t;
+        }
+        int okk = ok, all;
+        MPI_Reduce(&okk, &all, 1, MPI_INT, MPI_LAND, 0, pair);
+        if (rank == 0)
+            printf("  %-14s %10.0f   %-13.0f %-13.0f %-13.0f   %s\n", s.name, bytes / 1024, rate[0],
+                   rate[1], rate[2], all ? "yes" : "NO");
+    }
+
+    /* The k-face type built, committed and freed for every message, against the cache */
+    if (rank == 0) {
+        int reps = 100000;
+        const Shape &s = shapes[2];
+        double t = MPI_Wtime();
+        for (int r = 0; r < reps; r++) {
+            DatatypeCache once;
+            once.box(3, s.count, s.stride);
+        }
+        double tbuild = (MPI_Wtime() - t) / reps;
+        long hits = types.hits;
+        t = MPI_Wtime();
+        for (int r = 0; r < reps; r++)
+            types.box(3, s.count, s.stride);
+        double tlook = (MPI_Wtime() - t) / reps;
+        printf("  k-face type per message: %.2f us to build, commit and free, %.2f us from the cache\n",
+               tbuild * 1e6, tlook * 1e6);
+        printf("  Datatypes built: %ld, cache hits: %ld\n", types.builds, types.hits - hits);
+    }
+
+    if (pair != MPI_COMM_NULL)
+        MPI_Comm_free(&pair);
+    types.clear();
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "dist_io.h"
+
+void dio_default_hints(MPI_Info *info) {
+    MPI_Info_create(info);
+    /* Always aggregate through the collective-buffering ranks (ROMIO) */
+    MPI_Info_set(*info, "romio_cb_read", "enable");
+    MPI_Info_set(*info, "romio_cb_write", "enable");
+    MPI_Info_set(*info, "cb_buffer_size", "16777216");
+    /* Only collective calls are made, so ROMIO may defer the open on non-aggregators */
+    MPI_Info_set(*info, "romio_no_indep_rw", "true");
+    /* Used by parallel file systems such as Lustre when the file is created */
+    MPI_Info_set(*info, "striping_unit", "1048576");
+}
+
+void dio_array_decompose(MPI_Offset n, int rank, int p, MPI_Offset *start, int *count) {
+    MPI_Offset base = n / p, extra = n % p;
+    *start = rank * base + (rank < extra ? rank : extra);
+    *count = (int)(base + (rank < extra ? 1 : 0));
+}
+
+/* Balanced split of n items into p parts; part i gets [start, start + len) */
+static void split(int n, int p, int i, int *start, int *len) {
+    int base = n / p, extra = n % p;
+    *start = i * base + (i < extra ? i : extra);
+    *len = base + (i < extra ? 1 : 0);
+}
+
+void dio_matrix_decompose(int rows, int cols, dio_layout layout, MPI_Comm comm,
+                          dio_matrix_block *b) {
+    int rank, p;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+
+    b->layout = layout;
+    b->gsizes[0] = rows;
+    b->gsizes[1] = cols;
+    switch (layout) {
+    case DIO_ROWS:
+        b->dims[0] = p;
+        b->dims[1] = 1;
+        break;
+    case DIO_COLS:
+        b->dims[0] = 1;
+        b->dims[1] = p;
+        break;
+    case DIO_BLOCKS:
+        b->dims[0] = b->dims[1] = 0;
+        MPI_Dims_create(p, 2, b->dims);
+        break;
+    }
+    b->coords[0] = rank / b->dims[1];
+    b->coords[1] = rank % b->dims[1];
+    split(rows, b->dims[0], b->coords[0], &b->starts[0], &b->lsizes[0]);
+    split(cols, b->dims[1], b->coords[1], &b->starts[1], &b->lsizes[1]);
+}
+
+/* File view covering exactly this rank's block of the matrix */
+static void matrix_filetype(const dio_matrix_block *b, MPI_Offset *disp, MPI_Datatype *filetype) {
+    MPI_Offset row_bytes = (MPI_Offset)b->gsizes[1] * sizeof(double);
+
+    switch (b->layout) {
+    case DIO_ROWS:
+        /* whole rows are one contiguous run of the file */
+        *disp = b->starts[0] * row_bytes;
+        MPI_Type_contiguous(b->lsizes[0] * b->gsizes[1], MPI_DOUBLE, filetype);
+        break;
+    case DIO_COLS:
+        /* lsizes[1] doubles out of every row */
+        *disp = b->starts[1] * (MPI_Offset)sizeof(double);
+        MPI_Type_vector(b->gsizes[0], b->lsizes[1], b->gsizes[1], MPI_DOUBLE, filetype);
+        break;
+    case DIO_BLOCKS:
+        *disp = 0;
+        MPI_Type_create_subarray(2, b->gsizes, b->lsizes, b->starts, MPI_ORDER_C,
+                                 MPI_DOUBLE, filetype);
+        break;
+    }
+    MPI_Type_commit(filetype);
+}
+
+static int transfer(const char *path, void *buf, int count, MPI_Offset disp,
+                    MPI_Datatype filetype, int writing, MPI_Comm comm, MPI_Info info) {
+    MPI_File fh;
+    int rc, amode = writing ? (MPI_MODE_CREATE | MPI_MODE_WRONLY) : MPI_MODE_RDONLY;
+
+    rc = MPI_File_open(comm, path, amode, info, &fh);
+    if (rc != MPI_SUCCESS)
+        return rc;
+    /* the ranks together rewrite the whole file, so drop any old contents first */
+    if (writing)
+        rc = MPI_File_set_size(fh, 0);
+    if (rc == MPI_SUCCESS)
+        rc = MPI_File_set_view(fh, disp, MPI_DOUBLE, filetype, "native", info);
+    if (rc == MPI_SUCCESS) {
+        if (writing)
+            rc = MPI_File_write_all(fh, buf, count, MPI_DOUBLE, MPI_STATUS_IGNORE);
+        else
+            rc = MPI_File_read_all(fh, buf, count, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&fh);
+    return rc;
+}
+
+int dio_write_array(const char *path, const double *local, MPI_Offset start, int count,
+                    MPI_Comm comm, MPI_Info info) {
+    return transfer(path, (void *)local, count, start * (MPI_Offset)sizeof(double), MPI_DOUBLE,
+                    1, comm, info);
+}
+
+int dio_read_array(const char *path, double *local, MPI_Offset start, int count,
+                   MPI_Comm comm, MPI_Info info) {
+    return transfer(path, local, count, start * (MPI_Offset)sizeof(double), MPI_DOUBLE,
+                    0, comm, info);
+}
+
+int dio_write_matrix(const char *path, const double *local, const dio_matrix_block *b,
+                     MPI_Comm comm, MPI_Info info) {
+    MPI_Offset disp;
+    MPI_Datatype filetype;
+    int rc;
+
+    matrix_filetype(b, &disp, &filetype);
+    rc = transfer(path, (void *)local, b->lsizes[0] * b->lsizes[1], disp, filetype, 1, comm, info);
+    MPI_Type_free(&filetype);
+    return rc;
+}
+
+int dio_read_matrix(const char *path, double *local, const dio_matrix_block *b,
+                    MPI_Comm comm, MPI_Info info) {
+    MPI_Offset disp;
+    MPI_Datatype filetype;
+    int rc;
+
+    matrix_filetype(b, &disp, &filetype);
+    rc = transfer(path, local, b->lsizes[0] * b->lsizes[1], disp, filetype, 0, comm, info);
+    MPI_Type_free(&filetype);
+    return rc;
+}
@@ -0,0 +1,52 @@
+#ifndef DIST_IO_H
+#define DIST_IO_H
+
+#include "mpi.h"
+
+/*
+ * Collective MPI-IO for distributed arrays and matrices of doubles stored as
+ * raw binary files (row-major, no header). Every rank sets a file view that
+ * covers exactly its own block and then calls MPI_File_write_all /
+ * MPI_File_read_all, so the MPI library can merge the requests (collective
+ * buffering) instead of funnelling the whole file through one rank.
+ *
+ * All routines are collective over `comm` and return an MPI error code.
+ * `info` may be MPI_INFO_NULL or the hints from dio_default_hints().
+ */
+
+/* How the rows x cols matrix is split over the ranks */
+typedef enum {
+    DIO_ROWS,     /* block of whole rows per rank - contiguous in the file */
+    DIO_COLS,     /* block of whole columns per rank - MPI_Type_vector filetype */
+    DIO_BLOCKS    /* 2D block on a process grid from MPI_Dims_create - subarray filetype */
+} dio_layout;
+
+typedef struct {
+    dio_layout layout;
+    int gsizes[2];     /* global rows, cols */
+    int lsizes[2];     /* rows, cols of the local block */
+    int starts[2];     /* global index of the first local row, col */
+    int dims[2];       /* process grid */
+    int coords[2];     /* position of this rank in the grid */
+} dio_matrix_block;
+
+/* Collective-buffering hints; free the result with MPI_Info_free */
+void dio_default_hints(MPI_Info *info);
+
+/* Balanced 1D block of an n-element array: elements [*start, *start + *count) */
+void dio_array_decompose(MPI_Offset n, int rank, int p, MPI_Offset *start, int *count);
+int dio_write_array(const char *path, const double *local, MPI_Offset start, int count,
+                    MPI_Comm comm, MPI_Info info);
+int dio_read_array(const char *path, double *local, MPI_Offset start, int count,
+                   MPI_Comm comm, MPI_Info info);
+
+/* Fill `b` with this rank's block of a rows x cols matrix; the local block is stored
+   row-major with lsizes[1] columns */
+void dio_matrix_decompose(int rows, int cols, dio_layout layout, MPI_Comm comm,
+                          dio_matrix_block *b);
+int dio_write_matrix(const char *path, const double *local, const dio_matrix_block *b,
+                     MPI_Comm comm, MPI_Info info);
+int dio_read_matrix(const char *path, double *local, const dio_matrix_block *b,
+                    MPI_Comm comm, MPI_Info info);
+
+#endif
@@ -0,0 +1,334 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+#include "stencil.h"
+#include "mpi_types.h"
+
+#define  MASTER       0
+#define  NX           1201        /* Default grid, the same as Laplace_Solver.py */
+#define  NY           1201
+#define  ITERATIONS   100
+#define  CHECK_EVERY  10          /* Iterations between residual allreduces */
+#define  TOL          1e-8
+#define  VERIFY_MAX   (1 << 22)   /* Grids up to this many points are checked against a serial run */
+
+using namespace std;
+
+/* Directions of travel for halo messages; the tag tells a receiver which face arrived */
+enum { TO_NORTH, TO_SOUTH, TO_WEST, TO_EAST };
+
+/* This rank's block of the global grid. The interior points (i, j) of the global grid are
+   split over a 2D Cartesian grid of ranks; a 3D grid keeps its whole k extent on every
+   rank. The local arrays have a one-cell halo; at the edge of the global grid the halo
+   holds the fixed boundary values instead. */
+struct Domain {
+    int nx, ny, nz;               /* global points including the boundary; nz == 1 for 2D */
+    int dims[2], coords[2];
+    MPI_Comm cart;
+    int north, south, west, east; /* neighbours in i and j, MPI_PROC_NULL at the edge */
+    int lx, ly, lz;               /* local interior points */
+    int gi0, gj0;                 /* global (i, j) of the first local interior point */
+    int kz;                       /* local extent in k including halo (1 for 2D) */
+    long si, sj;                  /* strides of i and j */
+    double *u, *unew;
+    DatatypeCache *types;
+    MPI_Datatype jface;           /* lx x kz points of one j-layer, strided by si */
+};
+
+void split(int n, int p, int c, int *start, int *len) {
+    int base = n / p, extra = n % p;
+    *start = c * base + (c < extra ? c : extra);
+    *len = base + (c < extra ? 1 : 0);
+}
+
+/* Boundary values of Laplace_Solver.py: 10 on the first i face, 1 on the last, 0 elsewhere */
+double boundary_value(const Domain &d, int gi) {
+    if (gi == 0) return 10.0;
+    if (gi == d.nx - 1) return 1.0;
+    return 0.0;
+}
+
+void setup(Domain &d, int nx, int ny, int nz) {
+    int p, periods[2] = {0, 0};
+
+    d.nx = nx; d.ny = ny; d.nz = nz;
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+    d.dims[0] = d.dims[1] = 0;
+    MPI_Dims_create(p, 2, d.dims);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, d.dims, periods, 1, &d.cart);
+    int rank;
+    MPI_Comm_rank(d.cart, &rank);
+    MPI_Cart_coords(d.cart, rank, 2, d.coords);
+    MPI_Cart_shift(d.cart, 0, 1, &d.north, &d.south);
+    MPI_Cart_shift(d.cart, 1, 1, &d.west, &d.east);
+
+    split(nx - 2, d.dims[0], d.coords[0], &d.gi0, &d.lx);
+    split(ny - 2, d.dims[1], d.coords[1], &d.gj0, &d.ly);
+    d.gi0 += 1;
+    d.gj0 += 1;
+    d.lz = (nz == 1) ? 1 : nz - 2;
+    d.kz = (nz == 1) ? 1 : nz;
+    d.sj = d.kz;
+    d.si = (long)(d.ly + 2) * d.kz;
+
+    long total = (long)(d.lx + 2) * d.si;
+    d.u = (double *)malloc(total * sizeof(double));
+    d.unew = (double *)malloc(total * sizeof(double));
+
+    /* First touch by the threads that will sweep the rows */
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < d.lx + 2; i++)
+        for (long x = 0; x < d.si; x++) {
+            double v = 0.0;
+            if (i == 0 && d.north == MPI_PROC_NULL) v = boundary_value(d, 0);
+            if (i == d.lx + 1 && d.south == MPI_PROC_NULL) v = boundary_value(d, nx - 1);
+            d.u[i * d.si + x] = d.unew[i * d.si + x] = v;
+        }
+
+    d.types = new DatatypeCache;
+    d.jface = d.types->block3d(d.lx, 1, d.kz, d.si, d.sj);
+}
+
+/* Update local rows [i0, i1) and columns [j0, j1) (all interior k) from u into unew */
+double sweep(Domain &d, int i0, int i1, int j0, int j1, bool residual) {
+    if (d.nz == 1)
+        return jacobi2d(d.u, d.unew, d.si, i0, i1, j0, j1, residual);
+    return jacobi3d(d.u, d.unew, d.si, d.sj, i0, i1, j0, j1, 1, d.lz + 1, residual);
+}
+
+/* Post the halo exchange of u. Whole i-planes are contiguous; j-faces are strided and
+   described by d.jface. Both go straight from and into the array. */
+void start_halo(Domain &d, MPI_Request req[8]) {
+    double *w = d.u + d.si, *e = d.u + d.si + d.ly * d.sj;
+    MPI_Irecv(d.u, d.si, MPI_DOUBLE, d.north, TO_SOUTH, d.cart, &req[0]);
+    MPI_Irecv(d.u + (d.lx + 1) * d.si, d.si, MPI_DOUBLE, d.south, TO_NORTH, d.cart, &req[1]);
+    MPI_Irecv(w, 1, d.jface, d.west, TO_EAST, d.cart, &req[2]);
+    MPI_Irecv(e + d.sj, 1, d.jface, d.east, TO_WEST, d.cart, &req[3]);
+    MPI_Isend(d.u + d.si, d.si, MPI_DOUBLE, d.north, TO_NORTH, d.cart, &req[4]);
+    MPI_Isend(d.u + d.lx * d.si, d.si, MPI_DOUBLE, d.south, TO_SOUTH, d.cart, &req[5]);
+    MPI_Isend(w + d.sj, 1, d.jface, d.west, TO_WEST, d.cart, &req[6]);
+    MPI_Isend(e, 1, d.jface, d.east, TO_EAST, d.cart, &req[7]);
+}
+
+void finish_halo(MPI_Request req[8]) {
+    MPI_Waitall(8, req, MPI_STATUSES_IGNORE);
+}
+
+/* One Jacobi iteration. With `overlap` the interior that does not touch the halo is
+   updated while the halo messages are in flight, and the cells next to the halo after. */
+double iterate(Domain &d, bool overlap, bool residual) {
+    MPI_Request req[8];
+    double res = 0.0;
+
+    start_halo(d, req);
+    if (!overlap) {
+        finish_halo(req);
+        res = sweep(d, 1, d.lx + 1, 1, d.ly + 1, residual);
+    } else {
+        res += sweep(d, 2, d.lx, 2, d.ly, residual);
+        finish_halo(req);
+        res += sweep(d, 1, 2, 1, d.ly + 1, residual);
+        if (d.lx > 1)
+            res += sweep(d, d.lx, d.lx + 1, 1, d.ly + 1, residual);
+        res += sweep(d, 2, d.lx, 1, 2, residual);
+        if (d.ly > 1)
+            res += sweep(d, 2, d.lx, d.ly, d.ly + 1, residual);
+    }
+    swap(d.u, d.unew);
+    return res;
+}
+
+/* Gather the interior of every block on the master and compare it bit for bit with a
+   single-grid run of the same number of iterations */
+void verify(Domain &d, int iterations) {
+    int rank, p;
+    MPI_Comm_rank(d.cart, &rank);
+    MPI_Comm_size(d.cart, &p);
+
+    long mine = (long)d.lx * d.ly * d.lz;
+    vector<double> block(mine);
+    long x = 0;
+    int k0 = (d.nz == 1) ? 0 : 1;
+    for (int i = 1; i <= d.lx; i++)
+        for (int j = 1; j <= d.ly; j++)
+            for (int k = k0; k < k0 + d.lz; k++)
+                block[x++] = d.u[i * d.si + j * d.sj + k];
+
+    int info[4] = {d.gi0, d.gj0, d.lx, d.ly};
+    vector<int> infos(4 * p), counts(p), displs(p);
+    MPI_Gather(info, 4, MPI_INT, infos.data(), 4, MPI_INT, MASTER, d.cart);
+    int cnt = (int)mine;
+    MPI_Gather(&cnt, 1, MPI_INT, counts.data(), 1, MPI_INT, MASTER, d.cart);
+    long total = 0;
+    for (int r = 0; r < p; r++) {
+        displs[r] = (int)total;
+        total += counts[r];
+    }
+    vector<double> all(rank == MASTER ? total : 1);
+    MPI_Gatherv(block.data(), cnt, MPI_DOUBLE, all.data(), counts.data(), displs.data(),
+                MPI_DOUBLE, MASTER, d.cart);
+    if (rank != MASTER)
+        return;
+
+    /* Reference: the whole grid as one block, swept with the same kernels */
+    long sj = d.kz, si = (long)d.ny * d.kz;
+    vector<double> a((long)d.nx * si, 0.0), b;
+    for (long y = 0; y < si; y++) {
+        a[y] = 10.0;
+        a[(d.nx - 1) * si + y] = 1.0;
+    }
+    b = a;
+    double *u = a.data(), *un = b.data();
+    for (int it = 0; it < iterations; it++) {
+        if (d.nz == 1)
+            jacobi2d(u, un, si, 1, d.nx - 1, 1, d.ny - 1, false);
+        else
+            jacobi3d(u, un, si, sj, 1, d.nx - 1, 1, d.ny - 1, 1, d.nz - 1, false);
+        swap(u, un);
+    }
+
+    long wrong = 0;
+    for (int r = 0; r < p; r++) {
+        int gi0 = infos[4 * r], gj0 = infos[4 * r + 1], lx = infos[4 * r + 2], ly = infos[4 * r + 3];
+        x = displs[r];
+        for (int i = 0; i < lx; i++)
+            for (int j = 0; j < ly; j++)
+                for (int k = k0; k < k0 + d.lz; k++)
+                    if (all[x++] != u[(gi0 + i) * si + (gj0 + j) * sj + k])
+                        wrong++;
+    }
+    printf("Check against a single-grid run: %s (%ld points differ)\n",
+           wrong ? "FAILED" : "bitwise identical", wrong);
+}
+
+/* Run until `iterations` are done or the residual drops below `tol`; returns the number
+   of iterations done. With tile_steps > 1 (single task, 2D) up to tile_steps iterations
+   at a time are done by jacobi2d_temporal; an iteration that checks the residual is
+   always an ordinary sweep. */
+int solve(Domain &d, int iterations, int check_every, double tol, bool overlap,
+          int tile_steps, double *gres) {
+    int rank, it = 0;
+    double res;
+
+    MPI_Comm_rank(d.cart, &rank);
+    *gres = 0.0;
+    while (it < iterations) {
+        int next = min(iterations, (it / check_every + 1) * check_every);
+        int steps = min(tile_steps, next - it);
+        bool check = (it + steps == next);
+        if (tile_steps > 1) {
+            int blocked = check ? steps - 1 : steps;
+            if (blocked > 0) {
+                jacobi2d_temporal(d.u, d.unew, d.si, 1, d.lx + 1, 1, d.ly + 1, blocked);
+                if (blocked % 2)
+                    swap(d.u, d.unew);
+            }
+            res = check ? iterate(d, overlap, true) : 0.0;
+        } else {
+            res = iterate(d, overlap, check);
+        }
+        it += steps;
+        if (check) {
+            MPI_Allreduce(&res, gres, 1, MPI_DOUBLE, MPI_SUM, d.cart);
+            *gres = sqrt(*gres);
+            if (rank == MASTER)
+                printf("  iteration %6d  residual %e\n", it, *gres);
+            if (*gres < tol)
+                break;
+        }
+    }
+    return it;
+}
+
+void report(const Domain &d, const char *label, int it, double gres, double wtime) {
+    double points = (double)(d.nx - 2) * (d.ny - 2) * (d.nz == 1 ? 1 : d.nz - 2) * it;
+    int flops = (d.nz == 1) ? STENCIL_FLOPS_2D : STENCIL_FLOPS_3D;
+    printf("%s: %d iterations, residual %e\n", label, it, gres);
+    printf("  Elapsed wall clock time = %g seconds (%g s per iteration)\n", wtime, wtime / it);
+    printf("  Performance: %.1f MLUP/s  %.2f GFLOP/s\n", points / wtime / 1e6,
+           points * flops / wtime / 1e9);
+}
+
+void teardown(Domain &d) {
+    free(d.u);
+    free(d.unew);
+    delete d.types;
+    MPI_Comm_free(&d.cart);
+}
+
+int main(int argc, char *argv[]) {
+    int rank, numtasks, provided, it;
+    int nx = (argc > 1) ? atoi(argv[1]) : NX;
+    int ny = (argc > 2) ? atoi(argv[2]) : NY;
+    int nz = (argc > 3) ? atoi(argv[3]) : 1;
+    int iterations = (argc > 4) ? atoi(argv[4]) : ITERATIONS;
+    int check_every = (argc > 5) ? atoi(argv[5]) : CHECK_EVERY;
+    double tol = (argc > 6) ? atof(argv[6]) : TOL;
+    bool overlap = (argc > 7) ? atoi(argv[7]) != 0 : true;
+    int tile_steps = (argc > 8) ? atoi(argv[8]) : 1;
+    double gres, wtime;
+    Domain d;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    if (check_every < 1 || tile_steps < 1) {
+        if (rank == MASTER)
+            printf("Quitting. The residual check interval and the tile steps must be at least 1:"
+                   " check_every=%d tile_steps=%d\n", check_every, tile_steps);
+        MPI_Finalize();
+        return 1;
+    }
+    if (tile_steps > 1 && (numtasks > 1 || nz > 1)) {
+        if (rank == MASTER)
+            printf("Temporal blocking needs one task and a 2D grid; using ordinary sweeps\n");
+        tile_steps = 1;
+    }
+
+    setup(d, nx, ny, nz);
+    if (rank == MASTER) {
+        printf("Jacobi %s grid %d x %d", nz == 1 ? "2D" : "3D", nx, ny);
+        if (nz > 1) printf(" x %d", nz);
+        printf(", %d x %d tasks x %d threads, %s halo exchange\n", d.dims[0], d.dims[1],
+               omp_get_max_threads(), overlap ? "overlapped" : "blocking");
+    }
+
+    MPI_Barrier(d.cart);
+    wtime = MPI_Wtime();
+    it = solve(d, iterations, check_every, tol, overlap, 1, &gres);
+    wtime = MPI_Wtime() - wtime;
+    if (rank == MASTER)
+        report(d, "Streaming sweeps", it, gres, wtime);
+
+    /***** Temporal blocking: rerun from the start and compare with the streaming result *****/
+    if (tile_steps > 1) {
+        long total = (long)(d.lx + 2) * d.si;
+        vector<double> streamed(d.u, d.u + total);
+        double wstream = wtime;
+        teardown(d);
+        setup(d, nx, ny, nz);
+
+        wtime = MPI_Wtime();
+        int it2 = solve(d, iterations, check_every, tol, overlap, tile_steps, &gres);
+        wtime = MPI_Wtime() - wtime;
+        char label[64];
+        snprintf(label, sizeof(label), "Temporal blocking (%d steps per tile)", tile_steps);
+        report(d, label, it2, gres, wtime);
+        bool same = (it2 == it) && memcmp(streamed.data(), d.u, total * sizeof(double)) == 0;
+        printf("  Speedup over streaming: %.2fx, result %s\n", wstream / wtime,
+               same ? "bitwise identical" : "DIFFERENT");
+    }
+
+    if ((long)nx * ny * nz <= VERIFY_MAX)
+        verify(d, it);
+
+    teardown(d);
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <vector>
+#include "mpi_types.h"
+
+#define  MASTER      0
+#define  N           1024   /* Default matrix order */
+#define  REPEATS     5      /* Timed distributions and gathers of each variant */
+#define  VERIFY_MAX  1024   /* Orders up to this are checked against a serial product */
+
+using namespace std;
+
+/*
+ * C = A B on a 2D grid of tasks. The master holds the three N x N matrices; task (r, c)
+ * gets the rows of block row r of A and the columns of block column c of B, and returns
+ * block (r, c) of C. The rows of A are contiguous, but a block column of B and a block
+ * of C are strided in the master's arrays. The program moves them two ways and times
+ * both:
+ *
+ *   pack buffers   the master copies each block into a contiguous buffer before sending
+ *                  it, or out of one after receiving it
+ *   derived types  the master sends and receives the blocks in place, described by
+ *                  DatatypeCache::block2d; the tasks store their blocks contiguously
+ *                  and use plain MPI_DOUBLE counts
+ *
+ * Blocks of the same size share one cached type, so a grid of any size builds at most
+ * four types for B and four for C.
+ */
+
+void split(int n, int p, int c, int *start, int *len) {
+    int base = n / p, extra = n % p;
+    *start = c * base + (c < extra ? c : extra);
+    *len = base + (c < extra ? 1 : 0);
+}
+
+struct Block {
+    int r0, rows, c0, cols;
+};
+
+Block block_of(int n, const int dims[2], int rank) {
+    Block b;
+    split(n, dims[0], rank / dims[1], &b.r0, &b.rows);
+    split(n, dims[1], rank % dims[1], &b.c0, &b.cols);
+    return b;
+}
+
+/* The master sends every task its rows of A and columns of B */
+void distribute(int n, const int dims[2], const double *A, const double *B, vector<double> &a,
+                vector<double> &b, bool packed, DatatypeCache &types, MPI_Comm comm) {
+    int rank, p;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+    Block mine = block_of(n, dims, rank);
+    vector<MPI_Request> req;
+    vector<vector<double>> bufs;
+    req.resize(2);
+    MPI_Irecv(a.data(), mine.rows * n, MPI_DOUBLE, MASTER, 0, comm, &req[0]);
+    MPI_Irecv(b.data(), n * mine.cols, MPI_DOUBLE, MASTER, 1, comm, &req[1]);
+    if (rank == MASTER) {
+        if (packed)
+            bufs.resize(p);
+        for (int q = 0; q < p; q++) {
+            Block bq = block_of(n, dims, q);
+            req.resize(req.size() + 2);
+            MPI_Isend(A + (long)bq.r0 * n, bq.rows * n, MPI_DOUBLE, q, 0, comm, &req[req.size() - 2]);
+            if (packed) {
+                bufs[q].resize((long)n * bq.cols);
+                for (int i = 0; i < n; i++)
+                    memcpy(&bufs[q][(long)i * bq.cols], B + (long)i * n + bq.c0, bq.cols * sizeof(double));
+                MPI_Isend(bufs[q].data(), n * bq.cols, MPI_DOUBLE, q, 1, comm, &req.back());
+            } else {
+                MPI_Isend(B + bq.c0, 1, types.block2d(n, bq.cols, n), q, 1, comm, &req.back());
+            }
+        }
+    }
+    MPI_Waitall(req.size(), req.data(), MPI_STATUSES_IGNORE);
+}
+
+/* Every task returns its block of C to the master */
+void gather(int n, const int dims[2], double *C, const vector<double> &c, bool packed,
+            DatatypeCache &types, MPI_Comm comm) {
+    int rank, p;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &p);
+    Block mine = block_of(n, dims, rank);
+    vector<MPI_Request> req(1);
+    vector<vector<double>> bufs;
+    MPI_Isend(c.data(), mine.rows * mine.cols, MPI_DOUBLE, MASTER, 2, comm, &req[0]);
+    if (rank == MASTER) {
+        if (packed)
+            bufs.resize(p);
+        for (int q = 0; q < p; q++) {
+            Block bq = block_of(n, dims, q);
+            req.resize(req.size() + 1);
+            if (packed) {
+                bufs[q].resize((long)bq.rows * bq.cols);
+                MPI_Irecv(bufs[q].data(), bq.rows * bq.cols, MPI_DOUBLE, q, 2, comm, &req.back());
+            } else {
+                MPI_Irecv(C + (long)bq.r0 * n + bq.c0, 1, types.block2d(bq.rows, bq.cols, n), q, 2,
+                          comm, &req.back());
+            }
+        }
+    }
+    MPI_Waitall(req.size(), req.data(), MPI_STATUSES_IGNORE);
+    if (rank == MASTER && packed)
+        for (int q = 0; q < p; q++) {
+            Block bq = block_of(n, dims, q);
+            for (int i = 0; i < bq.rows; i++)
+                memcpy(C + (long)(bq.r0 + i) * n + bq.c0, &bufs[q][(long)i * bq.cols],
+                       bq.cols * sizeof(double));
+        }
+}
+
+/* c (rows x cols) = a (rows x n) b (n x cols), in i-k-j order */
+void multiply(int rows, int cols, int n, const double *a, const double *b, double *c) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < rows; i++) {
+        double *ci = c + (long)i * cols;
+        for (int j = 0; j < cols; j++)
+            ci[j] = 0.0;
+        for (int k = 0; k < n; k++) {
+            double aik = a[(long)i * n + k];
+            const double *bk = b + (long)k * cols;
+            #pragma omp simd
+            for (int j = 0; j < cols; j++)
+                ci[j] += aik * bk[j];
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int rank, numtasks, provided, dims[2] = {0, 0};
+    int n = (argc > 1) ? atoi(argv[1]) : N;
+    int repeats = (argc > 2) ? atoi(argv[2]) : REPEATS;
+    vector<double> A, B, C[2];
+    DatatypeCache types;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+    MPI_Dims_create(numtasks, 2, dims);
+    Block mine = block_of(n, dims, rank);
+
+    if (rank == MASTER) {
+        A.resize((long)n * n);
+        B.resize((long)n * n);
+        for (long i = 0; i < n; i++)
+            for (long j = 0; j < n; j++) {
+                A[i * n + j] = (double)((i * 7 + j * 3) % 11) - 5.0;
+                B[i * n + j] = (double)((i * 5 + j * 2) % 13) * 0.25;
+            }
+        C[0].resize((long)n * n);
+        C[1].resize((long)n * n);
+        printf("C = A B, %d x %d, %d x %d tasks x %d threads\n", n, n, dims[0], dims[1],
+               omp_get_max_threads());
+    }
+    vector<double> a((long)mine.rows * n), b((long)n * mine.cols), c((long)mine.rows * mine.cols);
+
+    /***** Both ways of moving the blocks, each timed over `repeats` rounds *****/
+    const char *names[2] = {"pack buffers", "derived types"};
+    double tdist[2], tgath[2], tmul = 0;
+    for (int v = 0; v < 2; v++) {
+        bool packed = (v == 0);
+        tdist[v] = tgath[v] = 1e30;
+        for (int r = 0; r < repeats; r++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double t = MPI_Wtime();
+            distribute(n, dims, A.data(), B.data(), a, b, packed, types, MPI_COMM_WORLD);
+            t = MPI_Wtime() - t;
+            tdist[v] = min(tdist[v], t);
+
+            if (r == 0) {
+                t = MPI_Wtime();
+                multiply(mine.rows, mine.cols, n, a.data(), b.data(), c.data());
+                tmul = MPI_Wtime() - t;
+            }
+
+            MPI_Barrier(MPI_COMM_WORLD);
+            t = MPI_Wtime();
+            gather(n, dims, C[v].data(), c, packed, types, MPI_COMM_WORLD);
+            t = MPI_Wtime() - t;
+            tgath[v] = min(tgath[v], t);
+        }
+    }
+
+    if (rank == MASTER) {
+        double mb = (double)n * n * sizeof(double) / (1 << 20);
+        printf("Multiply on the master's block: %.3f s\n", tmul);
+        printf("  %-14s %14s %10s %14s %10s\n", "", "scatter A, B", "MiB/s", "gather C", "MiB/s");
+        for (int v = 0; v < 2; v++)
+            printf("  %-14s %12.4f s %10.0f %12.4f s %10.0f\n", names[v], tdist[v], 2 * mb / tdist[v],
+                   tgath[v], mb / tgath[v]);
+        printf("  Datatypes built: %ld, cache hits: %ld\n", types.builds, types.hits);
+
+        bool same = C[0] == C[1];
+        printf("Pack buffers and derived types give %s C\n", same ? "the same" : "a DIFFERENT");
+        if (n <= VERIFY_MAX) {
+            vector<double> ref((long)n * n);
+            multiply(n, n, n, A.data(), B.data(), ref.data());
+            printf("Check against a serial product: %s\n", ref == C[1] ? "bitwise identical" : "FAILED");
+        }
+    }
+
+    types.clear();
+    MPI_Finalize();
+    return 0;
+}
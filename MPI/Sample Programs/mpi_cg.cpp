@@ -0,0 +1,383 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+#include "csr.h"
+
+#define  MASTER    0
+#define  GRID      1024        /* Default 2D Laplacian: GRID x GRID unknowns */
+#define  TOL       1e-8        /* Stop when ||r|| / ||b|| falls below this */
+#define  MAXIT     5000
+
+using namespace std;
+
+/* Solver variants; they differ only in how many global reductions an iteration needs */
+enum method { CG, CG_FUSED, CG_PIPELINED, NMETHODS };
+const char *method_names[NMETHODS] = {"cg", "cg-fused", "cg-pipelined"};
+
+/* Time spent per category, seconds */
+enum { T_SPMV, T_HALO, T_REDUCE, T_VECTOR, NTIMERS };
+const char *timer_names[NTIMERS] = {"spmv", "halo", "allreduce", "vector"};
+
+/*
+ * This rank's block of rows of the matrix and what it needs from other ranks.
+ *
+ * Local vectors hold the nlocal owned entries followed by nghost ghost entries, the
+ * entries of other ranks that the local rows reference. Ghosts are grouped by owner, so
+ * each neighbour's values arrive contiguously at x + nlocal + recvoff[k]. The column
+ * indices of the local CSR point into this combined numbering.
+ */
+struct DistMatrix {
+    MPI_Comm comm;
+    long nglobal, row0;           /* global rows and the first one owned here */
+    int nlocal, nghost;
+    Csr A;
+    vector<int> nbr;              /* ranks exchanged with */
+    vector<int> sendcnt, sendoff, recvcnt, recvoff;
+    vector<int> sendidx;          /* local entries each neighbour needs, neighbour by neighbour */
+    vector<double> sendbuf;
+    vector<MPI_Request> reqs;
+    double t[NTIMERS];
+};
+
+/* Rows of the n x n grid owned by `rank`: a balanced contiguous block */
+void block(long nglobal, int rank, int numtasks, long *start, int *len) {
+    long base = nglobal / numtasks, extra = nglobal % numtasks;
+    *start = rank * base + min((long)rank, extra);
+    *len = (int)(base + (rank < extra ? 1 : 0));
+}
+
+/* Rank owning global row g under block() */
+int owner_of(long g, long nglobal, int numtasks) {
+    long base = nglobal / numtasks, extra = nglobal % numtasks;
+    if (g < extra * (base + 1))
+        return (int)(g / (base + 1));
+    return (int)(extra + (g - extra * (base + 1)) / base);
+}
+
+/* Local rows of the 5-point Laplacian on an n x n grid, with global column indices */
+void laplace2d_rows(int n, long row0, int nlocal, Coo &a) {
+    const int di[5] = {-1, 0, 0, 0, 1}, dj[5] = {0, -1, 0, 1, 0};
+    a.nrows = nlocal;
+    for (int r = 0; r < nlocal; r++) {
+        long g = row0 + r;
+        int i = (int)(g / n), j = (int)(g % n);
+        for (int d = 0; d < 5; d++) {
+            int ii = i + di[d], jj = j + dj[d];
+            if (ii < 0 || ii >= n || jj < 0 || jj >= n)
+                continue;
+            a.row.push_back(r);
+            a.col.push_back((int)((long)ii * n + jj - row0));   /* relative to row0 for now */
+            a.val.push_back(d == 2 ? 4.0 : -1.0);
+        }
+    }
+}
+
+/*
+ * Turn the local rows (with columns relative to row0) into a DistMatrix: find the ghost
+ * columns, agree with their owners on what each rank sends every multiply (one
+ * MPI_Alltoall and one MPI_Alltoallv), and renumber the columns to local + ghost order.
+ */
+void setup(DistMatrix &d, Coo &a, long nglobal, MPI_Comm comm) {
+    int rank, numtasks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &numtasks);
+    d.comm = comm;
+    d.nglobal = nglobal;
+    block(nglobal, rank, numtasks, &d.row0, &d.nlocal);
+
+    vector<long> ghosts;
+    for (size_t e = 0; e < a.col.size(); e++)
+        if (a.col[e] < 0 || a.col[e] >= d.nlocal)
+            ghosts.push_back(d.row0 + a.col[e]);
+    sort(ghosts.begin(), ghosts.end());
+    ghosts.erase(unique(ghosts.begin(), ghosts.end()), ghosts.end());
+    d.nghost = (int)ghosts.size();
+
+    /* Ghosts are sorted by global index, so each owner's ghosts are contiguous */
+    vector<int> want(numtasks, 0), give(numtasks);
+    for (int k = 0; k < d.nghost; k++)
+        want[owner_of(ghosts[k], nglobal, numtasks)]++;
+    MPI_Alltoall(want.data(), 1, MPI_INT, give.data(), 1, MPI_INT, comm);
+
+    vector<int> wantoff(numtasks + 1, 0), giveoff(numtasks + 1, 0);
+    for (int p = 0; p < numtasks; p++) {
+        wantoff[p + 1] = wantoff[p] + want[p];
+        giveoff[p + 1] = giveoff[p] + give[p];
+    }
+    vector<long> asked(giveoff[numtasks]);
+    MPI_Alltoallv(ghosts.data(), want.data(), wantoff.data(), MPI_LONG,
+                  asked.data(), give.data(), giveoff.data(), MPI_LONG, comm);
+
+    for (int p = 0; p < numtasks; p++) {
+        if (want[p] > 0 || give[p] > 0) {
+            d.nbr.push_back(p);
+            d.recvcnt.push_back(want[p]);
+            d.recvoff.push_back(wantoff[p]);
+        }
+    }
+    /* Send lists in the same neighbour order as nbr */
+    d.sendoff.push_back(0);
+    for (size_t k = 0; k < d.nbr.size(); k++) {
+        int p = d.nbr[k];
+        for (int q = giveoff[p]; q < giveoff[p + 1]; q++)
+            d.sendidx.push_back((int)(asked[q] - d.row0));
+        d.sendcnt.push_back(give[p]);
+        d.sendoff.push_back(d.sendoff.back() + give[p]);
+    }
+    d.sendoff.pop_back();
+    d.sendbuf.resize(d.sendidx.size());
+    d.reqs.resize(2 * d.nbr.size());
+
+    for (size_t e = 0; e < a.col.size(); e++) {
+        int c = a.col[e];
+        if (c < 0 || c >= d.nlocal)
+            a.col[e] = d.nlocal + (int)(lower_bound(ghosts.begin(), ghosts.end(), d.row0 + c)
+                                        - ghosts.begin());
+    }
+    a.ncols = d.nlocal + d.nghost;
+    coo_to_csr(a, d.A);
+    memset(d.t, 0, sizeof(d.t));
+}
+
+/* y = A * x; x must have room for the ghosts, which are refreshed first */
+void spmv(DistMatrix &d, double *x, double *y) {
+    double t0 = MPI_Wtime();
+    int nn = (int)d.nbr.size();
+    for (int k = 0; k < nn; k++)
+        MPI_Irecv(x + d.nlocal + d.recvoff[k], d.recvcnt[k], MPI_DOUBLE, d.nbr[k], 0, d.comm,
+                  &d.reqs[k]);
+    #pragma omp parallel for schedule(static)
+    for (size_t q = 0; q < d.sendidx.size(); q++)
+        d.sendbuf[q] = x[d.sendidx[q]];
+    for (int k = 0; k < nn; k++)
+        MPI_Isend(d.sendbuf.data() + d.sendoff[k], d.sendcnt[k], MPI_DOUBLE, d.nbr[k], 0,
+                  d.comm, &d.reqs[nn + k]);
+    MPI_Waitall(2 * nn, d.reqs.data(), MPI_STATUSES_IGNORE);
+    double t1 = MPI_Wtime();
+    spmv_csr(d.A, x, y);
+    d.t[T_HALO] += t1 - t0;
+    d.t[T_SPMV] += MPI_Wtime() - t1;
+}
+
+/* Local dot products, reduced by the caller */
+double dot(int n, const double *x, const double *y) {
+    double s = 0.0;
+    #pragma omp parallel for reduction(+ : s)
+    for (int i = 0; i < n; i++)
+        s += x[i] * y[i];
+    return s;
+}
+
+void allreduce(DistMatrix &d, double *v, int count) {
+    double t0 = MPI_Wtime();
+    MPI_Allreduce(MPI_IN_PLACE, v, count, MPI_DOUBLE, MPI_SUM, d.comm);
+    d.t[T_REDUCE] += MPI_Wtime() - t0;
+}
+
+/*
+ * Solve A x = b; x holds the initial guess. Returns the iteration count and leaves the
+ * final ||r|| / ||b|| (from the recurrence) in *relres.
+ *
+ *  CG            textbook CG: two allreduces per iteration, (p, Ap) and then (r, r).
+ *  CG_FUSED      Chronopoulos-Gear: keeps s = A p as a recurrence and multiplies w = A r
+ *                instead, so (r, r) and (w, r) are known together and share one allreduce.
+ *  CG_PIPELINED  Ghysels-Vanroose: also keeps w = A r and z = A s as recurrences, so the
+ *                one multiply per iteration, q = A w, does not depend on the dot products;
+ *                the allreduce is started with MPI_Iallreduce and completes during it.
+ */
+int solve(DistMatrix &d, method m, const double *b, double *x, double tol, int maxit,
+          double *relres) {
+    int n = d.nlocal, ext = d.nlocal + d.nghost, it;
+    vector<double> r(ext), p(ext), w(ext), s(n), z(n), q(n);
+    double bb = dot(n, b, b), gamma, gamma_old = 0.0, alpha = 0.0, beta;
+    allreduce(d, &bb, 1);
+
+    spmv(d, x, q.data());
+    double t0 = MPI_Wtime();
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        r[i] = b[i] - q[i];
+        p[i] = r[i];
+    }
+    d.t[T_VECTOR] += MPI_Wtime() - t0;
+
+    if (m == CG) {
+        gamma = dot(n, r.data(), r.data());
+        allreduce(d, &gamma, 1);
+        for (it = 0; it < maxit && sqrt(gamma / bb) > tol; it++) {
+            spmv(d, p.data(), q.data());
+            t0 = MPI_Wtime();
+            double pq = dot(n, p.data(), q.data());
+            d.t[T_VECTOR] += MPI_Wtime() - t0;
+            allreduce(d, &pq, 1);
+            alpha = gamma / pq;
+
+            t0 = MPI_Wtime();
+            double rr = 0.0;
+            #pragma omp parallel for reduction(+ : rr)
+            for (int i = 0; i < n; i++) {
+                x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                rr += r[i] * r[i];
+            }
+            d.t[T_VECTOR] += MPI_Wtime() - t0;
+            allreduce(d, &rr, 1);
+            beta = rr / gamma;
+            gamma = rr;
+
+            t0 = MPI_Wtime();
+            #pragma omp parallel for
+            for (int i = 0; i < n; i++)
+                p[i] = r[i] + beta * p[i];
+            d.t[T_VECTOR] += MPI_Wtime() - t0;
+        }
+        *relres = sqrt(gamma / bb);
+        return it;
+    }
+
+    /* Fused and pipelined variants: w = A r from here on */
+    spmv(d, r.data(), w.data());
+    MPI_Request req;
+    for (it = 0; it < maxit; it++) {
+        double g[2];                         /* (r, r) and (w, r) */
+        t0 = MPI_Wtime();
+        double rr = 0.0, wr = 0.0;
+        #pragma omp parallel for reduction(+ : rr, wr)
+        for (int i = 0; i < n; i++) {
+            rr += r[i] * r[i];
+            wr += w[i] * r[i];
+        }
+        g[0] = rr;
+        g[1] = wr;
+        d.t[T_VECTOR] += MPI_Wtime() - t0;
+
+        if (m == CG_PIPELINED) {
+            MPI_Iallreduce(MPI_IN_PLACE, g, 2, MPI_DOUBLE, MPI_SUM, d.comm, &req);
+            spmv(d, w.data(), q.data());    /* overlaps the reduction */
+            t0 = MPI_Wtime();
+            MPI_Wait(&req, MPI_STATUS_IGNORE);
+            d.t[T_REDUCE] += MPI_Wtime() - t0;
+        } else {
+            allreduce(d, g, 2);
+        }
+        gamma = g[0];
+        if (sqrt(gamma / bb) <= tol)
+            break;
+        if (it == 0) {
+            beta = 0.0;
+            alpha = gamma / g[1];
+        } else {
+            beta = gamma / gamma_old;
+            alpha = gamma / (g[1] - beta * gamma / alpha);
+        }
+        gamma_old = gamma;
+
+        t0 = MPI_Wtime();
+        if (m == CG_PIPELINED) {
+            #pragma omp parallel for
+            for (int i = 0; i < n; i++) {
+                z[i] = q[i] + beta * z[i];
+                s[i] = w[i] + beta * s[i];
+                p[i] = r[i] + beta * p[i];
+                x[i] += alpha * p[i];
+                r[i] -= alpha * s[i];
+                w[i] -= alpha * z[i];
+            }
+            d.t[T_VECTOR] += MPI_Wtime() - t0;
+        } else {
+            #pragma omp parallel for
+            for (int i = 0; i < n; i++) {
+                s[i] = w[i] + beta * s[i];
+                p[i] = r[i] + beta * p[i];
+                x[i] += alpha * p[i];
+                r[i] -= alpha * s[i];
+            }
+            d.t[T_VECTOR] += MPI_Wtime() - t0;
+            spmv(d, r.data(), w.data());
+        }
+    }
+    *relres = sqrt(gamma / bb);
+    return it;
+}
+
+int main(int argc, char *argv[]) {
+    int numtasks, rank, provided;
+    int n = (argc > 1) ? atoi(argv[1]) : GRID;
+    const char *which = (argc > 2) ? argv[2] : "all";
+    double tol = (argc > 3) ? atof(argv[3]) : TOL;
+    int maxit = (argc > 4) ? atoi(argv[4]) : MAXIT;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    /***** Distribute the matrix; the exact solution is x = 1, so b = A * 1 *****/
+    DistMatrix d;
+    Coo a;
+    long row0;
+    int nlocal;
+    block((long)n * n, rank, numtasks, &row0, &nlocal);
+    laplace2d_rows(n, row0, nlocal, a);
+    setup(d, a, (long)n * n, MPI_COMM_WORLD);
+
+    int ext = d.nlocal + d.nghost;
+    vector<double> ones(ext, 1.0), b(ext), x(ext);
+    spmv(d, ones.data(), b.data());
+
+    int nbrmax, nbrs = (int)d.nbr.size(), ghostmax;
+    MPI_Reduce(&nbrs, &nbrmax, 1, MPI_INT, MPI_MAX, MASTER, MPI_COMM_WORLD);
+    MPI_Reduce(&d.nghost, &ghostmax, 1, MPI_INT, MPI_MAX, MASTER, MPI_COMM_WORLD);
+    if (rank == MASTER) {
+        printf("2D Laplacian %d x %d (%ld unknowns, %ld nonzeros on task 0), %d tasks x %d threads\n",
+               n, n, d.nglobal, d.A.rowptr[d.nlocal], numtasks, omp_get_max_threads());
+        printf("Halo: up to %d neighbours and %d ghost entries per task\n\n", nbrmax, ghostmax);
+        printf("%-13s %6s %10s %10s %9s %11s  ", "method", "iters", "||r||/||b||",
+               "error", "time s", "ms/iter");
+        for (int k = 0; k < NTIMERS; k++)
+            printf(" %9s", timer_names[k]);
+        printf("\n");
+    }
+
+    for (int m = CG; m < NMETHODS; m++) {
+        if (strcmp(which, "all") && strcmp(which, method_names[m]))
+            continue;
+        fill(x.begin(), x.end(), 0.0);
+        memset(d.t, 0, sizeof(d.t));
+        double relres;
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t = MPI_Wtime();
+        int iters = solve(d, (method)m, b.data(), x.data(), tol, maxit, &relres);
+        t = MPI_Wtime() - t;
+
+        /* Error against the exact solution */
+        double err = 0.0, errmax;
+        for (int i = 0; i < d.nlocal; i++)
+            err = max(err, fabs(x[i] - 1.0));
+        double tmax[NTIMERS + 1], tl[NTIMERS + 1];
+        memcpy(tl, d.t, sizeof(d.t));
+        tl[NTIMERS] = t;
+        MPI_Reduce(&err, &errmax, 1, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+        MPI_Reduce(tl, tmax, NTIMERS + 1, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+
+        if (rank == MASTER) {
+            double per = 1e3 / max(iters, 1);
+            printf("%-13s %6d %10.2e %10.2e %9.3f %11.4f  ", method_names[m], iters, relres,
+                   errmax, tmax[NTIMERS], tmax[NTIMERS] * per);
+            for (int k = 0; k < NTIMERS; k++)
+                printf(" %8.4f", tmax[k] * per);
+            printf("\n");
+        }
+    }
+    if (rank == MASTER)
+        printf("\nAllreduces per iteration: cg 2, cg-fused 1, cg-pipelined 1 (overlapped with the SpMV)\n"
+               "Times per category are the maximum over tasks.\n");
+
+    MPI_Finalize();
+    return 0;
+}
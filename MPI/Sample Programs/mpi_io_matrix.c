@@ -0,0 +1,115 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "dist_io.h"
+
+#define  MASTER   0
+#define  ROWS     4096            /* Default matrix size: 4096 x 4096 doubles = 128 MB */
+#define  COLS     4096
+
+const char *layout_names[3] = {"rows", "cols", "blocks"};
+
+/* Value stored at global position (i, j); equal to its index in the file */
+double value_at(long i, long j, int cols) {
+    return (double)(i * cols + j);
+}
+
+int check(int rc, const char *what, int rank) {
+    char msg[MPI_MAX_ERROR_STRING];
+    int len;
+    if (rc != MPI_SUCCESS) {
+        MPI_Error_string(rc, msg, &len);
+        printf("Task %d: %s failed: %s\n", rank, what, msg);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    int numtasks, rank, layout, i, j, bad, allbad, count;
+    int rows = (argc > 1) ? atoi(argv[1]) : ROWS;
+    int cols = (argc > 2) ? atoi(argv[2]) : COLS;
+    const char *path = (argc > 3) ? argv[3] : "matrix.bin";
+    double gbytes = (double)rows * cols * sizeof(double) / 1e9;
+    double t, mysum, sum, expected;
+    double *local;
+    dio_matrix_block b;
+    MPI_Offset start;
+    MPI_Info info;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+    dio_default_hints(&info);
+
+    if (rank == MASTER)
+        printf("Matrix %d x %d (%.3f GB) in %s, %d tasks\n", rows, cols, gbytes, path, numtasks);
+
+    /***** Every task writes its own 2D block of the matrix *****/
+    dio_matrix_decompose(rows, cols, DIO_BLOCKS, MPI_COMM_WORLD, &b);
+    local = (double *)malloc((size_t)b.lsizes[0] * b.lsizes[1] * sizeof(double));
+    for (i = 0; i < b.lsizes[0]; i++)
+        for (j = 0; j < b.lsizes[1]; j++)
+            local[(long)i * b.lsizes[1] + j] = value_at(b.starts[0] + i, b.starts[1] + j, cols);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    t = MPI_Wtime();
+    check(dio_write_matrix(path, local, &b, MPI_COMM_WORLD, info), "write", rank);
+    t = MPI_Wtime() - t;
+    if (rank == MASTER)
+        printf("Write (%d x %d grid of blocks): %8.3f s  %8.3f GB/s\n",
+               b.dims[0], b.dims[1], t, gbytes / t);
+    free(local);
+
+    /***** Read the same file back with every layout and check each element *****/
+    expected = (double)rows * cols * ((double)rows * cols - 1) / 2.0;
+    for (layout = DIO_ROWS; layout <= DIO_BLOCKS; layout++) {
+        dio_matrix_decompose(rows, cols, (dio_layout)layout, MPI_COMM_WORLD, &b);
+        local = (double *)malloc((size_t)b.lsizes[0] * b.lsizes[1] * sizeof(double) + 1);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        t = MPI_Wtime();
+        check(dio_read_matrix(path, local, &b, MPI_COMM_WORLD, info), "read", rank);
+        t = MPI_Wtime() - t;
+
+        bad = 0;
+        mysum = 0.0;
+        for (i = 0; i < b.lsizes[0]; i++)
+            for (j = 0; j < b.lsizes[1]; j++) {
+                double v = local[(long)i * b.lsizes[1] + j];
+                if (v != value_at(b.starts[0] + i, b.starts[1] + j, cols))
+                    bad++;
+                mysum += v;
+            }
+        MPI_Reduce(&bad, &allbad, 1, MPI_INT, MPI_SUM, MASTER, MPI_COMM_WORLD);
+        MPI_Reduce(&mysum, &sum, 1, MPI_DOUBLE, MPI_SUM, MASTER, MPI_COMM_WORLD);
+        if (rank == MASTER)
+            printf("Read  (%-6s %4d x %-4d):    %8.3f s  %8.3f GB/s  sum= %e (expected %e)  %s\n",
+                   layout_names[layout], b.dims[0], b.dims[1], t, gbytes / t, sum, expected,
+                   allbad ? "MISMATCH" : "ok");
+        free(local);
+    }
+
+    /***** The matrix file is also a flat array of rows*cols doubles *****/
+    dio_array_decompose((MPI_Offset)rows * cols, rank, numtasks, &start, &count);
+    local = (double *)malloc((size_t)count * sizeof(double) + 1);
+    MPI_Barrier(MPI_COMM_WORLD);
+    t = MPI_Wtime();
+    check(dio_read_array(path, local, start, count, MPI_COMM_WORLD, info), "array read", rank);
+    t = MPI_Wtime() - t;
+    bad = 0;
+    for (i = 0; i < count; i++)
+        if (local[i] != (double)(start + i))
+            bad++;
+    MPI_Reduce(&bad, &allbad, 1, MPI_INT, MPI_SUM, MASTER, MPI_COMM_WORLD);
+    if (rank == MASTER)
+        printf("Read  (1D array):              %8.3f s  %8.3f GB/s  %s\n", t, gbytes / t,
+               allbad ? "MISMATCH" : "ok");
+    free(local);
+
+    MPI_Info_free(&info);
+    if (rank == MASTER && (argc <= 4 || atoi(argv[4]) == 0))
+        MPI_File_delete(path, MPI_INFO_NULL);
+    MPI_Finalize();
+    return 0;
+}
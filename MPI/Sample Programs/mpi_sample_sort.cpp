@@ -0,0 +1,266 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+#define  MASTER   0
+#define  NKEYS    100000000L     /* Default total number of keys over all ranks */
+#define  SAMPLES  64             /* Minimum regular samples taken per rank */
+
+using namespace std;
+
+/* A sample key together with where it sits: (key, rank, index in that rank's sorted
+   array). Ordering by this triple breaks ties between equal keys, so even inputs with
+   very few distinct keys are split into balanced partitions. */
+struct Sample {
+    long long key, rank, idx;
+};
+
+bool operator<(const Sample &a, const Sample &b) {
+    if (a.key != b.key) return a.key < b.key;
+    if (a.rank != b.rank) return a.rank < b.rank;
+    return a.idx < b.idx;
+}
+
+/* Per-rank xorshift generator, so every rank fills its keys independently */
+void fillupRandomly(int *m, long size, int min, int max, int rank) {
+    #pragma omp parallel
+    {
+        unsigned long long s = 88172645463325252ULL ^ ((unsigned long long)(rank + 1) << 32)
+                             ^ (unsigned long long)(omp_get_thread_num() + 1);
+        unsigned long long range = (unsigned long long)max - min + 1;
+        #pragma omp for schedule(static)
+        for (long i = 0; i < size; i++) {
+            s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+            m[i] = (int)(min + (long long)(s % range));
+        }
+    }
+}
+
+/* Number of elements of a[0..na) that are taken before output position k when merging
+   with b[0..nb) (elements of a go first on ties) */
+long coRank(long k, const int *a, long na, const int *b, long nb) {
+    long lo = (k > nb) ? k - nb : 0;
+    long hi = (k < na) ? k : na;
+    while (lo < hi) {
+        long i = (lo + hi) / 2, j = k - i;
+        if (j > 0 && i < na && a[i] <= b[j - 1])
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/* Merge two sorted arrays into out with all threads: the output is cut into one segment
+   per thread and each thread finds its starting point in a and b by binary search */
+void parallelMerge(const int *a, long na, const int *b, long nb, int *out) {
+    #pragma omp parallel
+    {
+        int nt = omp_get_num_threads(), t = omp_get_thread_num();
+        long k0 = (na + nb) * t / nt, k1 = (na + nb) * (t + 1) / nt;
+        long i0 = coRank(k0, a, na, b, nb), i1 = coRank(k1, a, na, b, nb);
+        merge(a + i0, a + i1, b + (k0 - i0), b + (k1 - i1), out + k0);
+    }
+}
+
+/* Merge the sorted runs X[bounds[r]..bounds[r+1]) pairwise until one run is left.
+   tmp must hold as many elements as X; the result ends up in X. */
+void mergeRuns(int *X, vector<long> bounds, int *tmp) {
+    long n = bounds.back();
+    int *src = X, *dst = tmp;
+
+    while (bounds.size() > 2) {
+        vector<long> next;
+        size_t runs = bounds.size() - 1;
+        for (size_t r = 0; r < runs; r += 2) {
+            next.push_back(bounds[r]);
+            if (r + 1 < runs)
+                parallelMerge(src + bounds[r], bounds[r + 1] - bounds[r],
+                              src + bounds[r + 1], bounds[r + 2] - bounds[r + 1], dst + bounds[r]);
+            else
+                memcpy(dst + bounds[r], src + bounds[r], (bounds[r + 1] - bounds[r]) * sizeof(int));
+        }
+        next.push_back(n);
+        bounds = next;
+        swap(src, dst);
+    }
+    if (src != X)
+        memcpy(X, src, n * sizeof(int));
+}
+
+/* Local parallel sort: each thread sorts one chunk, then the chunks are merged */
+void parallelSort(int *X, long n, int *tmp) {
+    int nt = omp_get_max_threads();
+    vector<long> bounds(nt + 1);
+    for (int t = 0; t <= nt; t++)
+        bounds[t] = n * t / nt;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < nt; t++)
+        sort(X + bounds[t], X + bounds[t + 1]);
+
+    mergeRuns(X, bounds, tmp);
+}
+
+/* Number of elements of the sorted local array that order before splitter s */
+long countBelow(const int *X, long n, int rank, const Sample &s) {
+    if (s.key > INT_MAX) return n;
+    if (s.key < INT_MIN) return 0;
+    int k = (int)s.key;
+    long lt = lower_bound(X, X + n, k) - X;
+    long le = upper_bound(X, X + n, k) - X;
+    if (rank < s.rank) return le;              /* all my copies of k come first */
+    if (rank > s.rank) return lt;              /* all my copies of k come after */
+    return (s.idx < le) ? max(lt, (long)s.idx) : le;
+}
+
+/* Distributed check: every rank is sorted locally, and no earlier rank holds a key
+   larger than this rank's first key. The boundary keys are exchanged with MPI_Exscan,
+   which also covers ranks that ended up empty. */
+int isSorted(const int *a, long size, MPI_Comm comm) {
+    int rank, ok = 1, all_ok;
+    int last = (size > 0) ? a[size - 1] : INT_MIN, prev_max = INT_MIN;
+
+    MPI_Comm_rank(comm, &rank);
+    for (long i = 0; i < size - 1; i++)
+        if (a[i] > a[i + 1]) {
+            ok = 0;
+            break;
+        }
+    MPI_Exscan(&last, &prev_max, 1, MPI_INT, MPI_MAX, comm);
+    if (rank > 0 && size > 0 && prev_max > a[0])
+        ok = 0;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    return all_ok;
+}
+
+int main(int argc, char *argv[]) {
+    int numtasks, rank;
+    long N = (argc > 1) ? atol(argv[1]) : NKEYS;
+    int minKey = (argc > 2) ? atoi(argv[2]) : 0;
+    int maxKey = (argc > 3) ? atoi(argv[3]) : INT_MAX - 1;
+    int numThreads = (argc > 4) ? atoi(argv[4]) : 0;
+    int provided;
+    double stamp[5], t[5], tmax[5];
+    const char *phase[5] = {"local sort", "sample", "exchange", "merge", "total"};
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+    if (numThreads > 0) {
+        omp_set_dynamic(0);
+        omp_set_num_threads(numThreads);
+    }
+
+    /* Balanced initial block of the N keys */
+    long n = N / numtasks + (rank < N % numtasks ? 1 : 0);
+    int *X = (int *)malloc(n * sizeof(int) + 1);
+    int *tmp = (int *)malloc(n * sizeof(int) + 1);
+    if (!X || !tmp) {
+        printf("Task %d: could not allocate %ld keys\n", rank, n);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    fillupRandomly(X, n, minKey, maxKey, rank);
+
+    long long checksum = 0, checksumAll, checksumAfter;
+    #pragma omp parallel for reduction(+ : checksum)
+    for (long i = 0; i < n; i++)
+        checksum += X[i];
+    MPI_Allreduce(&checksum, &checksumAll, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    if (rank == MASTER)
+        printf("Sorting %ld keys in [%d, %d] on %d tasks x %d threads\n",
+               N, minKey, maxKey, numtasks, omp_get_max_threads());
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    stamp[0] = MPI_Wtime();
+
+    /***** 1. Local parallel sort *****/
+    parallelSort(X, n, tmp);
+    stamp[1] = MPI_Wtime();
+
+    /***** 2. Regular sampling and splitter selection *****/
+    int s = max(numtasks - 1, SAMPLES);
+    vector<Sample> mine(s), all((size_t)s * numtasks);
+    for (int i = 0; i < s; i++) {
+        long idx = n * (i + 1) / (s + 1);
+        mine[i].key = (idx < n) ? X[idx] : (long long)INT_MAX + 1;
+        mine[i].rank = rank;
+        mine[i].idx = idx;
+    }
+    MPI_Allgather(mine.data(), 3 * s, MPI_LONG_LONG, all.data(), 3 * s, MPI_LONG_LONG,
+                  MPI_COMM_WORLD);
+    sort(all.begin(), all.end());
+    vector<Sample> splitters(numtasks - 1);
+    for (int i = 0; i < numtasks - 1; i++)
+        splitters[i] = all[(i + 1) * all.size() / numtasks];
+    stamp[2] = MPI_Wtime();
+
+    /***** 3. Exchange: keys below splitter i that are not below splitter i-1 go to rank i *****/
+    vector<int> sendcounts(numtasks), sdispls(numtasks), recvcounts(numtasks), rdispls(numtasks);
+    long prevCut = 0;
+    for (int i = 0; i < numtasks; i++) {
+        long cut = (i < numtasks - 1) ? countBelow(X, n, rank, splitters[i]) : n;
+        if (cut < prevCut) cut = prevCut;
+        sendcounts[i] = (int)(cut - prevCut);
+        sdispls[i] = (int)prevCut;
+        prevCut = cut;
+    }
+    MPI_Alltoall(sendcounts.data(), 1, MPI_INT, recvcounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    long m = 0;
+    for (int i = 0; i < numtasks; i++) {
+        rdispls[i] = (int)m;
+        m += recvcounts[i];
+    }
+    int *Y = (int *)malloc(m * sizeof(int) + 1);
+    MPI_Alltoallv(X, sendcounts.data(), sdispls.data(), MPI_INT,
+                  Y, recvcounts.data(), rdispls.data(), MPI_INT, MPI_COMM_WORLD);
+    stamp[3] = MPI_Wtime();
+
+    /***** 4. k-way merge of the sorted runs received from every rank *****/
+    free(X);
+    free(tmp);
+    tmp = (int *)malloc(m * sizeof(int) + 1);
+    vector<long> bounds(numtasks + 1);
+    for (int i = 0; i < numtasks; i++)
+        bounds[i] = rdispls[i];
+    bounds[numtasks] = m;
+    mergeRuns(Y, bounds, tmp);
+    stamp[4] = MPI_Wtime();
+
+    for (int i = 0; i < 4; i++)
+        t[i] = stamp[i + 1] - stamp[i];
+    t[4] = stamp[4] - stamp[0];
+    MPI_Reduce(t, tmax, 5, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+
+    /***** Check: sorted across ranks, nothing lost, partitions balanced *****/
+    int sorted = isSorted(Y, m, MPI_COMM_WORLD);
+    checksum = 0;
+    #pragma omp parallel for reduction(+ : checksum)
+    for (long i = 0; i < m; i++)
+        checksum += Y[i];
+    MPI_Allreduce(&checksum, &checksumAfter, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    long mmin, mmax, total;
+    MPI_Reduce(&m, &mmin, 1, MPI_LONG, MPI_MIN, MASTER, MPI_COMM_WORLD);
+    MPI_Reduce(&m, &mmax, 1, MPI_LONG, MPI_MAX, MASTER, MPI_COMM_WORLD);
+    MPI_Reduce(&m, &total, 1, MPI_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+
+    if (rank == MASTER) {
+        for (int i = 0; i < 5; i++)
+            printf("  %-12s %10.4f s\n", phase[i], tmax[i]);
+        printf("Keys per task: min %ld  max %ld  avg %.0f  (imbalance %.3f)\n",
+               mmin, mmax, (double)total / numtasks, mmax / ((double)total / numtasks));
+        printf("Sorted: %s   keys preserved: %s\n", sorted ? "yes" : "NO",
+               (total == N && checksumAfter == checksumAll) ? "yes" : "NO");
+    }
+
+    free(Y);
+    free(tmp);
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,364 @@
+#include "mpi.h"
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace std;
+
+#define MASTER        0
+#define NVERTICES     1000000     // Default number of vertices of the random graph
+#define DEGREE        16          // Out-edges per vertex of the random graph
+#define MAXW          100         // Edge weights are drawn from 1..MAXW
+#define VALIDATE_MAX  4096        // Graphs up to this size are checked against dijkstra_distance
+
+const int i4_huge = 2147483647;
+
+struct Req {
+    int v;      // global target vertex
+    int d;      // tentative distance offered for it
+};
+
+struct Stats {
+    long relaxations;   // relaxation requests generated
+    long phases;        // request exchange rounds
+    long buckets;       // buckets settled
+    long bytes;         // request bytes sent to other ranks
+};
+
+// Graph description shared by every rank. Each rank only stores the out-edges of its own
+// block of vertices (1D vertex partition), but any rank can regenerate any vertex's edges.
+struct Graph {
+    int n;
+    int degree;
+    bool example;       // use the six-node graph from dijkstra.cpp instead of a random one
+
+    // Owner of global vertex v under the balanced block partition
+    int owner(int v, int p) const {
+        int q = n / p, r = n % p;
+        return (v < r * (q + 1)) ? v / (q + 1) : r + (v - r * (q + 1)) / q;
+    }
+    int first(int rank, int p) const {
+        int q = n / p, r = n % p;
+        return rank * q + (rank < r ? rank : r);
+    }
+    void edges(int v, vector<Req> &out) const;
+};
+
+void Graph::edges(int v, vector<Req> &out) const {
+    //  Purpose: EDGES lists the out-edges of vertex V as (target, weight) pairs.
+    //  The example graph is the one drawn in INIT of dijkstra.cpp. The random graph
+    //  links every vertex to V+1 (so everything is reachable from node 0) and to
+    //  DEGREE-1 pseudo-random targets, with weights derived from a hash of (V, K).
+    static const int ex[8][3] = {{0, 1, 40}, {0, 2, 15}, {1, 2, 20}, {1, 3, 10},
+                                 {1, 4, 25}, {2, 3, 100}, {1, 5, 6}, {4, 5, 8}};
+    out.clear();
+    if (example) {
+        for (int e = 0; e < 8; e++) {
+            if (ex[e][0] == v) out.push_back({ex[e][1], ex[e][2]});
+            if (ex[e][1] == v) out.push_back({ex[e][0], ex[e][2]});
+        }
+        return;
+    }
+    for (int k = 0; k < degree; k++) {
+        unsigned long long h = (unsigned long long)v * 0x9E3779B97F4A7C15ULL + k + 1;
+        h ^= h >> 31; h *= 0xBF58476D1CE4E5B9ULL; h ^= h >> 29;
+        int target = (k == 0) ? (v + 1) % n : (int)(h % n);
+        out.push_back({target, 1 + (int)((h >> 40) % MAXW)});
+    }
+}
+
+// Local part of the graph in CSR form
+struct LocalCSR {
+    int lo, hi;
+    vector<long> rowptr;
+    vector<int> col, w;
+};
+
+void build_local(const Graph &g, int rank, int p, LocalCSR &csr) {
+    vector<Req> e;
+    csr.lo = g.first(rank, p);
+    csr.hi = g.first(rank + 1, p);
+    csr.rowptr.assign(1, 0);
+    for (int v = csr.lo; v < csr.hi; v++) {
+        g.edges(v, e);
+        for (size_t k = 0; k < e.size(); k++) {
+            csr.col.push_back(e[k].v);
+            csr.w.push_back(e[k].d);
+        }
+        csr.rowptr.push_back(csr.col.size());
+    }
+}
+
+// Buckets of delta-stepping with lazy deletion: a vertex may sit in several buckets, but
+// only the entry matching in_bucket[v] is live
+struct Buckets {
+    vector<vector<int> > b;
+    vector<long> in_bucket;
+
+    void push(int lv, long idx) {
+        if (in_bucket[lv] == idx) return;
+        if ((long)b.size() <= idx) b.resize(idx + 1);
+        b[idx].push_back(lv);
+        in_bucket[lv] = idx;
+    }
+    // Index of the first bucket at or after `from` holding a live entry, or LONG_MAX
+    long next_nonempty(long from) {
+        for (long i = from; i < (long)b.size(); i++) {
+            size_t k = 0;
+            while (k < b[i].size() && in_bucket[b[i][k]] != i) k++;
+            if (k < b[i].size()) return i;
+            b[i].clear();
+        }
+        return LONG_MAX;
+    }
+};
+
+// Send every batch out[r] to rank r and apply the requests this rank receives
+void exchange(vector<vector<Req> > &out, const LocalCSR &csr, vector<int> &dist,
+              Buckets &bk, int delta, Stats &st) {
+    int rank, p;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+    vector<int> scount(p), sdispl(p), rcount(p), rdispl(p);
+    vector<Req> sendbuf, recvbuf;
+    for (int r = 0; r < p; r++) {
+        sdispl[r] = sendbuf.size();
+        scount[r] = out[r].size();
+        sendbuf.insert(sendbuf.end(), out[r].begin(), out[r].end());
+        if (r != rank) st.bytes += scount[r] * sizeof(Req);
+        out[r].clear();
+    }
+    MPI_Alltoall(scount.data(), 1, MPI_INT, rcount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int total = 0;
+    for (int r = 0; r < p; r++) {
+        rdispl[r] = total;
+        total += rcount[r];
+    }
+    recvbuf.resize(total);
+    MPI_Alltoallv(sendbuf.data(), scount.data(), sdispl.data(), MPI_2INT,
+                  recvbuf.data(), rcount.data(), rdispl.data(), MPI_2INT, MPI_COMM_WORLD);
+    st.phases++;
+
+    for (int k = 0; k < total; k++) {
+        int lv = recvbuf[k].v - csr.lo;
+        if (recvbuf[k].d < dist[lv]) {
+            dist[lv] = recvbuf[k].d;
+            bk.push(lv, dist[lv] / delta);
+        }
+    }
+}
+
+// Batch one relaxation request per edge of the listed vertices, light (w <= delta) or heavy
+void relax_edges(const vector<int> &verts, bool light, const Graph &g, const LocalCSR &csr,
+                 const vector<int> &dist, int delta, int p, vector<vector<Req> > &out, Stats &st) {
+    for (size_t i = 0; i < verts.size(); i++) {
+        int lv = verts[i];
+        for (long e = csr.rowptr[lv]; e < csr.rowptr[lv + 1]; e++) {
+            if ((csr.w[e] <= delta) != light) continue;
+            out[g.owner(csr.col[e], p)].push_back({csr.col[e], dist[lv] + csr.w[e]});
+            st.relaxations++;
+        }
+    }
+}
+
+vector<int> delta_stepping(const Graph &g, const LocalCSR &csr, int source, int delta, Stats &st) {
+    //  Purpose: DELTA_STEPPING computes the distances from SOURCE to the local vertices.
+    //  Description:
+    //    Vertices are kept in buckets of width DELTA by tentative distance. The lowest
+    //    non-empty bucket over all ranks is settled by repeatedly relaxing the light
+    //    edges of its vertices until no rank adds anything to it; then the heavy edges
+    //    of every vertex removed from it are relaxed once. Each relaxation round batches
+    //    the requests per owning rank and exchanges them with a single MPI_Alltoallv.
+    int rank, p;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+    int nlocal = csr.hi - csr.lo;
+    vector<int> dist(nlocal, i4_huge);
+    Buckets bk;
+    bk.in_bucket.assign(nlocal, -1);
+    vector<vector<Req> > out(p);
+    vector<int> frontier, settled;
+
+    if (source >= csr.lo && source < csr.hi) {
+        dist[source - csr.lo] = 0;
+        bk.push(source - csr.lo, 0);
+    }
+
+    long cur = 0;
+    while (true) {
+        long mine = bk.next_nonempty(cur), all;
+        MPI_Allreduce(&mine, &all, 1, MPI_LONG, MPI_MIN, MPI_COMM_WORLD);
+        if (all == LONG_MAX) break;
+        cur = all;
+        st.buckets++;
+        settled.clear();
+
+        //  Light edges: vertices can re-enter bucket CUR, so repeat until it stays empty
+        int active = 1;
+        while (active) {
+            frontier.clear();
+            if (cur < (long)bk.b.size()) {
+                vector<int> &items = bk.b[cur];
+                for (size_t k = 0; k < items.size(); k++) {
+                    if (bk.in_bucket[items[k]] != cur) continue;
+                    bk.in_bucket[items[k]] = -1;
+                    frontier.push_back(items[k]);
+                }
+                items.clear();
+            }
+            settled.insert(settled.end(), frontier.begin(), frontier.end());
+            relax_edges(frontier, true, g, csr, dist, delta, p, out, st);
+            exchange(out, csr, dist, bk, delta, st);
+            int local = (cur < (long)bk.b.size() && !bk.b[cur].empty());
+            MPI_Allreduce(&local, &active, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+        }
+
+        //  Heavy edges cannot land in bucket CUR, so one round is enough. A vertex that
+        //  re-entered the bucket is in SETTLED once per round it was removed in.
+        sort(settled.begin(), settled.end());
+        settled.erase(unique(settled.begin(), settled.end()), settled.end());
+        relax_edges(settled, false, g, csr, dist, delta, p, out, st);
+        exchange(out, csr, dist, bk, delta, st);
+        cur++;
+    }
+    return dist;
+}
+
+int *dijkstra_distance(int nv, int *ohd) {
+    //  Purpose: DIJKSTRA_DISTANCE is the serial version of the routine in dijkstra.cpp,
+    //  for an NV x NV distance matrix OHD stored row by row (OHD[I*NV+J]).
+    //  Output, int DIJKSTRA_DISTANCE[NV], the minimum distance from node 0 to each node.
+    bool *connected = new bool[nv];
+    int *mind = new int[nv];
+    int i, md, mv, step;
+
+    for (i = 0; i < nv; i++) {
+        connected[i] = (i == 0);
+        mind[i] = ohd[i];
+    }
+    for (step = 1; step < nv; step++) {
+        md = i4_huge;
+        mv = -1;
+        for (i = 0; i < nv; i++) {
+            if (!connected[i] && mind[i] < md) {
+                md = mind[i];
+                mv = i;
+            }
+        }
+        if (mv == -1) break;
+        connected[mv] = true;
+        for (i = 0; i < nv; i++) {
+            if (!connected[i] && ohd[mv * nv + i] < i4_huge && mind[mv] + ohd[mv * nv + i] < mind[i]) {
+                mind[i] = mind[mv] + ohd[mv * nv + i];
+            }
+        }
+    }
+    delete[] connected;
+    return mind;
+}
+
+// Run delta-stepping on G and, for small graphs, compare with dijkstra_distance on rank 0
+void run(const Graph &g, int delta, bool print) {
+    int rank, p;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+    LocalCSR csr;
+    build_local(g, rank, p, csr);
+    Stats st = {0, 0, 0, 0}, tot;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double wtime = MPI_Wtime();
+    vector<int> dist = delta_stepping(g, csr, 0, delta, st);
+    wtime = MPI_Wtime() - wtime;
+
+    MPI_Reduce(&st.relaxations, &tot.relaxations, 1, MPI_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+    MPI_Reduce(&st.bytes, &tot.bytes, 1, MPI_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+    tot.phases = st.phases;
+    tot.buckets = st.buckets;
+
+    long reached = 0, allreached;
+    for (size_t i = 0; i < dist.size(); i++)
+        if (dist[i] < i4_huge) reached++;
+    MPI_Reduce(&reached, &allreached, 1, MPI_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+
+    if (rank == MASTER) {
+        cout << "\n";
+        cout << "  Graph: " << g.n << " vertices, "
+             << (g.example ? "example from dijkstra.cpp" : "random") << ", delta = " << delta << "\n";
+        cout << "  Time:             " << setw(12) << wtime << " s\n";
+        cout << "  Reached vertices: " << setw(12) << allreached << "\n";
+        cout << "  Buckets settled:  " << setw(12) << tot.buckets << "\n";
+        cout << "  Exchange phases:  " << setw(12) << tot.phases << "\n";
+        cout << "  Relaxations:      " << setw(12) << tot.relaxations << "\n";
+        cout << "  Bytes exchanged:  " << setw(12) << tot.bytes << "\n";
+    }
+
+    if (g.n > VALIDATE_MAX) return;
+
+    //  Collect all distances on the master and compare with the serial algorithm
+    vector<int> counts(p), displs(p), all(g.n);
+    for (int r = 0; r < p; r++) {
+        displs[r] = g.first(r, p);
+        counts[r] = g.first(r + 1, p) - displs[r];
+    }
+    MPI_Gatherv(dist.data(), dist.size(), MPI_INT, all.data(), counts.data(), displs.data(),
+                MPI_INT, MASTER, MPI_COMM_WORLD);
+    if (rank != MASTER) return;
+
+    int *ohd = new int[(long)g.n * g.n];
+    vector<Req> e;
+    for (long k = 0; k < (long)g.n * g.n; k++)
+        ohd[k] = i4_huge;
+    for (int v = 0; v < g.n; v++) {
+        ohd[(long)v * g.n + v] = 0;
+        g.edges(v, e);
+        for (size_t k = 0; k < e.size(); k++)
+            if (e[k].d < ohd[(long)v * g.n + e[k].v])
+                ohd[(long)v * g.n + e[k].v] = e[k].d;
+    }
+    int *mind = dijkstra_distance(g.n, ohd);
+    int wrong = 0;
+    for (int v = 0; v < g.n; v++)
+        if (mind[v] != all[v]) wrong++;
+    if (print) {
+        cout << "\n  Minimum distances from node 0:\n\n";
+        for (int v = 0; v < g.n; v++)
+            cout << "  " << setw(2) << v << "  " << setw(2) << all[v] << "\n";
+    }
+    cout << "  Check against dijkstra_distance: "
+         << (wrong ? "FAILED" : "ok") << " (" << wrong << " mismatches)\n";
+    delete[] ohd;
+    delete[] mind;
+}
+
+int main(int argc, char *argv[]) {
+    int numtasks, rank;
+    int n = (argc > 1) ? atoi(argv[1]) : NVERTICES;
+    int degree = (argc > 2) ? atoi(argv[2]) : DEGREE;
+    int delta = (argc > 3) ? atoi(argv[3]) : MAXW / 4;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    if (rank == MASTER)
+        cout << "DELTA-STEPPING SSSP on " << numtasks << " tasks\n";
+
+    //  The six-node example first; the correct distances are 0 35 15 45 49 41
+    Graph example = {6, 0, true};
+    run(example, 10, true);
+
+    Graph g = {n, degree, false};
+    run(g, delta, false);
+
+    if (rank == MASTER)
+        cout << "\n  Normal end of execution.\n";
+    MPI_Finalize();
+    return 0;
+}
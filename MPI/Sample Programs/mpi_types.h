@@ -0,0 +1,139 @@
+#ifndef MPI_TYPES_H
+#define MPI_TYPES_H
+
+#include "mpi.h"
+#include <map>
+#include <vector>
+
+/*
+ * Committed MPI datatypes for strided pieces of row-major arrays, built once per shape
+ * and cached, so columns, sub-blocks and halo faces are sent and received straight
+ * from the arrays instead of through pack buffers.
+ *
+ *   DatatypeCache types;
+ *   MPI_Send(a + j, 1, types.column(rows, ld), dest, tag, comm);            column j
+ *   MPI_Recv(c + i0 * ld + j0, 1, types.block2d(m, n, ld), src, tag, comm, &st);
+ *
+ * A type describes a shape relative to its first element, not a position in a
+ * particular array: the buffer address picks the position. One type therefore serves
+ * every column of a matrix, and every block of the same size. Such a type has the
+ * signature of count doubles, so the other side may receive it into a plain contiguous
+ * buffer of that many, and the other way round.
+ *
+ * Everything is built from box(): counts and strides (in elements) of up to a few
+ * nested dimensions, outermost first. A contiguous innermost dimension becomes the block
+ * length of an MPI_Type_vector over the next one, and further dimensions wrap that in
+ * MPI_Type_create_hvector; dimensions of count 1 are dropped.
+ *
+ * The cache frees its types in clear() or its destructor, which must run before
+ * MPI_Finalize; one that runs later leaves them to MPI_Finalize.
+ */
+
+class DatatypeCache {
+public:
+    long builds = 0, hits = 0;
+
+    DatatypeCache() {}
+    DatatypeCache(const DatatypeCache &) = delete;
+    DatatypeCache &operator=(const DatatypeCache &) = delete;
+    ~DatatypeCache() {
+        int finalized;
+        MPI_Finalized(&finalized);
+        if (!finalized)
+            clear();
+    }
+
+    /* count[0..ndims) elements per dimension, stride[0..ndims) elements between
+       neighbours in it, outermost dimension first */
+    MPI_Datatype box(int ndims, const int *count, const long *stride, MPI_Datatype base = MPI_DOUBLE) {
+        std::vector<long> key;
+        for (int d = 0; d < ndims; d++) {
+            if (count[d] == 1)
+                continue;
+            key.push_back(count[d]);
+            key.push_back(count[d] == 0 ? 0 : stride[d]);
+        }
+        std::map<std::vector<long>, MPI_Datatype> &shapes = cache[base];
+        auto it = shapes.find(key);
+        if (it != shapes.end()) {
+            hits++;
+            return it->second;
+        }
+        builds++;
+        return shapes[key] = build(key, base);
+    }
+
+    /* One column of a matrix with row length ld */
+    MPI_Datatype column(int rows, long ld, MPI_Datatype base = MPI_DOUBLE) {
+        return box(1, &rows, &ld, base);
+    }
+
+    /* A rows x cols block of a matrix with row length ld */
+    MPI_Datatype block2d(int rows, int cols, long ld, MPI_Datatype base = MPI_DOUBLE) {
+        int count[2] = {rows, cols};
+        long stride[2] = {ld, 1};
+        return box(2, count, stride, base);
+    }
+
+    /* An ni x nj x nk block of a 3D array whose i and j strides are si and sj */
+    MPI_Datatype block3d(int ni, int nj, int nk, long si, long sj, MPI_Datatype base = MPI_DOUBLE) {
+        int count[3] = {ni, nj, nk};
+        long stride[3] = {si, sj, 1};
+        return box(3, count, stride, base);
+    }
+
+    /* The face normal to `axis` (0, 1 or 2) of the interior of an array with a one-cell
+       halo and extents ext[] including the halo: one layer, interior in the other two
+       axes. Send it from the first interior element of the layer, e.g. for axis 1 and
+       layer j, from a + 1 * si + j * sj + 1. */
+    MPI_Datatype halo_face(const int ext[3], int axis, MPI_Datatype base = MPI_DOUBLE) {
+        int n[3] = {ext[0] - 2, ext[1] - 2, ext[2] - 2};
+        n[axis] = 1;
+        return block3d(n[0], n[1], n[2], (long)ext[1] * ext[2], ext[2], base);
+    }
+
+    void clear() {
+        for (auto &b : cache)
+            for (auto &s : b.second)
+                MPI_Type_free(&s.second);
+        cache.clear();
+    }
+
+private:
+    std::map<MPI_Datatype, std::map<std::vector<long>, MPI_Datatype>> cache;
+
+    /* key holds (count, stride) pairs, outermost first */
+    static MPI_Datatype build(const std::vector<long> &key, MPI_Datatype base) {
+        MPI_Aint lb, extent;
+        MPI_Type_get_extent(base, &lb, &extent);
+        int d = (int)key.size() / 2 - 1;
+        MPI_Datatype t, next;
+        if (d < 0) {
+            MPI_Type_dup(base, &t);
+            MPI_Type_commit(&t);
+            return t;
+        }
+
+        /* Innermost: a contiguous run becomes the block length of the next dimension */
+        int block = 1;
+        if (key[2 * d + 1] == 1) {
+            block = (int)key[2 * d];
+            d--;
+        }
+        if (d < 0) {
+            MPI_Type_contiguous(block, base, &t);
+        } else {
+            MPI_Type_vector((int)key[2 * d], block, (int)key[2 * d + 1], base, &t);
+            d--;
+        }
+        for (; d >= 0; d--) {
+            MPI_Type_create_hvector((int)key[2 * d], 1, key[2 * d + 1] * extent, t, &next);
+            MPI_Type_free(&t);
+            t = next;
+        }
+        MPI_Type_commit(&t);
+        return t;
+    }
+};
+
+#endif
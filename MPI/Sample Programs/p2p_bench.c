@@ -0,0 +1,327 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define  MASTER       0
+#define  PARTNER      1
+#define  MAX_BYTES    (256 * 1024 * 1024)   /* Largest message size in the sweep */
+#define  MAX_MSG      (1L << 30)            /* Cap: MPI counts are ints */
+#define  ITERATIONS   1000                  /* Ping-pong iterations for small messages */
+#define  MIN_ITERS    10                    /* Fewest timed iterations for any size */
+#define  WARMUP       10                    /* Untimed iterations before each size */
+#define  WINDOW       64                    /* Messages in flight per streaming round */
+#define  WINDOW_BYTES (16 * 1024 * 1024)    /* Cap on bytes in flight per streaming round */
+#define  DELAY        0.002                 /* Receiver delay (s) used to probe the eager limit */
+#define  TAG          1
+#define  ACK_TAG      2
+
+enum { BLOCKING, NONBLOCKING, BUFFERED, SYNCHRONOUS, PERSISTENT, NMODES };
+const char *mode_names[NMODES] = {"Send", "Isend", "Bsend", "Ssend", "Send_init"};
+
+char *sbuf, *rbuf;
+char *bsend_buf = NULL;
+int bsend_size = 0;
+
+/* Number of timed iterations for a message size - fewer for large messages, never
+   more than max(iters, MIN_ITERS) */
+int iterations_for(long size, int iters) {
+    long n = (size <= 8192) ? iters : (long)iters * 8192 / size;
+    return (n < MIN_ITERS) ? MIN_ITERS : (int)n;
+}
+
+/* Number of back-to-back messages in a streaming round for a message size */
+int window_for(long size) {
+    long w = WINDOW_BYTES / (size > 0 ? size : 1);
+    if (w > WINDOW) w = WINDOW;
+    return (w < 1) ? 1 : (int)w;
+}
+
+/* Make sure the attached Bsend buffer can hold `count` messages of `size` bytes */
+void attach_bsend(long size, int count) {
+    int needed = (int)((size + MPI_BSEND_OVERHEAD) * count);
+    if (needed <= bsend_size)
+        return;
+    if (bsend_buf != NULL) {
+        MPI_Buffer_detach(&bsend_buf, &bsend_size);
+        free(bsend_buf);
+    }
+    bsend_buf = (char *)malloc(needed);
+    bsend_size = needed;
+    MPI_Buffer_attach(bsend_buf, bsend_size);
+}
+
+/* Send `count` messages of `size` bytes to `peer` using the given mode.
+   For the persistent mode `preq` holds `count` requests created by MPI_Send_init. */
+void send_msgs(int mode, int size, int count, int peer, MPI_Request *preq) {
+    MPI_Request reqs[WINDOW];
+    int i;
+
+    switch (mode) {
+    case BLOCKING:
+        for (i = 0; i < count; i++)
+            MPI_Send(sbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD);
+        break;
+    case NONBLOCKING:
+        for (i = 0; i < count; i++)
+            MPI_Isend(sbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD, &reqs[i]);
+        MPI_Waitall(count, reqs, MPI_STATUSES_IGNORE);
+        break;
+    case BUFFERED:
+        for (i = 0; i < count; i++)
+            MPI_Bsend(sbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD);
+        break;
+    case SYNCHRONOUS:
+        for (i = 0; i < count; i++)
+            MPI_Ssend(sbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD);
+        break;
+    case PERSISTENT:
+        MPI_Startall(count, preq);
+        MPI_Waitall(count, preq, MPI_STATUSES_IGNORE);
+        break;
+    }
+}
+
+/* Receive `count` messages from `peer`. Every mode except the non-blocking and persistent
+   ones pairs with a plain MPI_Recv. Outstanding receives share one buffer, as in the OSU
+   benchmarks - only the transfer cost matters here, not the contents. */
+void recv_msgs(int mode, int size, int count, int peer, MPI_Request *preq) {
+    MPI_Request reqs[WINDOW];
+    int i;
+
+    switch (mode) {
+    case NONBLOCKING:
+        for (i = 0; i < count; i++)
+            MPI_Irecv(rbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD, &reqs[i]);
+        MPI_Waitall(count, reqs, MPI_STATUSES_IGNORE);
+        break;
+    case PERSISTENT:
+        MPI_Startall(count, preq);
+        MPI_Waitall(count, preq, MPI_STATUSES_IGNORE);
+        break;
+    default:
+        for (i = 0; i < count; i++)
+            MPI_Recv(rbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        break;
+    }
+}
+
+/* Create `count` persistent send and receive requests for one message size */
+void init_persistent(int size, int count, int peer, MPI_Request *sreq, MPI_Request *rreq) {
+    int i;
+    for (i = 0; i < count; i++) {
+        MPI_Send_init(sbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD, &sreq[i]);
+        MPI_Recv_init(rbuf, size, MPI_CHAR, peer, TAG, MPI_COMM_WORLD, &rreq[i]);
+    }
+}
+
+void free_persistent(int count, MPI_Request *sreq, MPI_Request *rreq) {
+    int i;
+    for (i = 0; i < count; i++) {
+        MPI_Request_free(&sreq[i]);
+        MPI_Request_free(&rreq[i]);
+    }
+}
+
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Ping-pong: one-way latency samples (half of each round trip) are stored in `lat` */
+void ping_pong(int mode, int rank, int size, int iters, double *lat) {
+    MPI_Request sreq[1], rreq[1];
+    int peer = (rank == MASTER) ? PARTNER : MASTER;
+    int i;
+    double t;
+
+    if (mode == BUFFERED)
+        attach_bsend(size, 1);
+    if (mode == PERSISTENT)
+        init_persistent(size, 1, peer, sreq, rreq);
+
+    for (i = -WARMUP; i < iters; i++) {
+        t = MPI_Wtime();
+        if (rank == MASTER) {
+            send_msgs(mode, size, 1, peer, sreq);
+            recv_msgs(mode, size, 1, peer, rreq);
+        } else {
+            recv_msgs(mode, size, 1, peer, rreq);
+            send_msgs(mode, size, 1, peer, sreq);
+        }
+        t = MPI_Wtime() - t;
+        if (i >= 0)
+            lat[i] = t / 2.0;
+    }
+
+    if (mode == PERSISTENT)
+        free_persistent(1, sreq, rreq);
+}
+
+/* Streaming: the master sends a window of messages back-to-back and waits for a
+   zero-byte acknowledgement. Returns the elapsed time of all timed rounds. */
+double stream(int mode, int rank, int size, int iters, int window) {
+    MPI_Request sreq[WINDOW], rreq[WINDOW];
+    int peer = (rank == MASTER) ? PARTNER : MASTER;
+    int i;
+    double t = 0.0;
+
+    if (mode == BUFFERED)
+        attach_bsend(size, window);
+    if (mode == PERSISTENT)
+        init_persistent(size, window, peer, sreq, rreq);
+
+    for (i = -WARMUP; i < iters; i++) {
+        if (i == 0)
+            t = MPI_Wtime();
+        if (rank == MASTER) {
+            send_msgs(mode, size, window, peer, sreq);
+            MPI_Recv(NULL, 0, MPI_CHAR, peer, ACK_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        } else {
+            recv_msgs(mode, size, window, peer, rreq);
+            MPI_Send(NULL, 0, MPI_CHAR, peer, ACK_TAG, MPI_COMM_WORLD);
+        }
+    }
+    t = MPI_Wtime() - t;
+
+    if (mode == PERSISTENT)
+        free_persistent(window, sreq, rreq);
+    return t;
+}
+
+/* Time how long a standard MPI_Send takes to return when the receiver posts its receive
+   late. Eager messages are copied out and return at once; rendezvous messages wait for
+   the receiver, so the send time jumps to about DELAY. */
+double probe_send_return(int rank, int size) {
+    int peer = (rank == MASTER) ? PARTNER : MASTER;
+    double t, best = 1e30;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        /* zero-byte handshake so both tasks start the probe together */
+        MPI_Sendrecv(NULL, 0, MPI_CHAR, peer, ACK_TAG, NULL, 0, MPI_CHAR, peer, ACK_TAG,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (rank == MASTER) {
+            t = MPI_Wtime();
+            MPI_Send(sbuf, size, MPI_CHAR, PARTNER, TAG, MPI_COMM_WORLD);
+            t = MPI_Wtime() - t;
+            if (t < best) best = t;
+        } else {
+            t = MPI_Wtime();
+            while (MPI_Wtime() - t < DELAY)
+                ;
+            MPI_Recv(rbuf, size, MPI_CHAR, MASTER, TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    int numtasks, rank, mode, iters, window;
+    long size;
+    long max_bytes = (argc > 1) ? atol(argv[1]) : MAX_BYTES;
+    int base_iters = (argc > 2) ? atoi(argv[2]) : ITERATIONS;
+    int eager_below = -1, rendezvous_at = -1;
+    double *lat, t;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    if (numtasks < 2) {
+        printf("Quitting. Need at least 2 tasks: numtasks=%d\n", numtasks);
+        MPI_Finalize();
+        exit(0);
+    }
+
+    if (max_bytes > MAX_MSG || max_bytes < 1) {
+        if (rank == MASTER)
+            printf("Message sizes are capped at %ld bytes: max_bytes=%ld\n", MAX_MSG, max_bytes);
+        max_bytes = (max_bytes < 1) ? 1 : MAX_MSG;
+    }
+    if (base_iters < MIN_ITERS)
+        base_iters = MIN_ITERS;   /* lat must hold as many samples as iterations_for returns */
+    sbuf = (char *)malloc(max_bytes);
+    rbuf = (char *)malloc(max_bytes);
+    lat = (double *)malloc(base_iters * sizeof(double));
+    if (!sbuf || !rbuf || !lat) {
+        printf("Task %d: could not allocate %ld byte buffers\n", rank, max_bytes);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    memset(sbuf, 'x', max_bytes);   /* touch every page before timing */
+    memset(rbuf, 0, max_bytes);
+
+    if (rank == MASTER)
+        printf("Point-to-point benchmark between tasks %d and %d (%d tasks total)\n",
+               MASTER, PARTNER, numtasks);
+
+    /* Only the first two tasks take part; any others just wait at the final barrier */
+    if (rank <= PARTNER) {
+
+        /***** Eager-to-rendezvous transition *****/
+        if (rank == MASTER) {
+            printf("\nMPI_Send return time with a receiver that is %.1f ms late:\n", DELAY * 1e3);
+            printf("%12s %14s  %s\n", "Bytes", "Send (us)", "Protocol");
+        }
+        for (size = 1; size <= max_bytes && size <= (1 << 24); size *= 2) {
+            t = probe_send_return(rank, size);
+            if (rank == MASTER) {
+                int eager = (t < DELAY / 2);
+                printf("%12ld %14.2f  %s\n", size, t * 1e6, eager ? "eager" : "rendezvous");
+                if (eager && rendezvous_at < 0)
+                    eager_below = size;
+                if (!eager && rendezvous_at < 0)
+                    rendezvous_at = size;
+            }
+        }
+        if (rank == MASTER) {
+            if (rendezvous_at > 0)
+                printf("Eager limit: messages up to %d bytes are sent eagerly, "
+                       "%d bytes and above use rendezvous\n", eager_below, rendezvous_at);
+            else
+                printf("Eager limit: no rendezvous transition found up to %ld bytes\n", size / 2);
+        }
+
+        /***** Ping-pong latency and streaming bandwidth for each mode *****/
+        for (mode = 0; mode < NMODES; mode++) {
+            if (rank == MASTER) {
+                printf("\nMode: %s\n", mode_names[mode]);
+                printf("%12s %10s %10s %10s %10s %12s %12s %12s\n", "Bytes", "min(us)", "p50(us)",
+                       "p90(us)", "p99(us)", "PP MB/s", "Stream MB/s", "Msg/s");
+            }
+            for (size = 1; size <= max_bytes; size *= 2) {
+                iters = iterations_for(size, base_iters);
+                window = window_for(size);
+
+                ping_pong(mode, rank, size, iters, lat);
+                t = stream(mode, rank, size, (iters + window - 1) / window, window);
+
+                if (rank == MASTER) {
+                    int rounds = (iters + window - 1) / window;
+                    double msgs = (double)rounds * window;
+                    qsort(lat, iters, sizeof(double), compare_doubles);
+                    printf("%12ld %10.2f %10.2f %10.2f %10.2f %12.2f %12.2f %12.0f\n", size,
+                           lat[0] * 1e6,
+                           lat[(int)(0.50 * (iters - 1))] * 1e6,
+                           lat[(int)(0.90 * (iters - 1))] * 1e6,
+                           lat[(int)(0.99 * (iters - 1))] * 1e6,
+                           size / lat[(int)(0.50 * (iters - 1))] / 1e6,
+                           msgs * size / t / 1e6,
+                           msgs / t);
+                }
+            }
+        }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    if (bsend_buf != NULL) {
+        MPI_Buffer_detach(&bsend_buf, &bsend_size);
+        free(bsend_buf);
+    }
+    free(lat);
+    free(sbuf);
+    free(rbuf);
+    MPI_Finalize();
+    return 0;
+}
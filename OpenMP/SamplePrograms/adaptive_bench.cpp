@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+#include "adaptive_sort.h"
+
+#define N          20000000   /* Default elements */
+#define TASK_SIZE  100        /* merge_sort.cpp's cutoff */
+
+using namespace std;
+
+/*
+ * adaptive_sort against the task merge sort of merge_sort.cpp and parallel_quicksort,
+ * on inputs meant to send it down each of its paths. Every sort starts from a fresh
+ * copy of the input and is checked against std::sort; the copy is not timed. The line
+ * under each input gives the path adaptive_sort chose and its reason. The last table
+ * sorts short and signed char keys that straddle zero.
+ */
+
+void mergeSortAux(int *X, long n, int *tmp) {
+    long i = 0, j = n / 2, ti = 0;
+    while (i < n / 2 && j < n)
+        tmp[ti++] = (X[i] < X[j]) ? X[i++] : X[j++];
+    while (i < n / 2)
+        tmp[ti++] = X[i++];
+    while (j < n)
+        tmp[ti++] = X[j++];
+    memcpy(X, tmp, n * sizeof(int));
+}
+
+void mergeSort(int *X, long n, int *tmp) {
+    if (n < 2)
+        return;
+    #pragma omp task if (n > TASK_SIZE)
+    mergeSort(X, n / 2, tmp);
+    #pragma omp task if (n > TASK_SIZE)
+    mergeSort(X + n / 2, n - n / 2, tmp + n / 2);
+    #pragma omp taskwait
+    mergeSortAux(X, n, tmp);
+}
+
+unsigned seed = 2024;
+
+int next_rand() {
+    seed = seed * 1103515245u + 12345u;
+    return (int)(seed >> 1);
+}
+
+void fill(int kind, vector<int> &x) {
+    long n = x.size();
+    for (long i = 0; i < n; i++) {
+        int r = next_rand();
+        switch (kind) {
+        case 1: x[i] = r % 6; break;                         /* fillupRandomly(X, N, 0, 5) */
+        case 2: x[i] = r & 0xffff; break;
+        case 7: x[i] = (r % 8) * (1 << 28) + 12345; break;   /* 8 keys over 31 bits */
+        default: x[i] = r; break;
+        }
+    }
+    if (kind == 3 || kind == 5)
+        sort(x.begin(), x.end());
+    if (kind == 4)
+        sort(x.begin(), x.end(), greater<int>());
+    if (kind == 5)                                          /* one swap per 100000 */
+        for (long s = 0; s < n / 100000; s++)
+            swap(x[next_rand() % n], x[next_rand() % n]);
+    if (kind == 6)                                          /* 16 sorted runs */
+        for (int r = 0; r < 16; r++)
+            sort(x.begin() + n * r / 16, x.begin() + n * (r + 1) / 16);
+}
+
+/* Keys of a type narrower than int, from lo to hi, which straddle zero */
+template <typename T>
+bool narrow_keys(const char *type, int lo, int hi, long n) {
+    vector<T> x(n), sorted;
+    for (long i = 0; i < n; i++)
+        x[i] = (T)(lo + (int)((unsigned)next_rand() % (unsigned)(hi - lo + 1)));
+    sorted = x;
+    sort(sorted.begin(), sorted.end());
+    SortProfile prof;
+    adaptive_sort(x.data(), n, &prof);
+    bool ok = x == sorted;
+    printf("  %-12s %6d .. %-6d %-10s   %s\n", type, lo, hi, sort_path_name(prof.path),
+           ok ? "yes" : "NO");
+    return ok;
+}
+
+const char *input_names[] = {"random", "0..5", "0..65535", "sorted", "reversed",
+                             "nearly sorted", "16 sorted runs", "8 wide keys"};
+
+int main(int argc, char *argv[]) {
+    long n = (argc > 1) ? atol(argv[1]) : N;
+    int numThreads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+
+    omp_set_dynamic(0);
+    omp_set_num_threads(numThreads);
+    printf("\n  n = %ld ints, %d threads\n", n, numThreads);
+    printf("  %-16s %10s %10s %10s %9s   %s\n", "input", "merge sort", "quicksort", "adaptive",
+           "speedup", "correct");
+
+    vector<int> input(n), x(n), tmp(n), sorted;
+    for (int kind = 0; kind < 8; kind++) {
+        fill(kind, input);
+        sorted = input;
+        sort(sorted.begin(), sorted.end());
+
+        x = input;
+        double t = omp_get_wtime();
+        #pragma omp parallel
+        #pragma omp single
+        mergeSort(x.data(), n, tmp.data());
+        double tm = omp_get_wtime() - t;
+        bool ok = x == sorted;
+
+        x = input;
+        t = omp_get_wtime();
+        parallel_quicksort(x.data(), n);
+        double tq = omp_get_wtime() - t;
+        ok = ok && x == sorted;
+
+        x = input;
+        SortProfile prof;
+        t = omp_get_wtime();
+        adaptive_sort(x.data(), n, &prof);
+        double ta = omp_get_wtime() - t;
+        ok = ok && x == sorted;
+
+        printf("  %-16s %10.3f %10.3f %10.3f %8.1fx   %s\n", input_names[kind], tm, tq, ta,
+               tm / ta, ok ? "yes" : "NO");
+        printf("      %s: %s; profile %.3f s\n", sort_path_name(prof.path), prof.reason,
+               prof.profile_seconds);
+    }
+
+    /* Narrow keys below zero promote to negative ints; the counting and radix sorts
+       must still index their buckets by the unsigned difference */
+    printf("\n  %-12s %16s %-10s   %s\n", "key type", "keys", "path", "correct");
+    long m = min(n, 1000000L);
+    narrow_keys<short>("short", -5, 5, m);
+    narrow_keys<short>("short", -30000, 30000, m);
+    narrow_keys<short>("short", -32768, 32767, 40000);       /* wider than n: radix */
+    narrow_keys<signed char>("signed char", -5, 5, m);
+    narrow_keys<signed char>("signed char", -128, 127, m);
+    return 0;
+}
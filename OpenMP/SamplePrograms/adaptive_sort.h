@@ -0,0 +1,335 @@
+#ifndef ADAPTIVE_SORT_H
+#define ADAPTIVE_SORT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "parallel_quicksort.h"
+
+/*
+ * A sort for integer keys that looks at its input first and picks the algorithm.
+ *
+ *   SortProfile prof;
+ *   adaptive_sort(x, n, &prof);            call outside a parallel region
+ *   printf("%s: %s\n", sort_path_name(prof.path), prof.reason);
+ *
+ * One parallel pass reads every key and finds the exact minimum and maximum and the
+ * number of descents (x[i] > x[i + 1]) and ascents. Sorted runs number about
+ * min(descents, ascents) + 1: a nearly sorted or nearly reversed input has few. A
+ * strided sample of AS_SAMPLE keys estimates how many distinct keys there are. Then:
+ *
+ *  runs        few runs: find the ascending and descending runs, reverse the descending
+ *              ones, and merge pairs of runs round by round, as timsort does
+ *  counting    a key range of at most AS_COUNT_RANGE and at most n: per-thread counts,
+ *              then the keys are written back in order, in place
+ *  comparison  small inputs, and few distinct keys over a wide range: parallel_quicksort,
+ *              whose three-way splits finish each distinct key in one pass
+ *  radix       everything else: LSD radix sort on key - min, with as few passes of at
+ *              most AS_RADIX_BITS bits as the key range allows
+ *
+ * runs and radix need a buffer of n keys; counting and comparison sort in place.
+ */
+
+#define AS_SMALL        (1 << 14)   /* Inputs up to this size go straight to comparison */
+#define AS_SAMPLE       4096        /* Keys sampled to estimate distinct keys */
+#define AS_RUN_LENGTH   4096        /* Least average run length for the run merge */
+#define AS_COUNT_RANGE  (1 << 20)   /* Widest key range for counting sort */
+#define AS_FEW_KEYS     64          /* Distinct keys in the sample that count as few */
+#define AS_RADIX_BITS   11          /* Widest digit of the radix sort */
+#define AS_MERGE_BLOCK  (1 << 16)   /* Output elements per parallel merge piece */
+
+enum SortPath { SORT_RUNS, SORT_COUNTING, SORT_COMPARISON, SORT_RADIX };
+
+inline const char *sort_path_name(SortPath p) {
+    static const char *names[] = {"runs", "counting", "comparison", "radix"};
+    return names[p];
+}
+
+struct SortProfile {
+    long n;
+    long long min, max;
+    long descents, ascents;
+    long runs;                       /* estimated by the profile; counted if merged */
+    int distinct_in_sample, sample;
+    SortPath path;
+    char reason[160];
+    double profile_seconds, sort_seconds;
+};
+
+/* Bits needed for the values 0 .. range - 1 */
+inline int as_bits(unsigned long long range) {
+    int b = 0;
+    while (b < 64 && (range - 1) >> b)
+        b++;
+    return b;
+}
+
+template <typename T>
+void as_profile(const T *x, long n, SortProfile &prof) {
+    T mn = x[0], mx = x[0];
+    long desc = 0, asc = 0;
+    #pragma omp parallel for schedule(static) reduction(min:mn) reduction(max:mx) reduction(+:desc, asc)
+    for (long i = 0; i < n - 1; i++) {
+        mn = std::min(mn, x[i + 1]);
+        mx = std::max(mx, x[i + 1]);
+        desc += x[i + 1] < x[i];
+        asc += x[i] < x[i + 1];
+    }
+    prof.n = n;
+    prof.min = (long long)mn;
+    prof.max = (long long)mx;
+    prof.descents = desc;
+    prof.ascents = asc;
+    prof.runs = std::min(desc, asc) + 1;
+
+    long s = std::min<long>(n, AS_SAMPLE);
+    std::vector<T> sample(s);
+    for (long i = 0; i < s; i++)
+        sample[i] = x[(long)((double)i * n / s)];
+    std::sort(sample.begin(), sample.end());
+    prof.sample = (int)s;
+    prof.distinct_in_sample = (int)(std::unique(sample.begin(), sample.end()) - sample.begin());
+}
+
+/* Counting sort of keys in [mn, mn + range), in place. Differences are taken in U and
+   cast back to it, because types narrower than int promote to int and go negative. */
+template <typename T>
+void as_counting_sort(T *x, long n, T mn, long range) {
+    using U = typename std::make_unsigned<T>::type;
+    int p = omp_get_max_threads();
+    std::vector<long> counts((size_t)p * range), start(range + 1);
+    #pragma omp parallel num_threads(p)
+    {
+        int t = omp_get_thread_num();
+        long *mine = counts.data() + (size_t)t * range;
+        #pragma omp for schedule(static)
+        for (long i = 0; i < n; i++)
+            mine[(U)((U)x[i] - (U)mn)]++;
+        #pragma omp for schedule(static)
+        for (long b = 0; b < range; b++) {
+            long c = 0;
+            for (int u = 0; u < p; u++)
+                c += counts[(size_t)u * range + b];
+            start[b + 1] = c;
+        }
+        #pragma omp single
+        for (long b = 0; b < range; b++)
+            start[b + 1] += start[b];
+
+        /* Thread t writes positions [lo, hi) of the output */
+        long lo = n * t / p, hi = n * (t + 1) / p;
+        long b = std::upper_bound(start.begin(), start.end(), lo) - start.begin() - 1;
+        for (long i = lo; i < hi; b++) {
+            long e = std::min(hi, start[b + 1]);
+            std::fill(x + i, x + e, (T)(U)((U)mn + (U)b));
+            i = e;
+        }
+    }
+}
+
+/* LSD radix sort on key - mn, whose values need `bits` bits */
+template <typename T>
+void as_radix_sort(T *x, long n, T mn, int bits) {
+    using U = typename std::make_unsigned<T>::type;
+    int passes = (bits + AS_RADIX_BITS - 1) / AS_RADIX_BITS;
+    int width = (bits + passes - 1) / passes;
+    long buckets = 1L << width;
+    int p = omp_get_max_threads();
+    std::vector<T> buf(n);
+    std::vector<long> offset((size_t)p * buckets);
+    T *src = x, *dst = buf.data();
+
+    for (int pass = 0, shift = 0; pass < passes; pass++, shift += width) {
+        #pragma omp parallel num_threads(p)
+        {
+            int t = omp_get_thread_num();
+            long *mine = offset.data() + (size_t)t * buckets;
+            std::fill(mine, mine + buckets, 0L);
+            long lo = n * t / p, hi = n * (t + 1) / p;
+            for (long i = lo; i < hi; i++)
+                mine[((U)((U)src[i] - (U)mn) >> shift) & (buckets - 1)]++;
+            #pragma omp barrier
+            /* Bucket d of thread t starts after all smaller digits, and after digit d
+               of the threads before it, which keeps every pass stable */
+            #pragma omp single
+            {
+                long sum = 0;
+                for (long d = 0; d < buckets; d++)
+                    for (int u = 0; u < p; u++) {
+                        long c = offset[(size_t)u * buckets + d];
+                        offset[(size_t)u * buckets + d] = sum;
+                        sum += c;
+                    }
+            }
+            for (long i = lo; i < hi; i++)
+                dst[mine[((U)((U)src[i] - (U)mn) >> shift) & (buckets - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != x)
+        std::copy(src, src + n, x);
+}
+
+/* Elements of A among the first k of the stable merge of A (na) and B (nb) */
+template <typename T>
+long as_merge_path(const T *A, long na, const T *B, long nb, long k) {
+    long lo = std::max(0L, k - nb), hi = std::min(k, na);
+    while (lo < hi) {
+        long i = (lo + hi) / 2;
+        if (B[k - i - 1] < A[i])
+            hi = i;
+        else
+            lo = i + 1;
+    }
+    return lo;
+}
+
+/* Turns x into ascending runs and merges them; returns the number of runs found */
+template <typename T>
+long as_run_merge(T *x, long n) {
+    /* Runs never cross the boundaries of the threads' blocks. The keys are plain
+       integers, so reversing a run with equal keys in it loses nothing. */
+    int p = omp_get_max_threads();
+    std::vector<std::vector<long>> found(p);
+    #pragma omp parallel num_threads(p)
+    {
+        int t = omp_get_thread_num();
+        long lo = n * t / p, hi = n * (t + 1) / p;
+        for (long i = lo; i < hi;) {
+            long j = i + 1;
+            if (j < hi && x[j] < x[i]) {
+                while (j + 1 < hi && !(x[j] < x[j + 1]))
+                    j++;
+                std::reverse(x + i, x + j + 1);
+            } else {
+                while (j < hi && !(x[j] < x[j - 1]))
+                    j++;
+                j--;
+            }
+            found[t].push_back(i);
+            i = j + 1;
+        }
+    }
+    /* Neighbouring runs already in order are one run */
+    std::vector<long> runs;
+    for (int t = 0; t < p; t++)
+        for (long i : found[t])
+            if (i == 0 || x[i] < x[i - 1])
+                runs.push_back(i);
+    long nruns = runs.size();
+    runs.push_back(n);
+
+    /* Merge neighbouring runs, round by round, cutting every merge into pieces of
+       AS_MERGE_BLOCK outputs along the merge path */
+    std::vector<T> buf(nruns > 1 ? n : 0);
+    T *src = x, *dst = buf.data();
+    while (runs.size() > 2) {
+        struct Piece {
+            long a, m, b, k0, k1;    /* merges [a, m) with [m, b), outputs k0 .. k1 */
+        };
+        std::vector<Piece> pieces;
+        std::vector<long> next;
+        for (size_t r = 0; r + 1 < runs.size(); r += 2) {
+            long a = runs[r], m = runs[r + 1], b = (r + 2 < runs.size()) ? runs[r + 2] : m;
+            next.push_back(a);
+            for (long k = 0; k < b - a; k += AS_MERGE_BLOCK)
+                pieces.push_back({a, m, b, k, std::min(b - a, k + AS_MERGE_BLOCK)});
+        }
+        next.push_back(n);
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t q = 0; q < pieces.size(); q++) {
+            const Piece &pc = pieces[q];
+            const T *A = src + pc.a, *B = src + pc.m;
+            long na = pc.m - pc.a, nb = pc.b - pc.m;
+            long i = as_merge_path(A, na, B, nb, pc.k0), iend = as_merge_path(A, na, B, nb, pc.k1);
+            long j = pc.k0 - i, jend = pc.k1 - iend;
+            T *out = dst + pc.a + pc.k0;
+            /* Pieces of nearly sorted input mostly take one side whole, then the other */
+            if (i < iend && j < jend && B[jend - 1] < A[i]) {
+                out = std::copy(B + j, B + jend, out);
+                j = jend;
+            } else if (i < iend && j < jend && !(B[j] < A[iend - 1])) {
+                out = std::copy(A + i, A + iend, out);
+                i = iend;
+            }
+            while (i < iend && j < jend) {
+                bool b = B[j] < A[i];
+                *out++ = b ? B[j] : A[i];
+                j += b;
+                i += !b;
+            }
+            while (i < iend)
+                *out++ = A[i++];
+            while (j < jend)
+                *out++ = B[j++];
+        }
+        runs.swap(next);
+        std::swap(src, dst);
+    }
+    if (src != x) {
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < n; i++)
+            x[i] = src[i];
+    }
+    return nruns;
+}
+
+template <typename T>
+void adaptive_sort(T *x, long n, SortProfile *report = nullptr) {
+    static_assert(std::is_integral<T>::value, "adaptive_sort needs integer keys");
+    SortProfile prof;
+    memset(&prof, 0, sizeof(prof));
+    prof.n = n;
+    if (n < 2) {
+        prof.path = SORT_RUNS;
+        snprintf(prof.reason, sizeof(prof.reason), "nothing to sort");
+        if (report)
+            *report = prof;
+        return;
+    }
+    double t = omp_get_wtime();
+    as_profile(x, n, prof);
+    prof.profile_seconds = omp_get_wtime() - t;
+
+    unsigned long long range = (unsigned long long)prof.max - (unsigned long long)prof.min + 1;
+    int bits = range == 0 ? 64 : as_bits(range);
+    t = omp_get_wtime();
+    if (n < AS_SMALL) {
+        prof.path = SORT_COMPARISON;
+        snprintf(prof.reason, sizeof(prof.reason), "%ld keys, too few to profit from more", n);
+        parallel_quicksort(x, n);
+    } else if (prof.runs <= n / AS_RUN_LENGTH) {
+        prof.path = SORT_RUNS;
+        long estimated = prof.runs;
+        prof.runs = as_run_merge(x, n);
+        snprintf(prof.reason, sizeof(prof.reason),
+                 "about %ld by %ld descents and %ld ascents, %ld found", estimated,
+                 prof.descents, prof.ascents, prof.runs);
+    } else if (range != 0 && range <= (unsigned long long)std::min<long>(AS_COUNT_RANGE, n)) {
+        prof.path = SORT_COUNTING;
+        snprintf(prof.reason, sizeof(prof.reason), "keys span only %llu values (%lld .. %lld)",
+                 range, prof.min, prof.max);
+        as_counting_sort(x, n, (T)prof.min, (long)range);
+    } else if (prof.distinct_in_sample <= AS_FEW_KEYS) {
+        prof.path = SORT_COMPARISON;
+        snprintf(prof.reason, sizeof(prof.reason),
+                 "%d distinct keys in a sample of %d, spread over %d bits: three-way splits",
+                 prof.distinct_in_sample, prof.sample, bits);
+        parallel_quicksort(x, n);
+    } else {
+        prof.path = SORT_RADIX;
+        int passes = (bits + AS_RADIX_BITS - 1) / AS_RADIX_BITS;
+        snprintf(prof.reason, sizeof(prof.reason),
+                 "%d distinct keys in a sample of %d over %d bits: %d passes of %d bits",
+                 prof.distinct_in_sample, prof.sample, bits, passes, (bits + passes - 1) / passes);
+        as_radix_sort(x, n, (T)prof.min, bits);
+    }
+    prof.sort_seconds = omp_get_wtime() - t;
+    if (report)
+        *report = prof;
+}
+
+#endif
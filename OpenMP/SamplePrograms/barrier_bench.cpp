@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <vector>
+#include <omp.h>
+#include "barriers.h"
+
+using namespace std;
+
+#define EPISODES 100000
+
+enum { OMP, CENTRAL, TREE, DISSEMINATION, TOURNAMENT, ARGMIN, NKINDS };
+const char *kind_names[NKINDS] = {"omp barrier", "central", "tree", "dissemination",
+                                  "tournament", "argmin"};
+
+// Nanoseconds per episode of `episodes` back-to-back barriers on p threads
+template <typename Wait>
+double time_barrier(int p, long episodes, Wait wait) {
+    double t = 0.0;
+    #pragma omp parallel num_threads(p)
+    {
+        int tid = omp_get_thread_num();
+        for (int r = 0; r < 100; r++)       // warm up
+            wait(tid, r);
+        #pragma omp barrier
+        double t0 = omp_get_wtime();
+        for (long e = 0; e < episodes; e++)
+            wait(tid, e);
+        #pragma omp barrier
+        #pragma omp master
+        t = omp_get_wtime() - t0;
+    }
+    return t / episodes * 1e9;
+}
+
+double run(int kind, int p, long episodes) {
+    switch (kind) {
+    case OMP:
+        return time_barrier(p, episodes, [](int, long) {
+            #pragma omp barrier
+        });
+    case CENTRAL: {
+        CentralBarrier b(p);
+        return time_barrier(p, episodes, [&](int t, long) { b.wait(t); });
+    }
+    case TREE: {
+        TreeBarrier b(p);
+        return time_barrier(p, episodes, [&](int t, long) { b.wait(t); });
+    }
+    case DISSEMINATION: {
+        DisseminationBarrier b(p);
+        return time_barrier(p, episodes, [&](int t, long) { b.wait(t); });
+    }
+    case TOURNAMENT: {
+        TournamentBarrier b(p);
+        return time_barrier(p, episodes, [&](int t, long) { b.wait(t); });
+    }
+    default: {
+        // Check the reduction too: thread (e % p) offers the smallest value each episode
+        ArgminBarrier<long> b(p);
+        atomic<bool> ok(true);
+        double ns = time_barrier(p, episodes, [&](int t, long e) {
+            MinLoc<long> m = b.wait(t, (t == e % p) ? -e : e + t, t);
+            if (m.value != -e || m.index != (int)(e % p))
+                ok = false;
+        });
+        if (!ok)
+            cout << "  argmin barrier returned a wrong minimum on " << p << " threads\n";
+        return ns;
+    }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : omp_get_num_procs();
+    long episodes = (argc > 2) ? atol(argv[2]) : EPISODES;
+    vector<int> counts;
+
+    omp_set_dynamic(0);
+    for (int p = 1; p < maxThreads; p *= 2)
+        counts.push_back(p);
+    counts.push_back(maxThreads);
+
+    cout << "\n  Number of processors available = " << omp_get_num_procs() << "\n";
+    cout << "  Barrier latency, ns per episode (" << episodes << " episodes)\n\n";
+    cout << "  " << setw(8) << "threads";
+    for (int k = 0; k < NKINDS; k++)
+        cout << "  " << setw(13) << kind_names[k];
+    cout << "\n";
+    for (int p : counts) {
+        cout << "  " << setw(8) << p << fixed << setprecision(1);
+        for (int k = 0; k < NKINDS; k++)
+            cout << "  " << setw(13) << run(k, p, episodes);
+        cout << "\n";
+    }
+    return 0;
+}
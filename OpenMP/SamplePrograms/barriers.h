@@ -0,0 +1,268 @@
+#ifndef BARRIERS_H
+#define BARRIERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Barriers for a fixed team of n threads that call wait(tid) with tid in [0, n), for
+ * example from inside an OpenMP parallel region with tid = omp_get_thread_num().
+ *
+ *  CentralBarrier        one shared counter; the last thread to arrive flips a shared
+ *                        sense flag that everybody spins on. O(n) arrivals on one line.
+ *  TreeBarrier           combining tree: threads arrive in groups of BARRIER_ARITY, the
+ *                        last of each group carries on to the parent node, and the
+ *                        last at the root flips the sense flag.
+ *  DisseminationBarrier  ceil(log2 n) rounds; in round k thread t signals thread
+ *                        t + 2^k and waits for thread t - 2^k. No thread is special.
+ *  TournamentBarrier     ceil(log2 n) rounds of statically paired matches; each loser
+ *                        signals its winner, and thread 0, the champion, releases all.
+ *  ArgminBarrier<T>      a dissemination barrier that carries (value, index) pairs and
+ *                        returns the smallest pair to every thread, so a barrier and a
+ *                        min-location reduction cost one set of rounds together.
+ *
+ * Every flag sits on its own cache line. Waiting threads spin with a pause instruction
+ * and start yielding after BARRIER_SPIN iterations, or at once when there are more
+ * threads than cores, so oversubscribed runs still make progress.
+ */
+
+#define BARRIER_SPIN   4096
+#define BARRIER_ARITY  4
+#define BARRIER_ROUNDS 16        /* enough for 65536 threads */
+
+inline void barrier_pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+/* Spinning only helps when every thread has a core of its own */
+inline int spin_limit(int nthreads) {
+    return (nthreads <= (int)std::thread::hardware_concurrency()) ? BARRIER_SPIN : 0;
+}
+
+template <typename Cond>
+inline void spin_until(int spin, Cond done) {
+    for (int i = 0; !done(); i++) {
+        if (i < spin)
+            barrier_pause();
+        else
+            std::this_thread::yield();
+    }
+}
+
+struct alignas(64) PaddedFlag {
+    std::atomic<int> v{0};
+};
+
+/* Per-thread state that only its owner touches */
+struct alignas(64) PrivateSense {
+    int sense = 1, parity = 0;
+};
+
+inline int ceil_log2(int n) {
+    int r = 0;
+    while ((1 << r) < n)
+        r++;
+    return r;
+}
+
+class CentralBarrier {
+public:
+    explicit CentralBarrier(int nthreads)
+        : n(nthreads), spin(spin_limit(nthreads)), local(nthreads) {}
+
+    void wait(int t) {
+        int s = local[t].sense;
+        local[t].sense = 1 - s;
+        if (count.v.fetch_add(1, std::memory_order_acq_rel) == n - 1) {
+            count.v.store(0, std::memory_order_relaxed);
+            sense.v.store(s, std::memory_order_release);
+        } else {
+            spin_until(spin, [&] { return sense.v.load(std::memory_order_acquire) == s; });
+        }
+    }
+
+private:
+    int n, spin;
+    PaddedFlag count, sense;
+    std::vector<PrivateSense> local;
+};
+
+class TreeBarrier {
+public:
+    explicit TreeBarrier(int nthreads)
+        : n(nthreads), spin(spin_limit(nthreads)), local(nthreads) {
+        /* Level by level: node i of a level with `width` members covers members
+           [i*ARITY, (i+1)*ARITY) and reports to node i/ARITY of the next level */
+        std::vector<int> expected, parent;
+        int width = n, first = 0;
+        for (;;) {
+            int m = (width + BARRIER_ARITY - 1) / BARRIER_ARITY;
+            for (int i = 0; i < m; i++) {
+                expected.push_back(std::min(BARRIER_ARITY, width - i * BARRIER_ARITY));
+                parent.push_back(m == 1 ? -1 : first + m + i / BARRIER_ARITY);
+            }
+            if (m == 1)
+                break;
+            first += m;
+            width = m;
+        }
+        nnodes = (int)expected.size();
+        nodes.reset(new Node[nnodes]);
+        for (int i = 0; i < nnodes; i++) {
+            nodes[i].expected = expected[i];
+            nodes[i].parent = parent[i];
+        }
+    }
+
+    void wait(int t) {
+        int s = local[t].sense;
+        local[t].sense = 1 - s;
+        int node = t / BARRIER_ARITY;
+        for (;;) {
+            Node &nd = nodes[node];
+            if (nd.count.fetch_add(1, std::memory_order_acq_rel) != nd.expected - 1)
+                break;
+            nd.count.store(0, std::memory_order_relaxed);   /* last one here goes up */
+            if (nd.parent < 0) {
+                sense.v.store(s, std::memory_order_release);
+                return;
+            }
+            node = nd.parent;
+        }
+        spin_until(spin, [&] { return sense.v.load(std::memory_order_acquire) == s; });
+    }
+
+private:
+    struct alignas(64) Node {
+        std::atomic<int> count{0};
+        int expected = 0, parent = -1;
+    };
+    int n, spin, nnodes;
+    std::unique_ptr<Node[]> nodes;
+    PaddedFlag sense;
+    std::vector<PrivateSense> local;
+};
+
+class DisseminationBarrier {
+public:
+    explicit DisseminationBarrier(int nthreads)
+        : n(nthreads), spin(spin_limit(nthreads)), rounds(ceil_log2(nthreads)),
+          flags(new Flags[nthreads]), local(nthreads) {}
+
+    void wait(int t) {
+        PrivateSense &me = local[t];
+        for (int k = 0; k < rounds; k++) {
+            int partner = (t + (1 << k)) % n;
+            flags[partner].f[me.parity][k].v.store(me.sense, std::memory_order_release);
+            std::atomic<int> &mine = flags[t].f[me.parity][k].v;
+            spin_until(spin, [&] { return mine.load(std::memory_order_acquire) == me.sense; });
+        }
+        if (me.parity == 1)
+            me.sense = 1 - me.sense;
+        me.parity = 1 - me.parity;
+    }
+
+private:
+    /* Two sets of flags used on alternate episodes, so a fast thread's next signal can
+       never overwrite one its partner has not seen yet */
+    struct Flags {
+        PaddedFlag f[2][BARRIER_ROUNDS];
+    };
+    int n, spin, rounds;
+    std::unique_ptr<Flags[]> flags;
+    std::vector<PrivateSense> local;
+};
+
+class TournamentBarrier {
+public:
+    explicit TournamentBarrier(int nthreads)
+        : n(nthreads), spin(spin_limit(nthreads)), rounds(ceil_log2(nthreads)),
+          arrive(new Arrive[nthreads]), local(nthreads) {}
+
+    void wait(int t) {
+        int s = local[t].sense;
+        local[t].sense = 1 - s;
+        for (int k = 0; k < rounds; k++) {
+            int step = 1 << k;
+            if (t % (2 * step) == 0) {                  /* winner: wait for the opponent */
+                if (t + step < n) {
+                    std::atomic<int> &f = arrive[t].round[k].v;
+                    spin_until(spin, [&] { return f.load(std::memory_order_acquire) == s; });
+                }
+            } else {                                    /* loser: report, then wait */
+                arrive[t - step].round[k].v.store(s, std::memory_order_release);
+                spin_until(spin, [&] { return release.v.load(std::memory_order_acquire) == s; });
+                return;
+            }
+        }
+        release.v.store(s, std::memory_order_release);  /* only the champion gets here */
+    }
+
+private:
+    struct Arrive {
+        PaddedFlag round[BARRIER_ROUNDS];
+    };
+    int n, spin, rounds;
+    std::unique_ptr<Arrive[]> arrive;
+    PaddedFlag release;
+    std::vector<PrivateSense> local;
+};
+
+template <typename T>
+struct MinLoc {
+    T value;
+    int index;
+    bool operator<(const MinLoc &o) const {
+        return value < o.value || (value == o.value && index < o.index);
+    }
+};
+
+template <typename T>
+class ArgminBarrier {
+public:
+    explicit ArgminBarrier(int nthreads)
+        : n(nthreads), spin(spin_limit(nthreads)), rounds(ceil_log2(nthreads)),
+          box(new Mailbox[nthreads]), local(nthreads) {}
+
+    /* Barrier that returns the smallest (value, index) contributed by any thread; ties
+       go to the smaller index, so every thread gets the same answer */
+    MinLoc<T> wait(int t, T value, int index) {
+        PrivateSense &me = local[t];
+        MinLoc<T> best = {value, index};
+        for (int k = 0; k < rounds; k++) {
+            Slot &out = box[(t + (1 << k)) % n].slot[me.parity][k];
+            out.m = best;
+            out.sense.store(me.sense, std::memory_order_release);
+            Slot &in = box[t].slot[me.parity][k];
+            spin_until(spin, [&] { return in.sense.load(std::memory_order_acquire) == me.sense; });
+            if (in.m < best)
+                best = in.m;
+        }
+        if (me.parity == 1)
+            me.sense = 1 - me.sense;
+        me.parity = 1 - me.parity;
+        return best;
+    }
+
+private:
+    struct alignas(64) Slot {
+        MinLoc<T> m;
+        std::atomic<int> sense{0};
+    };
+    struct Mailbox {
+        Slot slot[2][BARRIER_ROUNDS];
+    };
+    int n, spin, rounds;
+    std::unique_ptr<Mailbox[]> box;
+    std::vector<PrivateSense> local;
+};
+
+#endif
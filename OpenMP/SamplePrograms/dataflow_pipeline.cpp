@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "task_graph.h"
+
+#define N       (1 << 22)   /* Default vector length */
+#define BLOCKS  64          /* Default number of blocks each stage is split into */
+
+using namespace std;
+
+/*
+ * The two loops of sections.cpp, c = a + b and d = a * b, extended into a pipeline
+ * whose later stages depend on the earlier ones:
+ *
+ *   c = a + b,  d = a * b,  e = sqrt(c * d),  s = sum(e),  f = e - s / n
+ *
+ * omp sections can only run independent loops side by side, and only as many as there
+ * are sections. Here every stage is cut into blocks, and a block of one stage only
+ * waits for the blocks it reads, so blocks from different stages overlap.
+ */
+
+struct Vectors {
+    int n, blocks;
+    vector<double> a, b, c, d, e, f, partial;
+    double mean;
+    Vectors(int n, int blocks)
+        : n(n), blocks(blocks), a(n), b(n), c(n), d(n), e(n), f(n), partial(blocks) {
+        for (int i = 0; i < n; i++) {
+            a[i] = i * 1.5e-6;
+            b[i] = i * 1e-6 + 22.35;
+        }
+    }
+    /* Poison every result, so a run that skips a task cannot pass its check */
+    void clear() {
+        for (vector<double> *x : {&c, &d, &e, &f, &partial})
+            fill(x->begin(), x->end(), NAN);
+        mean = NAN;
+    }
+    int lo(int k) const { return (int)((long)n * k / blocks); }
+    int hi(int k) const { return (int)((long)n * (k + 1) / blocks); }
+};
+
+void add_block(Vectors &v, int k) {
+    for (int i = v.lo(k); i < v.hi(k); i++)
+        v.c[i] = v.a[i] + v.b[i];
+}
+
+void mul_block(Vectors &v, int k) {
+    for (int i = v.lo(k); i < v.hi(k); i++)
+        v.d[i] = v.a[i] * v.b[i];
+}
+
+void root_block(Vectors &v, int k) {
+    for (int i = v.lo(k); i < v.hi(k); i++)
+        v.e[i] = sqrt(v.c[i] * v.d[i]);
+}
+
+void sum_block(Vectors &v, int k) {
+    double s = 0.0;
+    for (int i = v.lo(k); i < v.hi(k); i++)
+        s += v.e[i];
+    v.partial[k] = s;
+}
+
+void mean(Vectors &v) {
+    double s = 0.0;
+    for (int k = 0; k < v.blocks; k++)
+        s += v.partial[k];
+    v.mean = s / v.n;
+}
+
+void center_block(Vectors &v, int k) {
+    for (int i = v.lo(k); i < v.hi(k); i++)
+        v.f[i] = v.e[i] - v.mean;
+}
+
+/* The pipeline as tasks; blocks are named by the address of their first element */
+void build(TaskGraph &g, Vectors &v) {
+    for (int k = 0; k < v.blocks; k++) {
+        int i = v.lo(k);
+        g.add("c=a+b", [&v, k] { add_block(v, k); }, {in(&v.a[i]), in(&v.b[i]), out(&v.c[i])});
+        g.add("d=a*b", [&v, k] { mul_block(v, k); }, {in(&v.a[i]), in(&v.b[i]), out(&v.d[i])});
+        g.add("e=sqrt(cd)", [&v, k] { root_block(v, k); }, {in(&v.c[i]), in(&v.d[i]), out(&v.e[i])});
+        g.add("sum(e)", [&v, k] { sum_block(v, k); }, {in(&v.e[i]), out(&v.partial[k])});
+    }
+    vector<Dep> join;
+    for (int k = 0; k < v.blocks; k++)
+        join.push_back(in(&v.partial[k]));
+    join.push_back(out(&v.mean));
+    g.add("mean", [&v] { mean(v); }, join);
+    for (int k = 0; k < v.blocks; k++) {
+        int i = v.lo(k);
+        g.add("f=e-mean", [&v, k] { center_block(v, k); }, {in(&v.e[i]), in(&v.mean), out(&v.f[i])});
+    }
+}
+
+void serial(Vectors &v) {
+    for (int k = 0; k < v.blocks; k++) {
+        add_block(v, k);
+        mul_block(v, k);
+        root_block(v, k);
+        sum_block(v, k);
+    }
+    mean(v);
+    for (int k = 0; k < v.blocks; k++)
+        center_block(v, k);
+}
+
+/* What sections.cpp scales to: the first two stages as sections, every later stage as
+   a work-shared loop, with a barrier between stages */
+void staged(Vectors &v, int nthreads) {
+    #pragma omp parallel num_threads(nthreads)
+    {
+        #pragma omp sections
+        {
+            #pragma omp section
+            for (int k = 0; k < v.blocks; k++)
+                add_block(v, k);
+            #pragma omp section
+            for (int k = 0; k < v.blocks; k++)
+                mul_block(v, k);
+        }
+        #pragma omp for
+        for (int k = 0; k < v.blocks; k++)
+            root_block(v, k);
+        #pragma omp for
+        for (int k = 0; k < v.blocks; k++)
+            sum_block(v, k);
+        #pragma omp single
+        mean(v);
+        #pragma omp for
+        for (int k = 0; k < v.blocks; k++)
+            center_block(v, k);
+    }
+}
+
+double max_diff(const vector<double> &x, const vector<double> &y) {
+    double m = 0.0;
+    for (size_t i = 0; i < x.size(); i++) {
+        double d = fabs(x[i] - y[i]);
+        if (isnan(d))
+            return d;       /* fmax would drop it */
+        m = fmax(m, d);
+    }
+    return m;
+}
+
+/* Seconds for the second of two calls, so page faults and thread start-up are excluded */
+template <typename F>
+double timed(F f) {
+    f();
+    double t = omp_get_wtime();
+    f();
+    return omp_get_wtime() - t;
+}
+
+int main(int argc, char *argv[]) {
+    int n = (argc > 1) ? atoi(argv[1]) : N;
+    int blocks = (argc > 2) ? atoi(argv[2]) : BLOCKS;
+    int numThreads = (argc > 3) ? atoi(argv[3]) : omp_get_max_threads();
+    if (n < 1 || numThreads < 1) {
+        fprintf(stderr, "usage: %s [n >= 1] [blocks] [threads >= 1]\n", argv[0]);
+        return 1;
+    }
+    blocks = max(1, min(blocks, n));    /* every block holds at least one element */
+
+    Vectors ref(n, blocks), v(n, blocks);
+    double tserial = timed([&] { serial(ref); });
+    printf("\n  n = %d in %d blocks, %d threads\n", n, blocks, numThreads);
+    printf("  %-22s %8.3f ms\n", "serial", tserial * 1e3);
+
+    v.clear();
+    double t = timed([&] { staged(v, numThreads); });
+    printf("  %-22s %8.3f ms   max |f - serial| = %.1e\n", "sections + for", t * 1e3,
+           max_diff(v.f, ref.f));
+
+    /* Each executor runs once to warm up, like the timings above, then on poisoned results */
+    TaskGraph g;
+    build(g, v);
+    g.run(numThreads);
+    v.clear();
+    g.run(numThreads);
+    g.report(stdout, "task graph (stealing)", tserial);
+    printf("  %-22s max |f - serial| = %.1e\n", "", max_diff(v.f, ref.f));
+    g.run_omp(numThreads);
+    v.clear();
+    g.run_omp(numThreads);
+    g.report(stdout, "task graph (depend)", tserial);
+    printf("  %-22s max |f - serial| = %.1e\n", "", max_diff(v.f, ref.f));
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "divide_and_conquer.h"
+
+#define FIB_N     32          /* Default Fibonacci number */
+#define SORT_N    (1 << 22)   /* Default elements to sort */
+#define PI_STEPS  (1L << 27)  /* Default integration steps */
+#define TASK_SIZE 100         /* merge_sort.cpp's cutoff */
+#define MIN_BLK   (1L << 28)  /* pi_integral_tasks.py's cutoff */
+#define LEAF      16          /* Sorts of at most this many elements use insertion sort */
+
+using namespace std;
+
+/* fib(n) as in task_fibonacci.cpp. The empty asm hides the leaf value from the
+   optimizer; otherwise GCC sees a pure recursion, shares the fib(n - 2) inside fib(n - 1)
+   and the serial time grows by about 1.4 per level instead of 1.6, unlike any timing the
+   calibration extrapolates from. */
+struct Fib {
+    using Input = int;
+    using Output = long;
+    bool is_base(int n) const { return n < 2; }
+    long base(int n) const {
+        long x = n;
+        asm volatile("" : "+r"(x));
+        return x;
+    }
+    long size(int n) const { return n; }
+    pair<int, int> split(int n) const { return {n - 1, n - 2}; }
+    long combine(int, long a, long b) const { return a + b; }
+};
+
+/* The integral of 4 / (1 + x^2) over [0, 1] as in pi_integral_tasks.py, with a leaf
+   loop of 1024 steps */
+struct Pi {
+    using Input = pair<long, long>;
+    using Output = double;
+    double step;
+    bool is_base(const Input &r) const { return r.second - r.first <= 1024; }
+    double base(const Input &r) const {
+        double sum = 0.0;
+        for (long i = r.first; i < r.second; i++) {
+            double x = (i + 0.5) * step;
+            sum += 4.0 / (1.0 + x * x);
+        }
+        return sum;
+    }
+    long size(const Input &r) const { return r.second - r.first; }
+    pair<Input, Input> split(const Input &r) const {
+        long mid = r.first + (r.second - r.first) / 2;
+        return {{r.first, mid}, {mid, r.second}};
+    }
+    double combine(const Input &, double a, double b) const { return a + b; }
+};
+
+void insertion_sort(int *x, long n) {
+    for (long i = 1; i < n; i++) {
+        int v = x[i];
+        long j = i;
+        for (; j > 0 && x[j - 1] > v; j--)
+            x[j] = x[j - 1];
+        x[j] = v;
+    }
+}
+
+/* merge_sort.cpp: sort both halves, then merge them through tmp */
+struct MergeSort {
+    struct Input {
+        int *x, *tmp;
+        long n;
+    };
+    using Output = int;
+    bool is_base(const Input &in) const { return in.n <= LEAF; }
+    int base(const Input &in) const { insertion_sort(in.x, in.n); return 0; }
+    long size(const Input &in) const { return in.n; }
+    pair<Input, Input> split(const Input &in) const {
+        long h = in.n / 2;
+        return {{in.x, in.tmp, h}, {in.x + h, in.tmp + h, in.n - h}};
+    }
+    int combine(const Input &in, int, int) const {
+        long h = in.n / 2, i = 0, j = h, k = 0;
+        while (i < h && j < in.n)
+            in.tmp[k++] = (in.x[i] <= in.x[j]) ? in.x[i++] : in.x[j++];
+        while (i < h)
+            in.tmp[k++] = in.x[i++];
+        while (j < in.n)
+            in.tmp[k++] = in.x[j++];
+        memcpy(in.x, in.tmp, in.n * sizeof(int));
+        return 0;
+    }
+};
+
+/* Quicksort: the split does the work (a Hoare partition around a median of three),
+   and there is nothing to combine */
+struct QuickSort {
+    struct Input {
+        int *x;
+        long n;
+    };
+    using Output = int;
+    bool is_base(const Input &in) const { return in.n <= LEAF; }
+    int base(const Input &in) const { insertion_sort(in.x, in.n); return 0; }
+    long size(const Input &in) const { return in.n; }
+    pair<Input, Input> split(const Input &in) const {
+        int *x = in.x;
+        long n = in.n;
+        int a = x[0], b = x[n / 2], c = x[n - 1];
+        int pivot = max(min(a, b), min(max(a, b), c));
+        long i = -1, j = n;
+        for (;;) {
+            do i++; while (x[i] < pivot);
+            do j--; while (x[j] > pivot);
+            if (i >= j)
+                break;
+            swap(x[i], x[j]);
+        }
+        return {{x, j + 1}, {x + j + 1, n - j - 1}};
+    }
+    int combine(const Input &, int, int) const { return 0; }
+};
+
+/* The hand-written versions, with their original cutoffs */
+long fib_tasks(int n) {
+    long i, j;
+    if (n < 2)
+        return n;
+    #pragma omp task shared(i)
+    i = fib_tasks(n - 1);
+    #pragma omp task shared(j)
+    j = fib_tasks(n - 2);
+    #pragma omp taskwait
+    return i + j;
+}
+
+void merge_sort_tasks(int *x, long n, int *tmp) {
+    if (n < 2)
+        return;
+    #pragma omp task if (n > TASK_SIZE)
+    merge_sort_tasks(x, n / 2, tmp);
+    #pragma omp task if (n > TASK_SIZE)
+    merge_sort_tasks(x + n / 2, n - n / 2, tmp + n / 2);
+    #pragma omp taskwait
+    MergeSort().combine({x, tmp, n}, 0, 0);
+}
+
+double pi_tasks(long lo, long hi, double step) {
+    if (hi - lo < MIN_BLK)
+        return Pi{step}.base({lo, hi});
+    double a, b;
+    #pragma omp task shared(a)
+    a = pi_tasks(lo, lo + (hi - lo) / 2, step);
+    #pragma omp task shared(b)
+    b = pi_tasks(lo + (hi - lo) / 2, hi, step);
+    #pragma omp taskwait
+    return a + b;
+}
+
+template <typename F>
+double timed(F f) {
+    double t = omp_get_wtime();
+    f();
+    return omp_get_wtime() - t;
+}
+
+void row(const char *problem, const char *variant, long cutoff, double t, double base, bool ok) {
+    char c[24] = "-";
+    if (cutoff >= 0)
+        snprintf(c, sizeof(c), "%ld", cutoff);
+    printf("  %-10s %-28s %10s %10.2f %8.2fx   %s\n", problem, variant, c, t * 1e3, base / t,
+           ok ? "yes" : "NO");
+}
+
+/* Serial recursion after one warm-up run, then both backends with a freshly calibrated
+   cutoff. `reset` restores the input before every run and `check` validates the output. */
+template <typename Problem, typename Reset, typename Check>
+double run(const char *name, Problem p, typename Problem::Input in, Reset reset, Check check) {
+    typename Problem::Output out{};
+    DivideAndConquer<Problem> serial(p);
+    reset();
+    out = serial.serial(in);        /* warm-up, so the baseline is not the cold run */
+    reset();
+    double base = timed([&] { out = serial.serial(in); });
+    row(name, "serial recursion", -1, base, base, check(out));
+
+    const DcBackend backends[2] = {DC_OPENMP, DC_STEALING};
+    const char *names[2] = {"skeleton, OpenMP tasks", "skeleton, work stealing"};
+    for (int k = 0; k < 2; k++) {
+        DivideAndConquer<Problem> dc(p, backends[k]);
+        reset();
+        dc.calibrate(in);
+        reset();
+        double t = timed([&] { out = dc.solve(in); });
+        row(name, names[k], dc.get_cutoff(), t, base, check(out));
+    }
+    return base;
+}
+
+int main(int argc, char *argv[]) {
+    int numThreads = (argc > 1) ? atoi(argv[1]) : omp_get_max_threads();
+    int fib_n = (argc > 2) ? atoi(argv[2]) : FIB_N;
+    long sort_n = (argc > 3) ? atol(argv[3]) : SORT_N;
+
+    omp_set_dynamic(0);
+    omp_set_num_threads(numThreads);
+    printf("\n  %d threads; one task costs %.3f us, so leaves aim for %.0f us\n", numThreads,
+           dc_task_overhead() * 1e6, max(DC_GRAIN * dc_task_overhead(), DC_MIN_LEAF) * 1e6);
+    printf("  %-10s %-28s %10s %10s %9s   %s\n", "problem", "variant", "cutoff", "ms",
+           "speedup", "correct");
+
+    /* fib */
+    long f_expect = 0, f0 = 0, f1 = 1;
+    for (int i = 0; i < fib_n; i++) {
+        f_expect = f0 + f1;
+        f0 = f1;
+        f1 = f_expect;
+    }
+    f_expect = f0;
+    double base = run("fib", Fib(), fib_n, [] {}, [&](long r) { return r == f_expect; });
+    long r = 0;
+    double t = timed([&] {
+        #pragma omp parallel
+        #pragma omp single
+        r = fib_tasks(fib_n);
+    });
+    row("fib", "task_fibonacci.cpp (none)", 0, t, base, r == f_expect);
+
+    /* pi */
+    Pi pi{1.0 / PI_STEPS};
+    Pi::Input all = {0, PI_STEPS};
+    auto pi_ok = [&](double s) { return fabs(s * pi.step - M_PI) < 1e-9; };
+    base = run("pi", pi, all, [] {}, pi_ok);
+    double s = 0.0;
+    t = timed([&] {
+        #pragma omp parallel
+        #pragma omp single
+        s = pi_tasks(0, PI_STEPS, pi.step);
+    });
+    row("pi", "pi_integral_tasks.py", MIN_BLK, t, base, pi_ok(s));
+
+    /* sorts: every run sorts the same random input */
+    vector<int> input(sort_n), x(sort_n), tmp(sort_n), sorted;
+    unsigned seed = 2024;
+    for (long i = 0; i < sort_n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        input[i] = (int)(seed >> 1);
+    }
+    sorted = input;
+    std::sort(sorted.begin(), sorted.end());
+    auto reset = [&] { x = input; };
+    auto sort_ok = [&](int) { return x == sorted; };
+
+    base = run("mergesort", MergeSort(), MergeSort::Input{x.data(), tmp.data(), sort_n}, reset, sort_ok);
+    reset();
+    t = timed([&] {
+        #pragma omp parallel
+        #pragma omp single
+        merge_sort_tasks(x.data(), sort_n, tmp.data());
+    });
+    row("mergesort", "merge_sort.cpp", TASK_SIZE, t, base, sort_ok(0));
+
+    run("quicksort", QuickSort(), QuickSort::Input{x.data(), sort_n}, reset, sort_ok);
+    return 0;
+}
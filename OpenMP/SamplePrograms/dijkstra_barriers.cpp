@@ -0,0 +1,201 @@
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <climits>
+#include <vector>
+#include <omp.h>
+#include "barriers.h"
+
+using namespace std;
+
+#define NV      4096     // Default number of nodes
+#define REPS    5        // Runs per variant; the fastest is reported
+
+const int i4_huge = INT_MAX;
+
+// Dense random graph: every pair of nodes is linked with probability 1/2, weight 1..1000
+vector<int> make_graph(int nv) {
+    vector<int> ohd((size_t)nv * nv);
+    unsigned long long s = 88172645463325252ULL;
+    for (int i = 0; i < nv; i++) {
+        ohd[(size_t)i * nv + i] = 0;
+        for (int j = i + 1; j < nv; j++) {
+            s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+            int w = (s % 2) ? (int)(1 + (s >> 8) % 1000) : i4_huge;
+            ohd[(size_t)i * nv + j] = ohd[(size_t)j * nv + i] = w;
+        }
+    }
+    return ohd;
+}
+
+// FIND_NEAREST of dijkstra.cpp: nearest unconnected node in [s, e]
+void find_nearest(int s, int e, const int *mind, const bool *connected, int *d, int *v) {
+    *d = i4_huge;
+    *v = -1;
+    for (int i = s; i <= e; i++)
+        if (!connected[i] && mind[i] < *d) {
+            *d = mind[i];
+            *v = i;
+        }
+}
+
+// UPDATE_MIND of dijkstra.cpp, with the distance to mv passed in
+void update_mind(int s, int e, int mv, int md, const bool *connected, const int *ohd, int nv,
+                 int *mind) {
+    const int *row = ohd + (size_t)mv * nv;
+    for (int i = s; i <= e; i++)
+        if (!connected[i] && row[i] < i4_huge && md + row[i] < mind[i])
+            mind[i] = md + row[i];
+}
+
+// The structure of dijkstra.cpp: per step a single, a critical and three barriers
+void dijkstra_omp(int nv, const int *ohd, int *mind, bool *connected) {
+    int md, mv;
+    #pragma omp parallel
+    {
+        int my_id = omp_get_thread_num(), nth = omp_get_num_threads();
+        int my_first = (my_id * nv) / nth, my_last = ((my_id + 1) * nv) / nth - 1;
+        int my_md, my_mv;
+        for (int my_step = 1; my_step < nv; my_step++) {
+            #pragma omp single
+            {
+                md = i4_huge;
+                mv = -1;
+            }
+            find_nearest(my_first, my_last, mind, connected, &my_md, &my_mv);
+            #pragma omp critical
+            {
+                if (my_md < md) {
+                    md = my_md;
+                    mv = my_mv;
+                }
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                if (mv != -1)
+                    connected[mv] = true;
+            }
+            #pragma omp barrier
+            if (mv != -1)
+                update_mind(my_first, my_last, mv, md, connected, ohd, nv, mind);
+            #pragma omp barrier
+        }
+    }
+}
+
+// omp barrier behind the same interface as the barriers of barriers.h
+struct OmpBarrier {
+    explicit OmpBarrier(int) {}
+    void wait(int) {
+        #pragma omp barrier
+    }
+};
+
+// One barrier per step: each thread posts its nearest node in a slot, waits, and reads
+// every slot. The slots alternate between two sets, so a thread that races ahead to the
+// next step cannot overwrite a slot another thread is still reading. Each thread marks
+// and updates only its own nodes, which nobody else reads.
+template <typename Barrier>
+void dijkstra_slots(int nv, const int *ohd, int *mind, bool *connected) {
+    int nth = omp_get_max_threads();
+    Barrier b(nth);
+    struct alignas(64) Slot { MinLoc<int> m; };
+    vector<Slot> slots(2 * nth);
+    #pragma omp parallel num_threads(nth)
+    {
+        int my_id = omp_get_thread_num();
+        int my_first = (my_id * nv) / nth, my_last = ((my_id + 1) * nv) / nth - 1;
+        for (int my_step = 1; my_step < nv; my_step++) {
+            Slot *set = &slots[(my_step % 2) * nth];
+            find_nearest(my_first, my_last, mind, connected, &set[my_id].m.value, &set[my_id].m.index);
+            b.wait(my_id);
+            MinLoc<int> best = set[0].m;
+            for (int t = 1; t < nth; t++)
+                if (set[t].m < best)
+                    best = set[t].m;
+            if (best.index == -1)
+                continue;
+            if (best.index >= my_first && best.index <= my_last)
+                connected[best.index] = true;
+            update_mind(my_first, my_last, best.index, best.value, connected, ohd, nv, mind);
+        }
+    }
+}
+
+// One fused barrier-and-argmin per step
+void dijkstra_argmin(int nv, const int *ohd, int *mind, bool *connected) {
+    int nth = omp_get_max_threads();
+    ArgminBarrier<int> b(nth);
+    #pragma omp parallel num_threads(nth)
+    {
+        int my_id = omp_get_thread_num();
+        int my_first = (my_id * nv) / nth, my_last = ((my_id + 1) * nv) / nth - 1;
+        for (int my_step = 1; my_step < nv; my_step++) {
+            int my_md, my_mv;
+            find_nearest(my_first, my_last, mind, connected, &my_md, &my_mv);
+            MinLoc<int> best = b.wait(my_id, my_md, my_mv);
+            if (best.index == -1)
+                continue;
+            if (best.index >= my_first && best.index <= my_last)
+                connected[best.index] = true;
+            update_mind(my_first, my_last, best.index, best.value, connected, ohd, nv, mind);
+        }
+    }
+}
+
+void dijkstra_serial(int nv, const int *ohd, int *mind, bool *connected) {
+    for (int step = 1; step < nv; step++) {
+        int md, mv;
+        find_nearest(0, nv - 1, mind, connected, &md, &mv);
+        if (mv == -1)
+            break;
+        connected[mv] = true;
+        update_mind(0, nv - 1, mv, md, connected, ohd, nv, mind);
+    }
+}
+
+typedef void (*variant)(int, const int *, int *, bool *);
+
+int main(int argc, char *argv[]) {
+    int nv = (argc > 1) ? atoi(argv[1]) : NV;
+    int numThreads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+    const char *names[] = {"serial", "omp (dijkstra.cpp)", "omp barrier + slots", "central + slots",
+                           "tree + slots", "dissemination + slots", "tournament + slots",
+                           "argmin barrier"};
+    variant fns[] = {dijkstra_serial, dijkstra_omp, dijkstra_slots<OmpBarrier>,
+                     dijkstra_slots<CentralBarrier>, dijkstra_slots<TreeBarrier>,
+                     dijkstra_slots<DisseminationBarrier>, dijkstra_slots<TournamentBarrier>,
+                     dijkstra_argmin};
+    const int nvariants = sizeof(fns) / sizeof(fns[0]);
+
+    omp_set_dynamic(0);
+    omp_set_num_threads(numThreads);
+    vector<int> ohd = make_graph(nv), ref;
+    cout << "\n  Dense Dijkstra on " << nv << " nodes, " << numThreads << " threads\n\n";
+    cout << "  " << setw(24) << left << "variant" << right << setw(12) << "time (ms)"
+         << setw(14) << "us per step" << setw(10) << "correct" << "\n";
+
+    for (int v = 0; v < nvariants; v++) {
+        double best = 1e30;
+        vector<int> mind(nv);
+        for (int r = 0; r < REPS; r++) {
+            bool *connected = new bool[nv]();
+            connected[0] = true;
+            for (int i = 0; i < nv; i++)
+                mind[i] = ohd[i];
+            double t = omp_get_wtime();
+            fns[v](nv, ohd.data(), mind.data(), connected);
+            t = omp_get_wtime() - t;
+            best = min(best, t);
+            delete[] connected;
+        }
+        if (v == 0)
+            ref = mind;
+        cout << "  " << setw(24) << left << names[v] << right << fixed << setprecision(3)
+             << setw(12) << best * 1e3 << setw(14) << best * 1e6 / (nv - 1)
+             << setw(10) << (mind == ref ? "yes" : "NO") << "\n";
+    }
+    cout << "\n  Normal end of execution.\n\n";
+    return 0;
+}
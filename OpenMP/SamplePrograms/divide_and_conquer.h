@@ -0,0 +1,225 @@
+#ifndef DIVIDE_AND_CONQUER_H
+#define DIVIDE_AND_CONQUER_H
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <omp.h>
+#include "lockfree.h"
+
+/*
+ * The spawn / spawn / taskwait / combine pattern of task_fibonacci.cpp and
+ * merge_sort.cpp, written once. A problem is described by a policy class:
+ *
+ *   struct Problem {
+ *       using Input = ...;  using Output = ...;              Output default-constructible
+ *       bool   is_base(const Input &) const;                  solved directly
+ *       Output base(const Input &) const;
+ *       long   size(const Input &) const;                     grows with the work
+ *       std::pair<Input, Input> split(const Input &) const;
+ *       Output combine(const Input &, const Output &, const Output &) const;
+ *   };
+ *
+ * Subproblems no larger than the cutoff are solved by the same recursion without tasks.
+ * Unless set_cutoff() is used, the cutoff is calibrated on the first input. The solver
+ * follows the chain of first halves down to a base case and times the serial solution
+ * of each subproblem on the chain, the best of three runs, from the bottom up. The
+ * cutoff is the size of the first subproblem that takes DC_GRAIN times as long as
+ * spawning and joining one task, so spawning costs about 1/DC_GRAIN of the run. That
+ * holds when the serial time of the subproblems grows the way their count shrinks; a
+ * base case the optimizer can see through may break it. Solving a subproblem ahead of
+ * time must not change the final answer; sorting a range twice is fine, for example.
+ *
+ * solve() must be called by one thread: outside a parallel region, or inside a single
+ * construct. Called by a whole team, every thread solves the whole problem.
+ *
+ * Backends:
+ *  DC_OPENMP    an OpenMP task for the first half, the second half inline, a taskwait.
+ *  DC_STEALING  continuation passing on a WorkBag (lockfree.h). Nobody waits: a frame
+ *               pushes one half for thieves and works on the other, and whichever half
+ *               finishes last combines the results and carries on up the tree.
+ */
+
+#define DC_GRAIN     100      /* serial work per leaf, in units of task overhead */
+#define DC_MIN_LEAF  2e-6     /* seconds; a floor for the calibrated leaf time */
+
+enum DcBackend { DC_OPENMP, DC_STEALING };
+
+/* Seconds to create and join one empty OpenMP task, measured once */
+inline double dc_task_overhead() {
+    static double overhead = -1.0;
+    if (overhead < 0.0) {
+        const int n = 4096;
+        double t = 0.0;
+        volatile int sink = 0;  /* an empty task may be compiled away */
+        #pragma omp parallel
+        #pragma omp single
+        {
+            t = omp_get_wtime();
+            for (int i = 0; i < n; i++) {
+                #pragma omp task shared(sink)
+                sink = i;
+                #pragma omp taskwait
+            }
+            t = omp_get_wtime() - t;
+        }
+        (void)sink;
+        overhead = t / n;
+    }
+    return overhead;
+}
+
+template <typename Problem>
+class DivideAndConquer {
+public:
+    using Input = typename Problem::Input;
+    using Output = typename Problem::Output;
+
+    explicit DivideAndConquer(Problem p, DcBackend backend = DC_OPENMP)
+        : p(p), backend(backend) {}
+
+    void set_cutoff(long size) { cutoff = size; }
+    long get_cutoff() const { return cutoff; }
+
+    /* Choose the cutoff from serial timings of subproblems of `sample` */
+    long calibrate(const Input &sample) {
+        std::vector<Input> chain;
+        Input cur = sample;
+        while (!p.is_base(cur)) {
+            chain.push_back(cur);
+            cur = p.split(cur).first;
+        }
+        double target = DC_GRAIN * dc_task_overhead();
+        if (target < DC_MIN_LEAF)
+            target = DC_MIN_LEAF;
+        cutoff = p.size(sample);
+        for (size_t k = chain.size(); k-- > 0;) {
+            double best = 1e30;
+            for (int r = 0; r < 3; r++) {
+                double t = omp_get_wtime();
+                serial(chain[k]);
+                t = omp_get_wtime() - t;
+                best = t < best ? t : best;
+            }
+            if (best >= target) {
+                cutoff = p.size(chain[k]);
+                break;
+            }
+        }
+        return cutoff;
+    }
+
+    /* From one thread only; see above */
+    Output solve(const Input &in) {
+        if (cutoff < 0)
+            calibrate(in);
+        if (backend == DC_STEALING)
+            return solve_stealing(in);
+        Output out;
+        if (omp_in_parallel()) {
+            out = omp_task(in);
+        } else {
+            #pragma omp parallel
+            #pragma omp single
+            out = omp_task(in);
+        }
+        return out;
+    }
+
+    /* Plain recursion, used below the cutoff */
+    Output serial(const Input &in) const {
+        if (p.is_base(in))
+            return p.base(in);
+        std::pair<Input, Input> s = p.split(in);
+        Output a = serial(s.first);
+        Output b = serial(s.second);
+        return p.combine(in, a, b);
+    }
+
+private:
+    Problem p;
+    DcBackend backend;
+    long cutoff = -1;
+
+    Output omp_task(const Input &in) {
+        if (p.is_base(in) || p.size(in) <= cutoff)
+            return serial(in);
+        std::pair<Input, Input> s = p.split(in);
+        Output a, b;
+        #pragma omp task shared(a, s)
+        a = omp_task(s.first);
+        b = omp_task(s.second);
+        #pragma omp taskwait
+        return p.combine(in, a, b);
+    }
+
+    /* A node of the recursion tree. The children write their results into out[] of
+       their parent; the one that brings `pending` to zero combines them. */
+    struct Frame {
+        Input in;
+        Output result;
+        Frame *parent;
+        int side;
+        std::atomic<int> pending{2};
+        Output out[2];
+        Frame *child[2] = {nullptr, nullptr};
+        Frame(const Input &in, Frame *parent, int side) : in(in), parent(parent), side(side) {}
+    };
+
+    Output solve_stealing(const Input &in) {
+        int nthreads = omp_get_max_threads();
+        WorkBag<Frame *> bag(nthreads);
+        Frame *root = new Frame(in, nullptr, 0);
+        std::atomic<bool> done(false);
+
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int tid = omp_get_thread_num();
+            if (tid == 0)
+                bag.add(0, root);
+            Frame *f;
+            while (!done.load(std::memory_order_acquire)) {
+                if (!bag.take(tid, f)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                /* Go down the tree, leaving one half of every split for thieves */
+                while (!p.is_base(f->in) && p.size(f->in) > cutoff) {
+                    std::pair<Input, Input> s = p.split(f->in);
+                    f->child[0] = new Frame(s.first, f, 0);
+                    f->child[1] = new Frame(s.second, f, 1);
+                    bag.add(tid, f->child[1]);
+                    f = f->child[0];
+                }
+                f->result = serial(f->in);
+                /* Go up while this thread finishes the last child of each frame */
+                while (f->parent != nullptr) {
+                    Frame *up = f->parent;
+                    up->out[f->side] = f->result;
+                    if (up->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                        break;
+                    up->result = p.combine(up->in, up->out[0], up->out[1]);
+                    delete up->child[0];
+                    delete up->child[1];
+                    f = up;
+                }
+                if (f == root)
+                    done.store(true, std::memory_order_release);
+            }
+        }
+        Output out = root->result;
+        delete root;
+        return out;
+    }
+};
+
+/* One call: solve `in` with a cutoff calibrated on it */
+template <typename Problem>
+typename Problem::Output divide_and_conquer(const Problem &p, const typename Problem::Input &in,
+                                            DcBackend backend = DC_OPENMP) {
+    DivideAndConquer<Problem> dc(p, backend);
+    return dc.solve(in);
+}
+
+#endif
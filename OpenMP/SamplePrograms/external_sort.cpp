@@ -0,0 +1,165 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <vector>
+#include "external_sort.h"
+
+#define MEMORY_MB  256        /* Default memory budget of the sort */
+#define COPY_BLOCK (8 << 20)  /* Bytes per request of gen, copy and check */
+
+using namespace std;
+
+/*
+ * Sorts a file of ints with external_sort.h, with a memory budget that can be far below
+ * the file size.
+ *
+ *   ./external_sort gen FILE COUNT                       COUNT random ints
+ *   ./external_sort copy IN OUT [direct]                 the disk's copy rate, for reference
+ *   ./external_sort sort IN OUT [memory MB] [threads] [direct]
+ *   ./external_sort check OUT IN                         OUT sorted, with the keys of IN
+ *
+ * Every key is read and written twice, once per pass, so a sort at disk speed takes
+ * about twice as long as the copy.
+ */
+
+double mib(double bytes) {
+    return bytes / (1 << 20);
+}
+
+int gen(const char *name, long count) {
+    int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(name);
+        return 1;
+    }
+    vector<int> buf(COPY_BLOCK / sizeof(int));
+    unsigned s = 2024;
+    for (long done = 0; done < count;) {
+        long m = min<long>(buf.size(), count - done);
+        for (long i = 0; i < m; i++) {
+            s = s * 1103515245u + 12345u;
+            buf[i] = (int)(s >> 1);
+        }
+        if (!xs_pwrite(fd, buf.data(), m * sizeof(int), (off_t)done * sizeof(int))) {
+            perror(name);
+            return 1;
+        }
+        done += m;
+    }
+    fdatasync(fd);
+    close(fd);
+    printf("\n  %s: %ld ints, %.0f MiB\n", name, count, mib((double)count * sizeof(int)));
+    return 0;
+}
+
+int copy_file(const char *in, const char *out, bool direct) {
+    int in_fd = open(in, O_RDONLY | (direct ? O_DIRECT : 0));
+    int out_fd = open(out, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+    if (in_fd < 0 || out_fd < 0) {
+        perror(in_fd < 0 ? in : out);
+        return 1;
+    }
+    char *buf = (char *)aligned_alloc(XS_ALIGN, COPY_BLOCK);
+    double t = omp_get_wtime();
+    off_t off = 0;
+    ssize_t r;
+    while ((r = xs_pread(in_fd, buf, COPY_BLOCK, off)) > 0) {
+        if (!xs_pwrite(out_fd, buf, r, off)) {
+            perror(out);
+            return 1;
+        }
+        off += r;
+    }
+    fdatasync(out_fd);
+    t = omp_get_wtime() - t;
+    free(buf);
+    close(in_fd);
+    close(out_fd);
+    printf("\n  copy %.0f MiB%s: %.2f s, %.0f MiB/s\n", mib(off), direct ? " (O_DIRECT)" : "", t,
+           mib(off) / t);
+    return 0;
+}
+
+/* Whether the file is sorted, and a sum of mixed keys that does not depend on order */
+bool scan(const char *name, bool &sorted, unsigned long long &hash, long &count) {
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        perror(name);
+        return false;
+    }
+    vector<int> buf(COPY_BLOCK / sizeof(int));
+    sorted = true;
+    hash = 0;
+    count = 0;
+    int last = 0;
+    ssize_t r;
+    while ((r = xs_pread(fd, buf.data(), COPY_BLOCK, (off_t)count * sizeof(int))) > 0) {
+        long m = r / sizeof(int);
+        for (long i = 0; i < m; i++) {
+            if ((count > 0 || i > 0) && buf[i] < last)
+                sorted = false;
+            last = buf[i];
+            unsigned long long h = (unsigned)buf[i] * 0x9e3779b97f4a7c15ull;
+            hash += h ^ (h >> 29);
+        }
+        count += m;
+    }
+    close(fd);
+    return true;
+}
+
+int check(const char *out, const char *in) {
+    bool sorted, unused;
+    unsigned long long h_out, h_in;
+    long n_out, n_in;
+    if (!scan(out, sorted, h_out, n_out) || !scan(in, unused, h_in, n_in))
+        return 1;
+    bool ok = sorted && h_out == h_in && n_out == n_in;
+    printf("\n  %s: %ld ints, %s, %s keys as %s: %s\n", out, n_out, sorted ? "sorted" : "NOT sorted",
+           h_out == h_in && n_out == n_in ? "same" : "NOT the same", in, ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *mode = argc > 1 ? argv[1] : "";
+    if (!strcmp(mode, "gen") && argc > 3)
+        return gen(argv[2], atol(argv[3]));
+    if (!strcmp(mode, "copy") && argc > 3)
+        return copy_file(argv[2], argv[3], argc > 4 && atoi(argv[4]));
+    if (!strcmp(mode, "check") && argc > 3)
+        return check(argv[2], argv[3]);
+    if (strcmp(mode, "sort") || argc < 4) {
+        fprintf(stderr, "usage: %s gen FILE COUNT | copy IN OUT [direct] |\n"
+                        "       sort IN OUT [memory MB] [threads] [direct] | check OUT IN\n", argv[0]);
+        return 1;
+    }
+
+    ExternalSortOptions opt;
+    opt.memory = (size_t)((argc > 4) ? atol(argv[4]) : MEMORY_MB) << 20;
+    opt.threads = (argc > 5) ? atoi(argv[5]) : omp_get_max_threads();
+    opt.direct = argc > 6 && atoi(argv[6]);
+    string dir = argv[3];
+    dir = dir.find('/') == string::npos ? "." : dir.substr(0, dir.rfind('/') + 1);
+    opt.tmpdir = dir.c_str();
+    omp_set_dynamic(0);
+
+    ExternalSortStats st;
+    if (!external_sort<int>(argv[2], argv[3], opt, &st))
+        return 1;
+    double bytes = (double)st.n * sizeof(int);
+    printf("\n  %ld ints, %.0f MiB, memory %.0f MiB, %d threads%s\n", st.n, mib(bytes),
+           mib(opt.memory), opt.threads, opt.direct ? ", O_DIRECT" : "");
+    printf("  %d runs of %.0f KiB, merge buffers of %.0f KiB\n", st.runs, st.chunk_bytes / 1024.0,
+           st.block_bytes / 1024.0);
+    printf("  %-14s %9s %12s\n", "pass", "seconds", "MiB/s");
+    printf("  %-14s %9.2f %12.0f\n", "run formation", st.run_seconds, mib(bytes) / st.run_seconds);
+    printf("  %-14s %9.2f\n", "  of it, sort", st.sort_seconds);
+    printf("  %-14s %9.2f %12.0f\n", "merge", st.merge_seconds, mib(bytes) / st.merge_seconds);
+    double total = st.run_seconds + st.merge_seconds;
+    printf("  %-14s %9.2f %12.0f\n", "total", total, mib(bytes) / total);
+    return 0;
+}
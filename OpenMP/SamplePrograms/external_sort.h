@@ -0,0 +1,495 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <aio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include "parallel_quicksort.h"
+
+/*
+ * Sorts a file of raw keys that need not fit in memory, in two passes over the data.
+ *
+ *   ExternalSortOptions opt = {256 << 20, 4, true, "/tmp"};   memory, threads, O_DIRECT
+ *   ExternalSortStats st;
+ *   external_sort<int>("in.bin", "out.bin", opt, &st);
+ *
+ * Run formation: the input is read in chunks of a third of the memory budget. While the
+ * threads sort one chunk with parallel_quicksort, a helper thread writes the previous
+ * sorted chunk to the run file and reads the next one, so the disk never waits for the
+ * sort. Every XS_STRIDE-th key of each run is kept in memory.
+ *
+ * Merge: the kept keys give p - 1 splitters, and thread t merges the keys in
+ * [splitter t, splitter t + 1) from every run. A binary search on the kept keys and one
+ * small read find where that range starts in each run, and the sizes give where its
+ * output starts, so the threads merge and write independently. A loser tree picks the
+ * next key in log2(runs) comparisons. Each run has two buffers: the tree consumes one
+ * while aio_read fills the other, and the output is written the same way with
+ * aio_write.
+ *
+ * With O_DIRECT, the input and the run file bypass the page cache, so all offsets,
+ * sizes and buffers are multiples of XS_ALIGN. The output is written through the page
+ * cache and flushed with fdatasync before the merge is timed as done.
+ *
+ * Both passes run on opt.threads threads, at least one, set on their own parallel
+ * regions; the caller's OpenMP settings are left alone.
+ */
+
+#define XS_ALIGN   4096   /* O_DIRECT alignment of offsets, sizes and buffers */
+#define XS_STRIDE  4096   /* Keys of a run between two kept keys */
+
+struct ExternalSortOptions {
+    size_t memory;        /* bytes of buffers, in both passes */
+    int threads;
+    bool direct;          /* O_DIRECT for the input and the run file */
+    const char *tmpdir;   /* where the run file goes */
+};
+
+struct ExternalSortStats {
+    long n;
+    int runs;
+    size_t chunk_bytes, block_bytes;   /* per run, and per merge buffer */
+    double run_seconds, merge_seconds;
+    double sort_seconds;               /* of run_seconds, sorting chunks in memory */
+};
+
+inline size_t xs_round_down(size_t bytes) {
+    return bytes / XS_ALIGN * XS_ALIGN;
+}
+
+/* Reads until `bytes` or the end of the file; returns the bytes read or -1 */
+inline ssize_t xs_pread(int fd, void *buf, size_t bytes, off_t off) {
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t r = pread(fd, (char *)buf + done, bytes - done, off + done);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        done += r;
+    }
+    return done;
+}
+
+/* Writes all of buf. On an O_DIRECT file, a tail that is not a whole block is written
+   with O_DIRECT switched off. */
+inline bool xs_pwrite(int fd, const void *buf, size_t bytes, off_t off) {
+    int flags = fcntl(fd, F_GETFL);
+    size_t done = 0;
+    while (done < bytes) {
+        size_t part = bytes - done;
+        if ((flags & O_DIRECT) && part % XS_ALIGN != 0) {
+            if (part > XS_ALIGN)
+                part = xs_round_down(part);
+            else
+                fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+        }
+        ssize_t w = pwrite(fd, (const char *)buf + done, part, off + done);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0) {
+            fcntl(fd, F_SETFL, flags);
+            return false;
+        }
+        done += w;
+    }
+    fcntl(fd, F_SETFL, flags);
+    return true;
+}
+
+/* One asynchronous read or write in flight. Where aio_read or aio_write fails to start,
+   the request is done at once and wait() returns its result. */
+struct XsAio {
+    struct aiocb cb;
+    bool busy = false, write = false;
+    ssize_t result = 0;
+
+    void start(bool is_write, int fd, void *buf, size_t bytes, off_t off) {
+        memset(&cb, 0, sizeof(cb));
+        cb.aio_fildes = fd;
+        cb.aio_buf = buf;
+        cb.aio_nbytes = bytes;
+        cb.aio_offset = off;
+        write = is_write;
+        busy = (write ? aio_write(&cb) : aio_read(&cb)) == 0;
+        if (!busy)
+            result = write ? (xs_pwrite(fd, buf, bytes, off) ? (ssize_t)bytes : -1)
+                           : xs_pread(fd, buf, bytes, off);
+    }
+
+    /* Bytes moved by the last request, -1 on error */
+    ssize_t wait() {
+        if (!busy)
+            return result;
+        const struct aiocb *list[1] = {&cb};
+        while (aio_error(&cb) == EINPROGRESS)
+            aio_suspend(list, 1, nullptr);
+        busy = false;
+        result = aio_return(&cb);
+        /* Finish a short write, or a short read that did not stop at the end of the file */
+        char *buf = (char *)cb.aio_buf;
+        size_t r = result;
+        if (result >= 0 && r < cb.aio_nbytes) {
+            if (write)
+                result = xs_pwrite(cb.aio_fildes, buf + r, cb.aio_nbytes - r, cb.aio_offset + r)
+                             ? (ssize_t)cb.aio_nbytes : -1;
+            else if (r > 0 && r % XS_ALIGN == 0) {
+                ssize_t more = xs_pread(cb.aio_fildes, buf + r, cb.aio_nbytes - r, cb.aio_offset + r);
+                result = more < 0 ? -1 : result + more;
+            }
+        }
+        return result;
+    }
+};
+
+/* Reads keys [begin, end) of a run file through two buffers of `block` bytes */
+template <typename T>
+class XsRunReader {
+public:
+    bool ok = true;
+
+    ~XsRunReader() { aio.wait(); }
+
+    void open(int fd, long begin, long end, size_t block, T *b0, T *b1) {
+        this->fd = fd;
+        this->end = end;
+        this->block = block;
+        buf[0] = b0;
+        buf[1] = b1;
+        which = 0;
+        issue(begin, 0);
+        ncur = i = 0;
+        refill();
+    }
+
+    bool empty() const { return i == ncur; }
+    const T &front() const { return cur[i]; }
+
+    /* Moves to the next key; false once the run is used up */
+    bool advance() {
+        if (++i < ncur)
+            return true;
+        return refill();
+    }
+
+private:
+    int fd;
+    long end, pending;          /* first key of the block being read */
+    size_t block;
+    T *buf[2];
+    int which, pending_buf;
+    long pending_skip;
+    XsAio aio;
+    const T *cur = nullptr;
+    long ncur = 0, i = 0;
+
+    void issue(long first, int b) {
+        pending = first;
+        pending_buf = b;
+        if (first >= end)
+            return;
+        off_t off = (off_t)first * sizeof(T);
+        off_t aligned = off / XS_ALIGN * XS_ALIGN;
+        pending_skip = (off - aligned) / sizeof(T);
+        aio.start(false, fd, buf[b], block, aligned);
+    }
+
+    bool refill() {
+        if (pending >= end) {
+            ncur = i = 0;
+            return false;
+        }
+        ssize_t got = aio.wait();
+        if (got < 0) {
+            ok = false;
+            ncur = i = 0;
+            return false;
+        }
+        long keys = std::min<long>(got / (ssize_t)sizeof(T) - pending_skip, end - pending);
+        if (keys <= 0) {
+            ok = false;
+            ncur = i = 0;
+            return false;
+        }
+        cur = buf[pending_buf] + pending_skip;
+        ncur = keys;
+        i = 0;
+        issue(pending + keys, pending_buf ^ 1);
+        return true;
+    }
+};
+
+/* A tournament over k sources in which every inner node keeps the loser of its match,
+   key and source together; a new key for the winner replays only the matches on its
+   path. A used-up source loses every match. */
+template <typename T>
+class LoserTree {
+public:
+    explicit LoserTree(int k) : k(k), tree(k), leaf(k) {
+        for (int s = 0; s < k; s++)
+            leaf[s] = {T(), s, true};
+    }
+
+    void set(int s, const T &key) { leaf[s] = {key, s, false}; }
+    void build() { win = k == 1 ? leaf[0] : build(1); }
+
+    int winner() const { return win.src; }
+    const T &top() const { return win.key; }
+    bool finished() const { return win.done; }
+
+    /* The winner's next key, or its source used up */
+    void replace(const T &key) {
+        win.key = key;
+        replay();
+    }
+    void finish() {
+        win.done = true;
+        replay();
+    }
+
+private:
+    struct Node {
+        T key;
+        int src;
+        bool done;
+    };
+    int k;
+    std::vector<Node> tree, leaf;
+    Node win;
+
+    static bool less(const Node &a, const Node &b) {
+        return !a.done && (b.done || a.key < b.key);
+    }
+
+    void replay() {
+        Node w = win;
+        for (int node = (w.src + k) / 2; node >= 1; node /= 2)
+            if (less(tree[node], w))
+                std::swap(tree[node], w);
+        win = w;
+    }
+
+    Node build(int node) {
+        if (node >= k)
+            return leaf[node - k];
+        Node a = build(2 * node), b = build(2 * node + 1);
+        if (less(b, a))
+            std::swap(a, b);
+        tree[node] = b;
+        return a;
+    }
+};
+
+/* Position of the first key >= s in run [first, last), found from its kept keys and
+   one read of at most XS_STRIDE keys */
+template <typename T>
+long xs_lower_bound(int fd, long first, long last, const std::vector<T> &kept, const T &s, bool &ok) {
+    long j = std::lower_bound(kept.begin(), kept.end(), s) - kept.begin();
+    if (j == 0)
+        return first;
+    long lo = first + (j - 1) * (long)XS_STRIDE, hi = std::min(last, first + j * (long)XS_STRIDE);
+    off_t off = (off_t)lo * sizeof(T), aligned = off / XS_ALIGN * XS_ALIGN;
+    size_t bytes = ((off_t)hi * sizeof(T) - aligned + XS_ALIGN - 1) / XS_ALIGN * XS_ALIGN;
+    T *buf = (T *)aligned_alloc(XS_ALIGN, bytes);
+    ssize_t got = xs_pread(fd, buf, bytes, aligned);
+    long skip = (off - aligned) / sizeof(T);
+    if (got < (ssize_t)((hi - lo + skip) * sizeof(T)))
+        ok = false;
+    long pos = hi;
+    if (ok)
+        pos = lo + (std::lower_bound(buf + skip, buf + skip + (hi - lo), s) - (buf + skip));
+    free(buf);
+    return pos;
+}
+
+/* Merges run segments [begin[r], end[r]) into the output starting at key `out` */
+template <typename T>
+bool xs_merge_range(int fd, const std::vector<long> &begin, const std::vector<long> &end,
+                    int out_fd, long out, size_t block) {
+    int k = begin.size();
+    std::vector<T *> bufs(2 * k + 2);
+    for (T *&b : bufs)
+        b = (T *)aligned_alloc(XS_ALIGN, block);
+    std::vector<XsRunReader<T>> readers(k);
+    LoserTree<T> tree(k);
+    for (int r = 0; r < k; r++) {
+        readers[r].open(fd, begin[r], end[r], block, bufs[2 * r], bufs[2 * r + 1]);
+        if (!readers[r].empty())
+            tree.set(r, readers[r].front());
+    }
+    tree.build();
+
+    /* Two output buffers: one fills while aio_write drains the other */
+    const long per = block / sizeof(T);
+    T *obuf[2] = {bufs[2 * k], bufs[2 * k + 1]};
+    XsAio writes[2];
+    int o = 0;
+    long used = 0;
+    bool ok = true;
+    while (!tree.finished()) {
+        int w = tree.winner();
+        obuf[o][used++] = tree.top();
+        if (readers[w].advance())
+            tree.replace(readers[w].front());
+        else
+            tree.finish();
+        if (used == per) {
+            writes[o].start(true, out_fd, obuf[o], used * sizeof(T), (off_t)out * sizeof(T));
+            out += used;
+            used = 0;
+            o ^= 1;
+            ok = writes[o].wait() >= 0 && ok;      /* always wait: obuf[o] is refilled next */
+        }
+    }
+    if (used > 0) {
+        writes[o].start(true, out_fd, obuf[o], used * sizeof(T), (off_t)out * sizeof(T));
+        out += used;
+    }
+    ok = writes[0].wait() >= 0 && ok;
+    ok = writes[1].wait() >= 0 && ok;
+    for (XsRunReader<T> &rd : readers)
+        ok = ok && rd.ok;
+    for (T *b : bufs)
+        free(b);
+    return ok;
+}
+
+template <typename T>
+bool external_sort(const char *in, const char *out, const ExternalSortOptions &opt,
+                   ExternalSortStats *stats = nullptr) {
+    if (opt.threads <= 0) {
+        fprintf(stderr, "external_sort: needs at least one thread, not %d\n", opt.threads);
+        return false;
+    }
+    int direct = opt.direct ? O_DIRECT : 0;
+    int in_fd = open(in, O_RDONLY | direct);
+    if (in_fd < 0) {
+        perror(in);
+        return false;
+    }
+    struct stat st;
+    if (fstat(in_fd, &st) != 0) {
+        perror(in);
+        close(in_fd);
+        return false;
+    }
+    if (st.st_size % sizeof(T) != 0) {
+        fprintf(stderr, "%s: size is not a multiple of the key size\n", in);
+        close(in_fd);
+        return false;
+    }
+    long n = st.st_size / sizeof(T);
+    std::string runs_name = std::string(opt.tmpdir) + "/external_sort." + std::to_string(getpid()) + ".runs";
+    int runs_fd = open(runs_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | direct, 0600);
+    if (runs_fd < 0) {
+        perror(runs_name.c_str());
+        close(in_fd);
+        return false;
+    }
+    unlink(runs_name.c_str());      /* the open descriptor keeps the runs alive */
+    int out_fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        perror(out);
+        close(in_fd);
+        close(runs_fd);
+        return false;
+    }
+
+    /* Pass 1: three chunk buffers, one being read, one sorted and one written */
+    size_t chunk_bytes = xs_round_down(opt.memory / 3 / sizeof(T) * sizeof(T));
+    chunk_bytes = std::max<size_t>(chunk_bytes / (sizeof(T) * XS_ALIGN) * (sizeof(T) * XS_ALIGN),
+                                   sizeof(T) * XS_ALIGN);
+    long chunk = chunk_bytes / sizeof(T);
+    int nruns = (int)((n + chunk - 1) / chunk);
+    std::vector<std::vector<T>> kept(nruns);
+    T *bufs[3];
+    for (T *&b : bufs)
+        b = (T *)aligned_alloc(XS_ALIGN, chunk_bytes);
+    auto count = [&](int r) { return std::min(chunk, n - (long)r * chunk); };
+    bool ok = true;
+
+    double t = omp_get_wtime(), sort_seconds = 0;
+    if (nruns > 0)
+        ok = xs_pread(in_fd, bufs[0], chunk_bytes, 0) >= (ssize_t)(count(0) * sizeof(T));
+    for (int r = 0; r < nruns && ok; r++) {
+        bool io_ok = true;
+        std::thread io([&, r] {
+            if (r > 0)
+                io_ok = xs_pwrite(runs_fd, bufs[(r - 1) % 3], count(r - 1) * sizeof(T),
+                                  (off_t)(r - 1) * chunk_bytes);
+            if (io_ok && r + 1 < nruns)
+                io_ok = xs_pread(in_fd, bufs[(r + 1) % 3], chunk_bytes, (off_t)(r + 1) * chunk_bytes)
+                        >= (ssize_t)(count(r + 1) * sizeof(T));
+        });
+        T *x = bufs[r % 3];
+        double ts = omp_get_wtime();
+        #pragma omp parallel num_threads(opt.threads)
+        #pragma omp single
+        parallel_quicksort(x, count(r));
+        sort_seconds += omp_get_wtime() - ts;
+        for (long i = 0; i < count(r); i += XS_STRIDE)
+            kept[r].push_back(x[i]);
+        io.join();
+        ok = io_ok;
+    }
+    if (ok && nruns > 0)
+        ok = xs_pwrite(runs_fd, bufs[(nruns - 1) % 3], count(nruns - 1) * sizeof(T),
+                       (off_t)(nruns - 1) * chunk_bytes);
+    for (T *b : bufs)
+        free(b);
+    double run_seconds = omp_get_wtime() - t;
+
+    /* Pass 2: p key ranges, each merged from all runs by one thread */
+    t = omp_get_wtime();
+    int p = opt.threads;
+    size_t block = xs_round_down(opt.memory / ((size_t)p * (2 * nruns + 2)));
+    if (ok && nruns > 0 && block < XS_ALIGN) {
+        fprintf(stderr, "external_sort: %d runs need more than %zu bytes of memory\n", nruns,
+                opt.memory);
+        ok = false;
+    }
+    if (ok && nruns > 0) {
+        std::vector<T> all;
+        for (const std::vector<T> &v : kept)
+            all.insert(all.end(), v.begin(), v.end());
+        std::sort(all.begin(), all.end());
+        std::vector<std::vector<long>> lo(p + 1, std::vector<long>(nruns));
+        for (int r = 0; r < nruns; r++) {
+            lo[0][r] = (long)r * chunk;
+            lo[p][r] = (long)r * chunk + count(r);
+        }
+        for (int q = 1; q < p; q++)
+            for (int r = 0; r < nruns; r++)
+                lo[q][r] = xs_lower_bound(runs_fd, (long)r * chunk, (long)r * chunk + count(r),
+                                          kept[r], all[all.size() * q / p], ok);
+        #pragma omp parallel for schedule(static, 1) num_threads(p) reduction(&&:ok)
+        for (int q = 0; q < p; q++) {
+            long at = 0;
+            for (int r = 0; r < nruns; r++)
+                at += lo[q][r] - (long)r * chunk;
+            ok = xs_merge_range<T>(runs_fd, lo[q], lo[q + 1], out_fd, at, block) && ok;
+        }
+    }
+    ok = ok && fdatasync(out_fd) == 0;
+    double merge_seconds = omp_get_wtime() - t;
+
+    close(in_fd);
+    close(runs_fd);
+    close(out_fd);
+    if (stats)
+        *stats = {n, nruns, chunk_bytes, block, run_seconds, merge_seconds, sort_seconds};
+    return ok;
+}
+
+#endif
@@ -0,0 +1,417 @@
+#ifndef LOCKFREE_H
+#define LOCKFREE_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+ * Lock-free containers for producer/consumer pipelines between the threads of a team.
+ * Operations that touch shared memory which may be freed take the caller's thread id
+ * (0 <= tid < nthreads, e.g. omp_get_thread_num()), because reclamation tracks threads.
+ * Values must be trivially copyable.
+ *
+ *  BoundedQueue<T>    multi-producer multi-consumer ring of fixed capacity (Vyukov):
+ *                     every cell carries a sequence number that says whether it is
+ *                     ready for the next push or the next pop of its lap.
+ *  SpscQueue<T>       single-producer single-consumer ring; each side keeps a cached
+ *                     copy of the other side's index and only rereads it when needed.
+ *  SegmentedQueue<T>  unbounded MPMC queue: a linked list of fixed-size segments, where
+ *                     producers and consumers claim cells with one fetch-and-add each
+ *                     (the FAA array queue of Ramalhete and Correia).
+ *  WorkBag<T>         unordered bag: one Chase-Lev deque per thread; a thread adds and
+ *                     takes at the bottom of its own deque and steals from the top of
+ *                     the others' when its own is empty.
+ *
+ * Memory that a concurrent operation may still read (used segments, outgrown deque
+ * arrays) is freed through EpochReclaimer.
+ */
+
+#define LF_SEGMENT 1024      /* cells per segment of SegmentedQueue */
+
+/*
+ * Epoch-based reclamation. A thread announces the global epoch on entering an operation
+ * and clears its flag on leaving. The epoch only advances once every active thread has
+ * announced it, so anything retired in epoch e can no longer be seen by any operation
+ * once the global epoch reaches e + 3.
+ */
+class EpochReclaimer {
+public:
+    explicit EpochReclaimer(int nthreads) : n(nthreads), local(new Local[nthreads]) {}
+
+    ~EpochReclaimer() {
+        for (int t = 0; t < n; t++)
+            for (auto &r : local[t].retired)
+                r.free(r.p);
+    }
+
+    /* The announcement is (epoch << 1) | active in one word, so entering costs a single
+       exchange. A stale epoch only holds the global one back, which is safe. */
+    void enter(int t) {
+        unsigned long e = global.load(std::memory_order_acquire);
+        local[t].state.exchange((e << 1) | 1, std::memory_order_seq_cst);
+    }
+
+    void leave(int t) {
+        local[t].state.store(local[t].state.load(std::memory_order_relaxed) & ~1UL,
+                             std::memory_order_release);
+    }
+
+    /* Free p with `free` once no operation can still reach it */
+    void retire(int t, void *p, void (*free)(void *)) {
+        Local &me = local[t];
+        me.retired.push_back({p, free, global.load(std::memory_order_acquire)});
+        if (me.retired.size() % 64 == 0)
+            collect(t);
+    }
+
+private:
+    struct Retired {
+        void *p;
+        void (*free)(void *);
+        unsigned long epoch;
+    };
+    struct alignas(64) Local {
+        std::atomic<unsigned long> state{0};
+        std::vector<Retired> retired;
+    };
+    int n;
+    std::unique_ptr<Local[]> local;
+    alignas(64) std::atomic<unsigned long> global{0};
+
+    void collect(int t) {
+        unsigned long e = global.load(std::memory_order_seq_cst);
+        bool all = true;
+        for (int i = 0; i < n && all; i++) {
+            unsigned long s = local[i].state.load(std::memory_order_seq_cst);
+            if ((s & 1) && (s >> 1) != e)
+                all = false;
+        }
+        if (all)
+            global.compare_exchange_strong(e, e + 1);
+
+        e = global.load(std::memory_order_acquire);
+        std::vector<Retired> &r = local[t].retired;
+        size_t keep = 0;
+        for (size_t i = 0; i < r.size(); i++) {
+            if (r[i].epoch + 3 <= e)
+                r[i].free(r[i].p);
+            else
+                r[keep++] = r[i];
+        }
+        r.resize(keep);
+    }
+};
+
+template <typename T>
+class BoundedQueue {
+public:
+    /* capacity is rounded up to a power of two */
+    explicit BoundedQueue(size_t capacity) {
+        size_t c = 2;
+        while (c < capacity)
+            c *= 2;
+        mask = c - 1;
+        cells.reset(new Cell[c]);
+        for (size_t i = 0; i < c; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    /* false if the queue is full */
+    bool push(const T &v) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            long dif = (long)seq - (long)pos;
+            if (dif == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        c->value = v;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* false if the queue is empty */
+    bool pop(T &v) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            long dif = (long)seq - (long)(pos + 1);
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        v = c->value;
+        c->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+    size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> head{0};
+};
+
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t c = 2;
+        while (c < capacity)
+            c *= 2;
+        mask = c - 1;
+        buf.reset(new T[c]);
+    }
+
+    bool push(const T &v) {                     /* producer only */
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache > mask) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache > mask)
+                return false;
+        }
+        buf[t & mask] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &v) {                            /* consumer only */
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache)
+                return false;
+        }
+        v = buf[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    size_t mask;
+    std::unique_ptr<T[]> buf;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t head_cache = 0;                      /* producer's view of head */
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tail_cache = 0;                      /* consumer's view of tail */
+};
+
+template <typename T>
+class SegmentedQueue {
+public:
+    explicit SegmentedQueue(int nthreads) : rec(nthreads) {
+        Segment *s = new Segment;
+        head.store(s, std::memory_order_relaxed);
+        tail.store(s, std::memory_order_relaxed);
+    }
+
+    ~SegmentedQueue() {
+        for (Segment *s = head.load(); s != nullptr;) {
+            Segment *next = s->next.load();
+            delete s;
+            s = next;
+        }
+    }
+
+    void push(int tid, const T &v) {
+        rec.enter(tid);
+        for (;;) {
+            Segment *t = tail.load(std::memory_order_acquire);
+            long i = t->enqidx.fetch_add(1, std::memory_order_acq_rel);
+            if (i < LF_SEGMENT) {
+                Cell &c = t->cells[i];
+                c.value = v;
+                int empty = EMPTY;
+                if (c.state.compare_exchange_strong(empty, FULL, std::memory_order_release,
+                                                    std::memory_order_relaxed))
+                    break;
+                continue;                       /* a consumer gave up on this cell */
+            }
+            /* Segment full: help move tail along, or append a new segment */
+            if (t != tail.load(std::memory_order_acquire))
+                continue;
+            Segment *next = t->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                tail.compare_exchange_strong(t, next);
+                continue;
+            }
+            Segment *s = new Segment;
+            s->enqidx.store(1, std::memory_order_relaxed);
+            s->cells[0].value = v;
+            s->cells[0].state.store(FULL, std::memory_order_relaxed);
+            Segment *null = nullptr;
+            if (t->next.compare_exchange_strong(null, s, std::memory_order_release)) {
+                tail.compare_exchange_strong(t, s);
+                break;
+            }
+            delete s;
+        }
+        rec.leave(tid);
+    }
+
+    /* false if the queue was empty */
+    bool pop(int tid, T &v) {
+        rec.enter(tid);
+        bool found = false;
+        for (;;) {
+            Segment *h = head.load(std::memory_order_acquire);
+            if (h->deqidx.load(std::memory_order_acquire) >= h->enqidx.load(std::memory_order_acquire) &&
+                h->next.load(std::memory_order_acquire) == nullptr)
+                break;
+            long i = h->deqidx.fetch_add(1, std::memory_order_acq_rel);
+            if (i >= LF_SEGMENT) {
+                Segment *next = h->next.load(std::memory_order_acquire);
+                if (next == nullptr)
+                    break;
+                if (head.compare_exchange_strong(h, next))
+                    rec.retire(tid, h, [](void *p) { delete (Segment *)p; });
+                continue;
+            }
+            Cell &c = h->cells[i];
+            if (c.state.exchange(TAKEN, std::memory_order_acq_rel) == FULL) {
+                v = c.value;
+                found = true;
+                break;
+            }
+            /* the producer of this cell has not written it yet; it will retry elsewhere */
+        }
+        rec.leave(tid);
+        return found;
+    }
+
+private:
+    enum { EMPTY, FULL, TAKEN };
+    struct Cell {
+        std::atomic<int> state{EMPTY};
+        T value;
+    };
+    struct Segment {
+        alignas(64) std::atomic<long> enqidx{0};
+        alignas(64) std::atomic<long> deqidx{0};
+        alignas(64) std::atomic<Segment *> next{nullptr};
+        Cell cells[LF_SEGMENT];
+    };
+    EpochReclaimer rec;
+    alignas(64) std::atomic<Segment *> head;
+    alignas(64) std::atomic<Segment *> tail;
+};
+
+template <typename T>
+class WorkBag {
+public:
+    explicit WorkBag(int nthreads, long initial = 1024)
+        : n(nthreads), rec(nthreads), deques(new Deque[nthreads]) {
+        for (int t = 0; t < n; t++)
+            deques[t].array.store(new Array(initial), std::memory_order_relaxed);
+    }
+
+    ~WorkBag() {
+        for (int t = 0; t < n; t++)
+            delete deques[t].array.load();
+    }
+
+    /* Add to the calling thread's own deque */
+    void add(int tid, const T &v) {
+        Deque &d = deques[tid];
+        long b = d.bottom.load(std::memory_order_relaxed);
+        long t = d.top.load(std::memory_order_acquire);
+        Array *a = d.array.load(std::memory_order_relaxed);
+        if (b - t > a->size - 1) {              /* full: double the array */
+            Array *bigger = new Array(2 * a->size);
+            for (long i = t; i < b; i++)
+                bigger->put(i, a->get(i));
+            d.array.store(bigger, std::memory_order_release);
+            rec.retire(tid, a, [](void *p) { delete (Array *)p; });
+            a = bigger;
+        }
+        a->put(b, v);
+        std::atomic_thread_fence(std::memory_order_release);
+        d.bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /* Take from the own deque, else steal from the others; false if all looked empty */
+    bool take(int tid, T &v) {
+        if (take_own(deques[tid], v))
+            return true;
+        rec.enter(tid);
+        bool found = false;
+        for (int k = 1; k < n && !found; k++)
+            found = steal(deques[(tid + k) % n], v);
+        rec.leave(tid);
+        return found;
+    }
+
+private:
+    struct Array {
+        long size;
+        std::unique_ptr<std::atomic<T>[]> a;
+        explicit Array(long s) : size(s), a(new std::atomic<T>[s]) {}
+        T get(long i) const { return a[i & (size - 1)].load(std::memory_order_relaxed); }
+        void put(long i, const T &v) { a[i & (size - 1)].store(v, std::memory_order_relaxed); }
+    };
+    struct alignas(64) Deque {
+        std::atomic<long> top{0};
+        alignas(64) std::atomic<long> bottom{0};
+        std::atomic<Array *> array{nullptr};
+    };
+    int n;
+    EpochReclaimer rec;
+    std::unique_ptr<Deque[]> deques;
+
+    /* Chase-Lev take, in the C11 formulation of Le et al. (PPoPP 2013) */
+    bool take_own(Deque &d, T &v) {
+        long b = d.bottom.load(std::memory_order_relaxed) - 1;
+        Array *a = d.array.load(std::memory_order_relaxed);
+        d.bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = d.top.load(std::memory_order_relaxed);
+        if (t > b) {
+            d.bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        v = a->get(b);
+        if (t == b) {                           /* last element: race the thieves for it */
+            bool won = d.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed);
+            d.bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool steal(Deque &d, T &v) {
+        long t = d.top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long b = d.bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        Array *a = d.array.load(std::memory_order_acquire);
+        v = a->get(t);
+        return d.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed);
+    }
+};
+
+#endif
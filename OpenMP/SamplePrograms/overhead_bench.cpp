@@ -0,0 +1,315 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+
+using namespace std;
+
+#define DELAY_US    0.10   // Length of the busy-wait delay inside each construct
+#define TARGET_US   1000   // Inner repetitions are raised until one test takes this long
+#define OUTER_REPS  20     // Default timed repetitions of every test
+#define SCHED_ITERS 1024   // Loop iterations per thread in the scheduling tests
+
+/*
+ * Overheads of OpenMP constructs, measured the way the EPCC microbenchmarks do it. Each
+ * test repeats a construct around a fixed delay `reps` times. The overhead per
+ * repetition is the test time over `reps`, minus the time one thread needs for the same
+ * delay alone. `reps` is doubled until a test takes TARGET_US. The reported figure is
+ * the mean, and the standard deviation, over `outer` tests.
+ */
+
+int delay_length;
+
+void delay(int length) {
+    float a = 0.0f;
+    for (int i = 0; i < length; i++)
+        a += i;
+    if (a < 0)
+        printf("%f\n", a);
+}
+
+double delay_us(int length, long reps) {
+    double t = omp_get_wtime();
+    for (long r = 0; r < reps; r++)
+        delay(length);
+    return (omp_get_wtime() - t) / reps * 1e6;
+}
+
+// Smallest delay length that takes at least DELAY_US
+int calibrate_delay() {
+    int length = 1;
+    while (delay_us(length, 10000) < DELAY_US)
+        length *= 2;
+    int lo = length / 2, hi = length;
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if (delay_us(mid, 10000) < DELAY_US)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return hi;
+}
+
+struct Stat {
+    double mean, sd;
+};
+
+/* Overhead in microseconds per repetition of test(reps), given the reference time per
+   repetition. reps stays a multiple of p, so tests may split it evenly over a team. */
+template <typename Test>
+Stat measure(int p, int outer, double ref_us, Test test) {
+    long reps = p;
+    for (;;) {
+        double t = omp_get_wtime();
+        test(reps);
+        if ((omp_get_wtime() - t) * 1e6 >= TARGET_US)
+            break;
+        reps *= 2;
+    }
+    vector<double> o(outer);
+    for (int k = 0; k < outer; k++) {
+        double t = omp_get_wtime();
+        test(reps);
+        o[k] = (omp_get_wtime() - t) / reps * 1e6 - ref_us;
+    }
+    Stat s = {0.0, 0.0};
+    for (double x : o)
+        s.mean += x / outer;
+    for (double x : o)
+        s.sd += (x - s.mean) * (x - s.mean) / outer;
+    s.sd = sqrt(s.sd);
+    return s;
+}
+
+enum { PARALLEL, FOR, PARALLEL_FOR, BARRIER, SINGLE, CRITICAL, LOCK, ATOMIC, REDUCTION,
+       ORDERED, TASK_ALL, TASK_MASTER, TASKWAIT, NTESTS };
+const char *test_names[NTESTS] = {"parallel", "for", "parallel for", "barrier", "single",
+                                  "critical", "lock/unlock", "atomic", "reduction",
+                                  "ordered", "task (all spawn)", "task (one spawns)",
+                                  "task + taskwait"};
+
+Stat run(int test, int p, int outer, double ref) {
+    int dl = delay_length;
+    switch (test) {
+    case PARALLEL:
+        return measure(p, outer, ref, [=](long reps) {
+            for (long j = 0; j < reps; j++) {
+                #pragma omp parallel num_threads(p)
+                delay(dl);
+            }
+        });
+    case FOR:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                #pragma omp for
+                for (int i = 0; i < p; i++)
+                    delay(dl);
+            }
+        });
+    case PARALLEL_FOR:
+        return measure(p, outer, ref, [=](long reps) {
+            for (long j = 0; j < reps; j++) {
+                #pragma omp parallel for num_threads(p)
+                for (int i = 0; i < p; i++)
+                    delay(dl);
+            }
+        });
+    case BARRIER:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                delay(dl);
+                #pragma omp barrier
+            }
+        });
+    case SINGLE:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                #pragma omp single
+                delay(dl);
+            }
+        });
+    // The team shares `reps` critical sections, which run one at a time
+    case CRITICAL:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps / p; j++) {
+                #pragma omp critical
+                delay(dl);
+            }
+        });
+    case LOCK: {
+        omp_lock_t lock;
+        omp_init_lock(&lock);
+        Stat s = measure(p, outer, ref, [=, &lock](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps / p; j++) {
+                omp_set_lock(&lock);
+                delay(dl);
+                omp_unset_lock(&lock);
+            }
+        });
+        omp_destroy_lock(&lock);
+        return s;
+    }
+    // No delay: the cost of one atomic update while the whole team updates the same word
+    case ATOMIC: {
+        double x = 0.0;
+        return measure(p, outer, 0.0, [=, &x](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps / p; j++) {
+                #pragma omp atomic
+                x += 1.0;
+            }
+        });
+    }
+    case REDUCTION:
+        return measure(p, outer, ref, [=](long reps) {
+            int x = 0;
+            for (long j = 0; j < reps; j++) {
+                #pragma omp parallel reduction(+:x) num_threads(p)
+                {
+                    delay(dl);
+                    x += 1;
+                }
+            }
+            if (x < 0)
+                printf("%d\n", x);
+        });
+    case ORDERED:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            {
+                #pragma omp for schedule(static, 1) ordered
+                for (long j = 0; j < reps; j++) {
+                    #pragma omp ordered
+                    delay(dl);
+                }
+            }
+        });
+    // Every thread spawns `reps` tasks, so the team runs p * reps delays
+    case TASK_ALL:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                #pragma omp task
+                delay(dl);
+            }
+        });
+    case TASK_MASTER:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            #pragma omp master
+            for (long j = 0; j < reps * p; j++) {
+                #pragma omp task
+                delay(dl);
+            }
+        });
+    default:
+        return measure(p, outer, ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                #pragma omp task
+                delay(dl);
+                #pragma omp taskwait
+            }
+        });
+    }
+}
+
+enum { STATIC, DYNAMIC, GUIDED, NSCHEDS };
+const char *sched_names[NSCHEDS] = {"static", "dynamic", "guided"};
+
+// Overhead of one work-shared loop of SCHED_ITERS delays per thread
+Stat run_sched(int sched, int chunk, int p, int outer, double ref) {
+    int dl = delay_length;
+    long iters = (long)SCHED_ITERS * p;
+    double loop_ref = ref * SCHED_ITERS;
+    switch (sched) {
+    case STATIC:
+        return measure(p, outer, loop_ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                #pragma omp for schedule(static, chunk)
+                for (long i = 0; i < iters; i++)
+                    delay(dl);
+            }
+        });
+    case DYNAMIC:
+        return measure(p, outer, loop_ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                #pragma omp for schedule(dynamic, chunk)
+                for (long i = 0; i < iters; i++)
+                    delay(dl);
+            }
+        });
+    default:
+        return measure(p, outer, loop_ref, [=](long reps) {
+            #pragma omp parallel num_threads(p)
+            for (long j = 0; j < reps; j++) {
+                #pragma omp for schedule(guided, chunk)
+                for (long i = 0; i < iters; i++)
+                    delay(dl);
+            }
+        });
+    }
+}
+
+void print(Stat s) {
+    char cell[32];
+    snprintf(cell, sizeof(cell), "%.3f (%.3f)", s.mean, s.sd);
+    printf("  %18s", cell);
+}
+
+int main(int argc, char *argv[]) {
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : omp_get_num_procs();
+    int outer = (argc > 2) ? atoi(argv[2]) : OUTER_REPS;
+    vector<int> counts;
+
+    omp_set_dynamic(0);
+    for (int p = 1; p < maxThreads; p *= 2)
+        counts.push_back(p);
+    counts.push_back(maxThreads);
+
+    delay_length = calibrate_delay();
+    double ref = delay_us(delay_length, 100000);
+
+    printf("\n  Number of processors available = %d\n", omp_get_num_procs());
+    printf("  Delay: %d iterations = %.3f us; mean (standard deviation) of %d tests\n",
+           delay_length, ref, outer);
+    if (maxThreads > omp_get_num_procs())
+        printf("  More threads than processors: the threads take turns, so the times include"
+               " the delays of the other threads\n");
+
+    printf("\n  Overhead in microseconds per construct\n\n  %-18s", "construct");
+    for (int p : counts)
+        printf("  %14d thr", p);
+    printf("\n");
+    for (int k = 0; k < NTESTS; k++) {
+        printf("  %-18s", test_names[k]);
+        for (int p : counts)
+            print(run(k, p, outer, ref));
+        printf("\n");
+    }
+
+    /* Scheduling overhead per loop on the whole team; the per-chunk cost is this
+       divided by the SCHED_ITERS / chunk chunks every thread runs */
+    int p = maxThreads;
+    printf("\n  Scheduling overhead in microseconds per loop of %d iterations per thread,"
+           " %d threads\n\n  %-18s", SCHED_ITERS, p, "chunk");
+    for (int s = 0; s < NSCHEDS; s++)
+        printf("  %18s", sched_names[s]);
+    printf("\n");
+    for (int chunk = 1; chunk <= 128; chunk *= 2) {
+        printf("  %-18d", chunk);
+        for (int s = 0; s < NSCHEDS; s++)
+            print(run_sched(s, chunk, p, outer, ref));
+        printf("\n");
+    }
+    return 0;
+}
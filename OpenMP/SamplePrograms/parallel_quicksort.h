@@ -0,0 +1,212 @@
+#ifndef PARALLEL_QUICKSORT_H
+#define PARALLEL_QUICKSORT_H
+
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <utility>
+
+/*
+ * An in-place parallel introsort, for when merge_sort.cpp's n-element tmp buffer does
+ * not fit. It needs O(log n) stack per thread and nothing else.
+ *
+ *   parallel_quicksort(x, n);      call outside a parallel region, or from one thread
+ *                                  or task inside one
+ *
+ *  - Partitioning is branchless: every element is swapped unconditionally and the
+ *    comparison only moves the boundary, so random keys cause no mispredictions.
+ *  - A large range is partitioned by all threads. Each partitions a block of it on its
+ *    own, and then the elements on the wrong side of the final boundary are swapped
+ *    across it in parallel.
+ *  - The smaller side of every split becomes a task; the thread keeps the larger one.
+ *  - When the pivot samples contain the pivot twice, the range is split three ways and
+ *    the keys equal to the pivot are finished at once, so inputs with few distinct
+ *    keys, like fillupRandomly(..., 0, 5), take a few passes rather than a deep
+ *    recursion.
+ *  - A range that needs more than 2 log2(n) levels of splitting is heap sorted, which
+ *    bounds the worst case at O(n log n).
+ */
+
+#define PQ_INSERTION   24          /* Ranges of at most this many elements use insertion sort */
+#define PQ_TASK        (1 << 14)   /* Smallest side of a split that becomes a task */
+#define PQ_BLOCK       (1 << 18)   /* Elements per block of a parallel partition */
+#define PQ_MAX_BLOCKS  256
+
+/* Moves the elements for which left() holds to the front; returns how many there are */
+template <typename T, typename Left>
+long pq_partition(T *x, long n, Left left) {
+    long m = 0;
+    for (long j = 0; j < n; j++) {
+        T v = x[j];
+        bool c = left(v);
+        x[j] = x[m];
+        x[m] = v;
+        m += c;
+    }
+    return m;
+}
+
+/* pq_partition by up to `blocks` tasks */
+template <typename T, typename Left>
+long pq_partition_parallel(T *x, long n, Left left, int blocks) {
+    long mid[PQ_MAX_BLOCKS];
+    for (int b = 0; b < blocks; b++) {
+        #pragma omp task shared(mid)
+        {
+            long lo = n * b / blocks, hi = n * (b + 1) / blocks;
+            mid[b] = lo + pq_partition(x + lo, hi - lo, left);
+        }
+    }
+    #pragma omp taskwait
+
+    /* Block b ends up as [lo, mid) left and [mid, hi) right. Right elements below the
+       final boundary m, and left elements above it, form at most one run per block. */
+    long m = 0;
+    for (int b = 0; b < blocks; b++)
+        m += mid[b] - n * b / blocks;
+    long rstart[PQ_MAX_BLOCKS], rlen[PQ_MAX_BLOCKS], lstart[PQ_MAX_BLOCKS], llen[PQ_MAX_BLOCKS];
+    long misplaced = 0;
+    for (int b = 0; b < blocks; b++) {
+        long lo = n * b / blocks, hi = n * (b + 1) / blocks;
+        rstart[b] = mid[b];
+        rlen[b] = std::max(0L, std::min(hi, m) - mid[b]);
+        lstart[b] = std::max(lo, m);
+        llen[b] = std::max(0L, mid[b] - lstart[b]);
+        misplaced += rlen[b];
+    }
+
+    /* Task t swaps the misplaced pairs [k0, k1) of the two lists of runs */
+    for (int t = 0; t < blocks; t++) {
+        #pragma omp task shared(rstart, rlen, lstart, llen)
+        {
+            long k0 = misplaced * t / blocks, k1 = misplaced * (t + 1) / blocks;
+            int r = 0, l = 0;
+            long kr = k0, kl = k0;
+            while (r < blocks && kr >= rlen[r])
+                kr -= rlen[r++];
+            while (l < blocks && kl >= llen[l])
+                kl -= llen[l++];
+            for (long k = k0; k < k1; k++) {
+                while (kr == rlen[r]) {
+                    r++;
+                    kr = 0;
+                }
+                while (kl == llen[l]) {
+                    l++;
+                    kl = 0;
+                }
+                std::swap(x[rstart[r] + kr++], x[lstart[l] + kl++]);
+            }
+        }
+    }
+    #pragma omp taskwait
+    return m;
+}
+
+template <typename T, typename Left>
+long pq_split(T *x, long n, Left left) {
+    long blocks = std::min<long>(std::min<long>(omp_get_num_threads(), n / PQ_BLOCK), PQ_MAX_BLOCKS);
+    if (blocks < 2)
+        return pq_partition(x, n, left);
+    return pq_partition_parallel(x, n, left, (int)blocks);
+}
+
+template <typename T>
+void pq_insertion_sort(T *x, long n) {
+    for (long i = 1; i < n; i++) {
+        T v = x[i];
+        long j = i;
+        for (; j > 0 && v < x[j - 1]; j--)
+            x[j] = x[j - 1];
+        x[j] = v;
+    }
+}
+
+/* Index of the median of x[i], x[j], x[k] */
+template <typename T>
+long pq_median3(const T *x, long i, long j, long k) {
+    if (x[j] < x[i])
+        std::swap(i, j);
+    if (x[k] < x[j])
+        j = (x[k] < x[i]) ? i : k;
+    return j;
+}
+
+/* Splits x around a sampled pivot: afterwards [0, a) < pivot, [a, b) == pivot and
+   [b, n) >= pivot, with a < b */
+template <typename T>
+void pq_pivot_split(T *x, long n, long &a, long &b) {
+    /* The median of 3 samples, or for large ranges the median of 3 medians of 3 */
+    long s[9] = {0, n / 2, n - 1};
+    int ns = 3;
+    long p = pq_median3(x, s[0], s[1], s[2]);
+    if (n > 1024) {
+        long d = n / 8;
+        long more[9] = {0, d, 2 * d, 3 * d, 4 * d, 5 * d, 6 * d, 7 * d, n - 1};
+        std::copy(more, more + 9, s);
+        ns = 9;
+        p = pq_median3(x, pq_median3(x, s[0], s[1], s[2]), pq_median3(x, s[3], s[4], s[5]),
+                       pq_median3(x, s[6], s[7], s[8]));
+    }
+    T pivot = x[p];
+    int equal = 0;
+    for (int i = 0; i < ns; i++)
+        equal += !(x[s[i]] < pivot) && !(pivot < x[s[i]]);
+
+    if (equal > 1) {
+        /* < pivot, == pivot, > pivot */
+        a = pq_split(x, n, [pivot](const T &v) { return v < pivot; });
+        b = a + pq_split(x + a, n - a, [pivot](const T &v) { return !(pivot < v); });
+    } else {
+        /* < pivot, then the pivot itself, then >= pivot */
+        std::swap(x[p], x[n - 1]);
+        a = pq_split(x, n - 1, [pivot](const T &v) { return v < pivot; });
+        std::swap(x[a], x[n - 1]);
+        b = a + 1;
+    }
+}
+
+template <typename T>
+void pq_sort(T *x, long n, int depth) {
+    while (n > PQ_INSERTION) {
+        if (depth-- == 0) {
+            std::make_heap(x, x + n);
+            std::sort_heap(x, x + n);
+            return;
+        }
+        long a, b;
+        pq_pivot_split(x, n, a, b);
+
+        /* Hand the smaller side to a task, or recurse on it, and loop on the larger */
+        T *small = x, *large = x + b;
+        long nsmall = a, nlarge = n - b;
+        if (nsmall > nlarge) {
+            std::swap(small, large);
+            std::swap(nsmall, nlarge);
+        }
+        if (nsmall > PQ_TASK) {
+            #pragma omp task
+            pq_sort(small, nsmall, depth);
+        } else {
+            pq_sort(small, nsmall, depth);
+        }
+        x = large;
+        n = nlarge;
+    }
+    pq_insertion_sort(x, n);
+}
+
+template <typename T>
+void parallel_quicksort(T *x, long n) {
+    int depth = n > 1 ? 2 * (int)log2((double)n) : 0;
+    if (omp_in_parallel()) {
+        #pragma omp taskgroup
+        pq_sort(x, n, depth);
+    } else {
+        #pragma omp parallel
+        #pragma omp single
+        pq_sort(x, n, depth);
+    }
+}
+
+#endif
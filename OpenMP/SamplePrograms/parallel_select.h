@@ -0,0 +1,212 @@
+#ifndef PARALLEL_SELECT_H
+#define PARALLEL_SELECT_H
+
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "parallel_quicksort.h"
+
+/*
+ * Selection without sorting everything, on top of the partitioning of
+ * parallel_quicksort.h.
+ *
+ *   parallel_nth_element(x, n, k);    x[k] is the element a full sort would put there,
+ *                                     nothing before it is larger, nothing after smaller
+ *   parallel_partial_sort(x, n, k);   x[0, k) holds the k smallest elements, sorted, and
+ *                                     x[k, n) the others
+ *   parallel_top_k(x, n, k, out);     out[0, k) gets the k largest elements of x, largest
+ *                                     first; x is only read
+ *
+ * The first two call outside a parallel region, or from one thread or task inside one.
+ *
+ * parallel_nth_element follows Floyd and Rivest. It sorts a sample of about n^(2/3)
+ * elements and takes two keys from it that bracket position k with a margin of three
+ * standard deviations. One parallel three-way partition around the two keys leaves k
+ * almost always in the middle part, which holds a few percent of the range, and the
+ * selection continues there. Ranges of at most PS_SERIAL elements finish with a serial
+ * introselect: quickselect with the pivot and three-way splits of pq_pivot_split, and a
+ * heap sort after 2 log2(n) levels.
+ *
+ * parallel_top_k streams over x once. Every thread keeps the k largest elements of its
+ * share in a min-heap, whose top decides in one comparison whether a new element
+ * matters, and the heaps are merged at the end. parallel_partial_sort does the same for
+ * a small k, then finds the chosen elements in a second pass that only reads, and moves
+ * just the k elements concerned; a larger k uses parallel_nth_element and sorts the front.
+ */
+
+#define PS_SERIAL      (1 << 16)   /* Ranges of at most this many elements use one thread */
+#define PS_MAX_SAMPLE  (1 << 18)
+#define PS_HEAP_K      1024        /* Partial sorts of up to n / PS_HEAP_K elements use heaps */
+
+template <typename T>
+void ps_select_serial(T *x, long n, long k) {
+    int depth = n > 1 ? 2 * (int)log2((double)n) : 0;
+    while (n > PQ_INSERTION) {
+        if (depth-- == 0) {
+            std::make_heap(x, x + n);
+            std::sort_heap(x, x + n);
+            return;
+        }
+        long a, b;
+        pq_pivot_split(x, n, a, b);
+        if (k < a) {
+            n = a;
+        } else if (k >= b) {
+            x += b;
+            k -= b;
+            n -= b;
+        } else {
+            return;
+        }
+    }
+    pq_insertion_sort(x, n);
+}
+
+template <typename T>
+void ps_select(T *x, long n, long k) {
+    unsigned seed = 12345;
+    while (n > PS_SERIAL) {
+        /* Two keys around the sample's estimate of the k-th element */
+        long s = std::min<long>((long)pow((double)n, 2.0 / 3.0), PS_MAX_SAMPLE);
+        std::vector<T> sample(s);
+        for (long i = 0; i < s; i++) {
+            seed = seed * 1103515245u + 12345u;
+            sample[i] = x[(long)((double)seed / 4294967296.0 * n)];
+        }
+        std::sort(sample.begin(), sample.end());
+        long r = (long)((double)k * s / n), margin = (long)(3.0 * sqrt((double)s));
+        T lo = sample[std::max(0L, r - margin)], hi = sample[std::min(s - 1, r + margin)];
+
+        /* < lo, [lo, hi], > hi. The outer parts are never the whole range, but the
+           middle one is when few keys remain; the serial three-way splits take over then. */
+        long a = pq_split(x, n, [lo](const T &v) { return v < lo; });
+        if (k < a) {
+            n = a;
+            continue;
+        }
+        long b = a + pq_split(x + a, n - a, [hi](const T &v) { return !(hi < v); });
+        if (k >= b) {
+            x += b;
+            k -= b;
+            n -= b;
+            continue;
+        }
+        if (!(lo < hi))
+            return;
+        if (b - a == n)
+            break;
+        x += a;
+        k -= a;
+        n = b - a;
+    }
+    ps_select_serial(x, n, k);
+}
+
+template <typename T>
+void parallel_nth_element(T *x, long n, long k) {
+    if (k < 0 || k >= n)
+        return;
+    if (omp_in_parallel()) {
+        #pragma omp taskgroup
+        ps_select(x, n, k);
+    } else {
+        #pragma omp parallel
+        #pragma omp single
+        ps_select(x, n, k);
+    }
+}
+
+/* The k elements of x that come first under before(), in that order. Every thread keeps
+   the best k of its share in a heap with the worst on top. */
+template <typename T, typename Before>
+void ps_heap_select(const T *x, long n, long k, Before before, std::vector<T> &best) {
+    best.clear();
+    #pragma omp parallel
+    {
+        std::vector<T> heap;
+        heap.reserve(k);
+        #pragma omp for schedule(static) nowait
+        for (long i = 0; i < n; i++) {
+            if ((long)heap.size() < k) {
+                heap.push_back(x[i]);
+                std::push_heap(heap.begin(), heap.end(), before);
+            } else if (before(x[i], heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), before);
+                heap.back() = x[i];
+                std::push_heap(heap.begin(), heap.end(), before);
+            }
+        }
+        #pragma omp critical
+        best.insert(best.end(), heap.begin(), heap.end());
+    }
+    std::nth_element(best.begin(), best.begin() + (k - 1), best.end(), before);
+    best.resize(k);
+    std::sort(best.begin(), best.end(), before);
+}
+
+template <typename T>
+void parallel_partial_sort(T *x, long n, long k) {
+    k = std::min(k, n);
+    if (k <= 0)
+        return;
+    if (k > n / PS_HEAP_K || omp_in_parallel()) {
+        if (k < n)
+            parallel_nth_element(x, n, k);
+        parallel_quicksort(x, k);
+        return;
+    }
+
+    /* A few k: find the k smallest values with heaps, which only reads x. The selected
+       positions are those below the largest value t, and the first `ties` equal to it. */
+    std::vector<T> best;
+    ps_heap_select(x, n, k, std::less<T>(), best);
+    T t = best[k - 1];
+    long ties = best.end() - std::lower_bound(best.begin(), best.end(), t);
+    int p = omp_get_max_threads();
+    std::vector<std::vector<long>> below(p), equal(p);
+    #pragma omp parallel num_threads(p)
+    {
+        int id = omp_get_thread_num();
+        #pragma omp for schedule(static)
+        for (long i = 0; i < n; i++) {
+            if (x[i] < t)
+                below[id].push_back(i);
+            else if ((long)equal[id].size() < ties && !(t < x[i]))
+                equal[id].push_back(i);
+        }
+    }
+    std::vector<char> taken(k, 0);
+    std::vector<long> outside;
+    for (int id = 0; id < p; id++) {
+        for (long i : below[id])
+            (i < k) ? (void)(taken[i] = 1) : outside.push_back(i);
+        for (long i : equal[id]) {
+            if (ties == 0)
+                break;
+            ties--;
+            (i < k) ? (void)(taken[i] = 1) : outside.push_back(i);
+        }
+    }
+
+    /* Move the unselected elements of [0, k) to where selected ones were, then write the
+       selected values in order over [0, k) */
+    long j = 0;
+    for (long i = 0; i < k; i++)
+        if (!taken[i])
+            x[outside[j++]] = x[i];
+    std::copy(best.begin(), best.end(), x);
+}
+
+template <typename T>
+void parallel_top_k(const T *x, long n, long k, T *out) {
+    k = std::min(k, n);
+    if (k <= 0)
+        return;
+    std::vector<T> best;
+    ps_heap_select(x, n, k, std::greater<T>(), best);
+    std::copy(best.begin(), best.end(), out);
+}
+
+#endif
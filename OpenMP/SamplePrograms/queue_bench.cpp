@@ -0,0 +1,297 @@
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <omp.h>
+#include "lockfree.h"
+
+using namespace std;
+
+#define ITEMS      (1L << 21)  // Default items passed through each queue
+#define QUEUE_CAP  1024        // Capacity of the bounded rings
+#define BURST      16          // Items a bag thread takes per round
+#define DONE       -1L         // Sentinel that tells a consumer to stop
+
+enum { MUTEX, CRITICAL, BOUNDED, SEGMENTED, SPSC, NQUEUES };
+const char *queue_names[NQUEUES] = {"mutex", "omp critical", "bounded", "segmented", "spsc"};
+enum { BAG_MUTEX, BAG_CRITICAL, BAG_LOCKFREE, NBAGS };
+const char *bag_names[NBAGS] = {"mutex", "omp critical", "work bag"};
+
+// std::deque behind a lock, the way a pipeline would be written without this library
+struct MutexQueue {
+    mutex m;
+    deque<long> q;
+    bool push(int, long v) { lock_guard<mutex> g(m); q.push_back(v); return true; }
+    bool pop(int, long &v) {
+        lock_guard<mutex> g(m);
+        if (q.empty())
+            return false;
+        v = q.front();
+        q.pop_front();
+        return true;
+    }
+};
+
+struct CriticalQueue {
+    deque<long> q;
+    bool push(int, long v) {
+        #pragma omp critical(queue)
+        q.push_back(v);
+        return true;
+    }
+    bool pop(int, long &v) {
+        bool found = false;
+        #pragma omp critical(queue)
+        if (!q.empty()) {
+            v = q.front();
+            q.pop_front();
+            found = true;
+        }
+        return found;
+    }
+};
+
+// The lock-free queues with the thread id argument the benchmark passes to all of them
+struct Bounded {
+    BoundedQueue<long> q{QUEUE_CAP};
+    bool push(int, long v) { return q.push(v); }
+    bool pop(int, long &v) { return q.pop(v); }
+};
+
+struct Segmented {
+    SegmentedQueue<long> q;
+    explicit Segmented(int p) : q(p) {}
+    bool push(int t, long v) { q.push(t, v); return true; }
+    bool pop(int t, long &v) { return q.pop(t, v); }
+};
+
+struct Spsc {
+    SpscQueue<long> q{QUEUE_CAP};
+    bool push(int, long v) { return q.push(v); }
+    bool pop(int, long &v) { return q.pop(v); }
+};
+
+/* One count per item, raised by whoever receives it, to check that every item arrived
+   exactly once; a sum of the items would miss one lost and another duplicated */
+struct Seen {
+    vector<atomic<unsigned char>> marks;
+    explicit Seen(long n) : marks(n) {}
+    bool mark(long v) {
+        if (v < 0 || v >= (long)marks.size())
+            return false;
+        marks[v].fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+    /* Items marked once; -1 if any was marked more often */
+    long once() const {
+        long n = 0;
+        for (const atomic<unsigned char> &m : marks) {
+            unsigned char c = m.load(memory_order_relaxed);
+            if (c > 1)
+                return -1;
+            n += c;
+        }
+        return n;
+    }
+};
+
+/* Millions of items per second through q. The first p/2 threads produce, the rest
+   consume; the last producer to finish sends one DONE per consumer, which arrive after
+   every item because the queues are FIFO. One thread alternates push and pop. */
+template <typename Q>
+double time_queue(Q &q, int p, long items, bool &ok) {
+    atomic<int> finished(0);
+    atomic<bool> in_range(true);
+    Seen seen(items);
+    double t = 0.0;
+    #pragma omp parallel num_threads(p)
+    {
+        int tid = omp_get_thread_num();
+        int producers = p / 2, consumers = p - p / 2;
+        long v = 0;
+        bool good = true;
+        #pragma omp barrier
+        double t0 = omp_get_wtime();
+        if (p == 1) {
+            for (long i = 0; i < items; i++) {
+                q.push(0, i);
+                good = q.pop(0, v) && seen.mark(v) && good;
+            }
+        } else if (tid < producers) {
+            for (long i = items * tid / producers; i < items * (tid + 1) / producers; i++)
+                while (!q.push(tid, i))
+                    this_thread::yield();
+            if (finished.fetch_add(1) == producers - 1)
+                for (int c = 0; c < consumers; c++)
+                    while (!q.push(tid, DONE))
+                        this_thread::yield();
+        } else {
+            for (;;) {
+                if (!q.pop(tid, v)) {
+                    this_thread::yield();
+                    continue;
+                }
+                if (v == DONE)
+                    break;
+                good = seen.mark(v) && good;
+            }
+        }
+        if (!good)
+            in_range = false;
+        #pragma omp barrier
+        #pragma omp master
+        t = omp_get_wtime() - t0;
+    }
+    if (!in_range || seen.once() != items)
+        ok = false;
+    return items / t / 1e6;
+}
+
+double run_queue(int kind, int p, long items, bool &ok) {
+    switch (kind) {
+    case MUTEX:     { MutexQueue q;    return time_queue(q, p, items, ok); }
+    case CRITICAL:  { CriticalQueue q; return time_queue(q, p, items, ok); }
+    case BOUNDED:   { Bounded q;       return time_queue(q, p, items, ok); }
+    case SEGMENTED: { Segmented q(p);  return time_queue(q, p, items, ok); }
+    default:        { Spsc q;          return p <= 2 ? time_queue(q, p, items, ok) : 0.0; }
+    }
+}
+
+struct MutexBag {
+    mutex m;
+    vector<long> v;
+    void add(int, long x) { lock_guard<mutex> g(m); v.push_back(x); }
+    bool take(int, long &x) {
+        lock_guard<mutex> g(m);
+        if (v.empty())
+            return false;
+        x = v.back();
+        v.pop_back();
+        return true;
+    }
+};
+
+struct CriticalBag {
+    vector<long> v;
+    void add(int, long x) {
+        #pragma omp critical(bag)
+        v.push_back(x);
+    }
+    bool take(int, long &x) {
+        bool found = false;
+        #pragma omp critical(bag)
+        if (!v.empty()) {
+            x = v.back();
+            v.pop_back();
+            found = true;
+        }
+        return found;
+    }
+};
+
+/* Millions of successful operations per second. In every round the even threads add
+   2*BURST items and every thread tries to take BURST, so the odd threads live on what
+   they can steal. Whatever is left is drained afterwards to check that every item added
+   was taken exactly once. */
+template <typename Bag>
+double time_bag(Bag &bag, int p, long items, bool &ok) {
+    long rounds = items / (2 * BURST * ((p + 1) / 2));
+    atomic<long> ops(0), added(0);
+    atomic<bool> in_range(true);
+    Seen seen(rounds * p * 2 * BURST);
+    double t = 0.0;
+    #pragma omp parallel num_threads(p)
+    {
+        int tid = omp_get_thread_num();
+        long n = 0, in = 0, x;
+        bool good = true;
+        #pragma omp barrier
+        double t0 = omp_get_wtime();
+        for (long r = 0; r < rounds; r++) {
+            if (tid % 2 == 0)
+                for (int i = 0; i < 2 * BURST; i++) {
+                    long item = (r * p + tid) * 2 * BURST + i;
+                    bag.add(tid, item);
+                    in++;
+                    n++;
+                }
+            for (int i = 0; i < BURST; i++)
+                if (bag.take(tid, x)) {
+                    good = seen.mark(x) && good;
+                    n++;
+                }
+        }
+        ops += n;
+        added += in;
+        if (!good)
+            in_range = false;
+        #pragma omp barrier
+        #pragma omp master
+        t = omp_get_wtime() - t0;
+    }
+    long x;
+    while (bag.take(0, x))
+        if (!seen.mark(x))
+            in_range = false;
+    if (!in_range || seen.once() != added)
+        ok = false;
+    return ops / t / 1e6;
+}
+
+double run_bag(int kind, int p, long items, bool &ok) {
+    switch (kind) {
+    case BAG_MUTEX:    { MutexBag b;          return time_bag(b, p, items, ok); }
+    case BAG_CRITICAL: { CriticalBag b;       return time_bag(b, p, items, ok); }
+    default:           { WorkBag<long> b(p);  return time_bag(b, p, items, ok); }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : omp_get_num_procs();
+    long items = (argc > 2) ? atol(argv[2]) : ITEMS;
+    vector<int> counts;
+    bool ok = true;
+
+    omp_set_dynamic(0);
+    for (int p = 1; p < maxThreads; p *= 2)
+        counts.push_back(p);
+    counts.push_back(maxThreads);
+
+    cout << "\n  Number of processors available = " << omp_get_num_procs() << "\n";
+    cout << "  Queue throughput, million items per second (" << items << " items;"
+         << " half the threads produce, half consume)\n\n";
+    cout << "  " << setw(8) << "threads";
+    for (int k = 0; k < NQUEUES; k++)
+        cout << "  " << setw(12) << queue_names[k];
+    cout << "\n";
+    for (int p : counts) {
+        cout << "  " << setw(8) << p << fixed << setprecision(2);
+        for (int k = 0; k < NQUEUES; k++) {
+            if (k == SPSC && p > 2)
+                cout << "  " << setw(12) << "-";
+            else
+                cout << "  " << setw(12) << run_queue(k, p, items, ok);
+        }
+        cout << "\n";
+    }
+
+    cout << "\n  Bag throughput, million operations per second"
+         << " (even threads add, all threads take)\n\n";
+    cout << "  " << setw(8) << "threads";
+    for (int k = 0; k < NBAGS; k++)
+        cout << "  " << setw(12) << bag_names[k];
+    cout << "\n";
+    for (int p : counts) {
+        cout << "  " << setw(8) << p << fixed << setprecision(2);
+        for (int k = 0; k < NBAGS; k++)
+            cout << "  " << setw(12) << run_bag(k, p, items, ok);
+        cout << "\n";
+    }
+
+    cout << "\n  Every item arrived exactly once: " << (ok ? "yes" : "NO") << "\n";
+    return ok ? 0 : 1;
+}
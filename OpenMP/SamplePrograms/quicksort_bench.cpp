@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <omp.h>
+#include <algorithm>
+#include "parallel_quicksort.h"
+
+#define N          100000000   /* Default elements, as in merge_sort.cpp */
+#define TASK_SIZE  100         /* merge_sort.cpp's cutoff */
+
+/*
+ * The in-place parallel quicksort of parallel_quicksort.h against the task merge sort
+ * of merge_sort.cpp and a serial std::sort, on three inputs:
+ *
+ *  random  uniform over all non-negative ints
+ *  0..5    fillupRandomly(X, N, 0, 5) as in merge_sort.cpp: six distinct keys
+ *  sorted  already in order
+ *
+ * Every run happens in a child process that generates the input, sorts it and checks
+ * the result, so the peak resident set reported by wait4() belongs to that sort alone.
+ * The parent never starts an OpenMP thread, so forking is safe.
+ */
+
+enum Input { RANDOM, FEW_KEYS, SORTED };
+enum Sorter { STD_SORT, MERGE_SORT, QUICKSORT };
+
+const char *input_names[] = {"random", "0..5", "sorted"};
+const char *sorter_names[] = {"std::sort (serial)", "merge_sort.cpp", "parallel_quicksort"};
+
+/* merge_sort.cpp */
+unsigned int rand_interval(unsigned int min, unsigned int max) {
+    unsigned int r;
+    const unsigned int range = 1 + max - min;
+    const unsigned int buckets = RAND_MAX / range;
+    const unsigned int limit = buckets * range;
+    do {
+        r = rand();
+    } while (r >= limit);
+    return min + (r / buckets);
+}
+
+void fillupRandomly(int *m, long size, unsigned int min, unsigned int max) {
+    for (long i = 0; i < size; i++)
+        m[i] = rand_interval(min, max);
+}
+
+void mergeSortAux(int *X, long n, int *tmp) {
+    long i = 0, j = n / 2, ti = 0;
+    while (i < n / 2 && j < n)
+        tmp[ti++] = (X[i] < X[j]) ? X[i++] : X[j++];
+    while (i < n / 2)
+        tmp[ti++] = X[i++];
+    while (j < n)
+        tmp[ti++] = X[j++];
+    memcpy(X, tmp, n * sizeof(int));
+}
+
+void mergeSort(int *X, long n, int *tmp) {
+    if (n < 2)
+        return;
+    #pragma omp task if (n > TASK_SIZE)
+    mergeSort(X, n / 2, tmp);
+    #pragma omp task if (n > TASK_SIZE)
+    mergeSort(X + n / 2, n - n / 2, tmp + n / 2);
+    #pragma omp taskwait
+    mergeSortAux(X, n, tmp);
+}
+
+/* Two sums that any permutation of x preserves */
+void checksum(const int *x, long n, unsigned long &s1, unsigned long &s2) {
+    s1 = s2 = 0;
+    for (long i = 0; i < n; i++) {
+        s1 += (unsigned long)x[i];
+        s2 += (unsigned long)x[i] * (unsigned long)x[i];
+    }
+}
+
+struct Result {
+    double seconds;
+    int ok;
+};
+
+/* The body of one child process */
+Result run(Input input, Sorter sorter, long n, int numThreads) {
+    omp_set_dynamic(0);
+    omp_set_num_threads(numThreads);
+    int *X = (int *)malloc(n * sizeof(int));
+    if (input == FEW_KEYS) {
+        srand(123456);
+        fillupRandomly(X, n, 0, 5);
+    } else {
+        unsigned s = 2024;
+        for (long i = 0; i < n; i++) {
+            s = s * 1103515245u + 12345u;
+            X[i] = (int)(s >> 1);
+        }
+        if (input == SORTED)
+            std::sort(X, X + n);
+    }
+    unsigned long a1, a2, b1, b2;
+    checksum(X, n, a1, a2);
+
+    double t = omp_get_wtime();
+    if (sorter == STD_SORT) {
+        std::sort(X, X + n);
+    } else if (sorter == MERGE_SORT) {
+        int *tmp = (int *)malloc(n * sizeof(int));
+        #pragma omp parallel
+        #pragma omp single
+        mergeSort(X, n, tmp);
+        free(tmp);
+    } else {
+        parallel_quicksort(X, n);
+    }
+    t = omp_get_wtime() - t;
+
+    checksum(X, n, b1, b2);
+    int ok = std::is_sorted(X, X + n) && a1 == b1 && a2 == b2;
+    free(X);
+    return {t, ok};
+}
+
+int main(int argc, char *argv[]) {
+    long n = (argc > 1) ? atol(argv[1]) : N;
+    int numThreads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+
+    printf("\n  n = %ld ints (%.0f MB), %d threads\n", n, n * 4.0 / (1 << 20), numThreads);
+    printf("  %-8s %-20s %10s %9s %10s %10s   %s\n", "input", "sort", "seconds", "speedup",
+           "peak MB", "extra MB", "correct");
+    for (int in = RANDOM; in <= SORTED; in++) {
+        double base = 0.0;
+        for (int so = STD_SORT; so <= QUICKSORT; so++) {
+            int fd[2];
+            if (pipe(fd) != 0)
+                return 1;
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fd[0]);
+                Result r = run((Input)in, (Sorter)so, n, numThreads);
+                if (write(fd[1], &r, sizeof(r)) != (ssize_t)sizeof(r))
+                    _exit(1);
+                _exit(0);
+            }
+            close(fd[1]);
+            Result r = {0.0, 0};
+            if (read(fd[0], &r, sizeof(r)) != (ssize_t)sizeof(r))
+                r.ok = 0;
+            close(fd[0]);
+            int status;
+            struct rusage ru;
+            wait4(pid, &status, 0, &ru);
+            if (so == STD_SORT)
+                base = r.seconds;
+            double peak = ru.ru_maxrss / 1024.0;   /* ru_maxrss is in KB */
+            printf("  %-8s %-20s %10.2f %8.2fx %10.0f %10.0f   %s\n", input_names[in],
+                   sorter_names[so], r.seconds, base / r.seconds, peak, peak - n * 4.0 / (1 << 20),
+                   r.ok ? "yes" : "NO");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+#define N           2048           /* Default largest matrix size */
+#define TILE        64             /* Tile edge of the blocked GEMM, leaf size of the recursion */
+#define TASK_WORK   (1L << 21)     /* Sub-products with fewer multiply-adds run in the parent task */
+#define PAR_LEVELS  1              /* Strassen levels whose seven products run as separate tasks */
+
+using namespace std;
+
+enum variant { STRASSEN, WINOGRAD };
+const char *variant_names[2] = {"strassen", "winograd"};
+
+/* C[m x n] += A[m x k] * B[k x n] on the calling thread; row-major with leading dimensions */
+void kernel(int m, int n, int k, const double *A, long lda, const double *B, long ldb,
+            double *C, long ldc) {
+    for (int i = 0; i < m; i++) {
+        double *c = C + i * ldc;
+        for (int p = 0; p < k; p++) {
+            double a = A[i * lda + p];
+            const double *b = B + p * ldb;
+            #pragma omp simd
+            for (int j = 0; j < n; j++)
+                c[j] += a * b[j];
+        }
+    }
+}
+
+/* Reference: C = A * B with TILE x TILE tiles of C spread over the threads */
+void blocked_gemm(int n, const double *A, const double *B, double *C) {
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int ii = 0; ii < n; ii += TILE)
+        for (int jj = 0; jj < n; jj += TILE) {
+            int mb = min(TILE, n - ii), nb = min(TILE, n - jj);
+            for (int i = 0; i < mb; i++)
+                memset(C + (long)(ii + i) * n + jj, 0, nb * sizeof(double));
+            for (int kk = 0; kk < n; kk += TILE)
+                kernel(mb, nb, min(TILE, n - kk), A + (long)ii * n + kk, n,
+                       B + (long)kk * n + jj, n, C + (long)ii * n + jj, n);
+        }
+}
+
+/*
+ * Cache-oblivious C += A * B: halve the largest of m, n, k until the three blocks fit in
+ * cache, without knowing the cache size. Halving m or n gives two independent halves of C,
+ * which run as tasks; halving k gives two updates of the same C, which run one after the
+ * other.
+ */
+void rec_gemm(int m, int n, int k, const double *A, long lda, const double *B, long ldb,
+              double *C, long ldc) {
+    if (m <= TILE && n <= TILE && k <= TILE) {
+        kernel(m, n, k, A, lda, B, ldb, C, ldc);
+        return;
+    }
+    bool spawn = (double)m * n * k > TASK_WORK;
+    if (m >= n && m >= k) {
+        int h = m / 2;
+        #pragma omp task if (spawn)
+        rec_gemm(h, n, k, A, lda, B, ldb, C, ldc);
+        #pragma omp task if (spawn)
+        rec_gemm(m - h, n, k, A + h * lda, lda, B, ldb, C + h * ldc, ldc);
+        #pragma omp taskwait
+    } else if (n >= k) {
+        int h = n / 2;
+        #pragma omp task if (spawn)
+        rec_gemm(m, h, k, A, lda, B, ldb, C, ldc);
+        #pragma omp task if (spawn)
+        rec_gemm(m, n - h, k, A, lda, B + h, ldb, C + h, ldc);
+        #pragma omp taskwait
+    } else {
+        int h = k / 2;
+        rec_gemm(m, n, h, A, lda, B, ldb, C, ldc);
+        rec_gemm(m, n, k - h, A + h, lda, B + h * ldb, ldb, C, ldc);
+    }
+}
+
+void recursive_gemm(int n, const double *A, const double *B, double *C) {
+    memset(C, 0, (size_t)n * n * sizeof(double));
+    #pragma omp parallel
+    {
+        #pragma omp single
+        rec_gemm(n, n, n, A, n, B, n, C, n);
+    }
+}
+
+/* D = X + s * Y on h x h blocks (D may be X); split into tasks when `par` is set */
+void add(int h, const double *X, long ldx, const double *Y, long ldy, double s,
+         double *D, long ldd, bool par) {
+    #pragma omp taskloop if (par) grainsize(16)
+    for (int i = 0; i < h; i++) {
+        const double *x = X + i * ldx, *y = Y + i * ldy;
+        double *d = D + i * ldd;
+        #pragma omp simd
+        for (int j = 0; j < h; j++)
+            d[j] = x[j] + s * y[j];
+    }
+}
+
+/* Temporaries of one recursion level, in h x h blocks: operand sums and the 7 products */
+int level_blocks(variant v) {
+    return (v == STRASSEN) ? 10 + 7 : 8 + 7;
+}
+
+/* Workspace for an n x n product at recursion `level`: this level's temporaries plus one
+   workspace per product when the products run in parallel, else one reused by all seven */
+size_t workspace_size(int n, int level, variant v, int cross) {
+    if (n <= cross)
+        return 0;
+    size_t h = n / 2;
+    size_t child = workspace_size(n / 2, level + 1, v, cross);
+    return level_blocks(v) * h * h + (level < PAR_LEVELS ? 7 : 1) * child;
+}
+
+/* Smallest size >= n of the form c * 2^L with c <= cross, so halving L times stays exact */
+int padded_size(int n, int cross) {
+    int L = 0;
+    while ((n + (1 << L) - 1) >> L > cross)
+        L++;
+    return ((n + (1 << L) - 1) >> L) << L;
+}
+
+/*
+ * C = A * B for n x n blocks with n = c * 2^L. Above the crossover each level forms the
+ * operand sums, computes seven half-size products instead of eight, and combines them;
+ * at or below it the product is handed to rec_gemm. `ws` is this call's slice of the
+ * workspace arena, so nothing is allocated during the recursion.
+ */
+void fast_gemm(int n, const double *A, long lda, const double *B, long ldb, double *C, long ldc,
+               double *ws, int level, variant v, int cross) {
+    if (n <= cross) {
+        for (int i = 0; i < n; i++)
+            memset(C + i * ldc, 0, n * sizeof(double));
+        rec_gemm(n, n, n, A, lda, B, ldb, C, ldc);
+        return;
+    }
+
+    int h = n / 2;
+    long hh = (long)h * h;
+    bool par = level < PAR_LEVELS;
+    const double *A11 = A, *A12 = A + h, *A21 = A + h * lda, *A22 = A21 + h;
+    const double *B11 = B, *B12 = B + h, *B21 = B + h * ldb, *B22 = B21 + h;
+    double *C11 = C, *C12 = C + h, *C21 = C + h * ldc, *C22 = C21 + h;
+    double *T[17];
+    for (int i = 0; i < level_blocks(v); i++)
+        T[i] = ws + i * hh;
+    double *P = T[level_blocks(v) - 7];  /* the 7 products are the last 7 blocks */
+    const double *L[7], *R[7];
+    long ldl[7], ldr[7];
+
+    if (v == STRASSEN) {
+        add(h, A11, lda, A22, lda, 1, T[0], h, par);  L[0] = T[0]; ldl[0] = h;
+        add(h, B11, ldb, B22, ldb, 1, T[1], h, par);  R[0] = T[1]; ldr[0] = h;
+        add(h, A21, lda, A22, lda, 1, T[2], h, par);  L[1] = T[2]; ldl[1] = h;
+        R[1] = B11; ldr[1] = ldb;
+        L[2] = A11; ldl[2] = lda;
+        add(h, B12, ldb, B22, ldb, -1, T[3], h, par); R[2] = T[3]; ldr[2] = h;
+        L[3] = A22; ldl[3] = lda;
+        add(h, B21, ldb, B11, ldb, -1, T[4], h, par); R[3] = T[4]; ldr[3] = h;
+        add(h, A11, lda, A12, lda, 1, T[5], h, par);  L[4] = T[5]; ldl[4] = h;
+        R[4] = B22; ldr[4] = ldb;
+        add(h, A21, lda, A11, lda, -1, T[6], h, par); L[5] = T[6]; ldl[5] = h;
+        add(h, B11, ldb, B12, ldb, 1, T[7], h, par);  R[5] = T[7]; ldr[5] = h;
+        add(h, A12, lda, A22, lda, -1, T[8], h, par); L[6] = T[8]; ldl[6] = h;
+        add(h, B21, ldb, B22, ldb, 1, T[9], h, par);  R[6] = T[9]; ldr[6] = h;
+    } else {
+        double *S1 = T[0], *S2 = T[1], *S3 = T[2], *S4 = T[3];
+        double *T1 = T[4], *T2 = T[5], *T3 = T[6], *T4 = T[7];
+        add(h, A21, lda, A22, lda, 1, S1, h, par);
+        add(h, S1, h, A11, lda, -1, S2, h, par);
+        add(h, A11, lda, A21, lda, -1, S3, h, par);
+        add(h, A12, lda, S2, h, -1, S4, h, par);
+        add(h, B12, ldb, B11, ldb, -1, T1, h, par);
+        add(h, B22, ldb, T1, h, -1, T2, h, par);
+        add(h, B22, ldb, B12, ldb, -1, T3, h, par);
+        add(h, T2, h, B21, ldb, -1, T4, h, par);
+        L[0] = A11; ldl[0] = lda; R[0] = B11; ldr[0] = ldb;
+        L[1] = A12; ldl[1] = lda; R[1] = B21; ldr[1] = ldb;
+        L[2] = S4;  ldl[2] = h;   R[2] = B22; ldr[2] = ldb;
+        L[3] = A22; ldl[3] = lda; R[3] = T4;  ldr[3] = h;
+        L[4] = S1;  ldl[4] = h;   R[4] = T1;  ldr[4] = h;
+        L[5] = S2;  ldl[5] = h;   R[5] = T2;  ldr[5] = h;
+        L[6] = S3;  ldl[6] = h;   R[6] = T3;  ldr[6] = h;
+    }
+
+    /* The seven products; with `par` each gets its own slice of the workspace */
+    double *child = ws + level_blocks(v) * hh;
+    size_t child_size = workspace_size(h, level + 1, v, cross);
+    for (int i = 0; i < 7; i++) {
+        #pragma omp task if (par)
+        fast_gemm(h, L[i], ldl[i], R[i], ldr[i], P + i * hh, h,
+                  child + (par ? i * child_size : 0), level + 1, v, cross);
+    }
+    #pragma omp taskwait
+
+    double *M1 = P, *M2 = P + hh, *M3 = P + 2 * hh, *M4 = P + 3 * hh;
+    double *M5 = P + 4 * hh, *M6 = P + 5 * hh, *M7 = P + 6 * hh;
+    if (v == STRASSEN) {
+        add(h, M1, h, M4, h, 1, C11, ldc, par);         /* C11 = M1 + M4 - M5 + M7 */
+        add(h, C11, ldc, M5, h, -1, C11, ldc, par);
+        add(h, C11, ldc, M7, h, 1, C11, ldc, par);
+        add(h, M3, h, M5, h, 1, C12, ldc, par);         /* C12 = M3 + M5 */
+        add(h, M2, h, M4, h, 1, C21, ldc, par);         /* C21 = M2 + M4 */
+        add(h, M1, h, M2, h, -1, C22, ldc, par);        /* C22 = M1 - M2 + M3 + M6 */
+        add(h, C22, ldc, M3, h, 1, C22, ldc, par);
+        add(h, C22, ldc, M6, h, 1, C22, ldc, par);
+    } else {
+        add(h, M1, h, M2, h, 1, C11, ldc, par);         /* C11 = P1 + P2 */
+        add(h, M1, h, M6, h, 1, M6, h, par);            /* U2 = P1 + P6 */
+        add(h, M6, h, M7, h, 1, M7, h, par);            /* U3 = U2 + P7 */
+        add(h, M6, h, M5, h, 1, M6, h, par);            /* U4 = U2 + P5 */
+        add(h, M6, h, M3, h, 1, C12, ldc, par);         /* C12 = U4 + P3 */
+        add(h, M7, h, M4, h, -1, C21, ldc, par);        /* C21 = U3 - P4 */
+        add(h, M7, h, M5, h, 1, C22, ldc, par);         /* C22 = U3 + P5 */
+    }
+}
+
+/* Copy the n x n matrix X into the top-left corner of the np x np matrix Y, zero the rest */
+void pad(int n, const double *X, int np, double *Y) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < np; i++) {
+        if (i < n) {
+            memcpy(Y + (long)i * np, X + (long)i * n, n * sizeof(double));
+            memset(Y + (long)i * np + n, 0, (np - n) * sizeof(double));
+        } else {
+            memset(Y + (long)i * np, 0, np * sizeof(double));
+        }
+    }
+}
+
+/* The padded operands and all recursion temporaries come from one buffer that is
+   allocated once and reused by every call */
+struct Arena {
+    vector<double> buf;
+    double *get(size_t n) {
+        if (buf.size() < n)
+            buf.resize(n);
+        return buf.data();
+    }
+};
+
+size_t strassen_arena_size(int n, variant v, int cross) {
+    int np = padded_size(n, cross);
+    return (np == n ? 0 : 3 * (size_t)np * np) + workspace_size(np, 0, v, cross);
+}
+
+/* C = A * B for any n: pad up to c * 2^L if needed, multiply, copy the corner back */
+void strassen_gemm(int n, const double *A, const double *B, double *C, variant v, int cross,
+                   Arena &arena) {
+    int np = padded_size(n, cross);
+    size_t pn = (np == n) ? 0 : (size_t)np * np;
+    double *base = arena.get(strassen_arena_size(n, v, cross));
+    const double *a = A, *b = B;
+    double *c = C;
+
+    if (pn) {
+        pad(n, A, np, base);
+        pad(n, B, np, base + pn);
+        a = base;
+        b = base + pn;
+        c = base + 2 * pn;
+    }
+    #pragma omp parallel
+    {
+        #pragma omp single
+        fast_gemm(np, a, np, b, np, c, np, base + 3 * pn, 0, v, cross);
+    }
+    if (pn) {
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; i++)
+            memcpy(C + (long)i * n, c + (long)i * np, n * sizeof(double));
+    }
+}
+
+double max_diff(long len, const double *X, const double *Y) {
+    double d = 0.0;
+    #pragma omp parallel for reduction(max : d)
+    for (long i = 0; i < len; i++)
+        d = max(d, fabs(X[i] - Y[i]));
+    return d;
+}
+
+/* Best of `reps` runs of one multiply, in seconds */
+template <typename F>
+double timed(int reps, F f) {
+    double best = 1e30;
+    for (int r = 0; r < reps; r++) {
+        double t = omp_get_wtime();
+        f();
+        best = min(best, omp_get_wtime() - t);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    int nmax = (argc > 1) ? atoi(argv[1]) : N;
+    int numThreads = (argc > 2) ? atoi(argv[2]) : 0;
+    int cross = (argc > 3) ? atoi(argv[3]) : 0;
+    const int sizes[] = {128, 192, 256, 384, 500, 512, 768, 1000, 1024, 1536, 2000, 2048,
+                         3000, 4096, 6000, 8192};
+    const int crossovers[] = {64, 128, 256, 512, 1024};
+    Arena arena;
+
+    if (numThreads > 0) {
+        omp_set_dynamic(0);
+        omp_set_num_threads(numThreads);
+    }
+
+    srand(123456);
+    vector<double> A((size_t)nmax * nmax), B((size_t)nmax * nmax);
+    vector<double> Cref((size_t)nmax * nmax), C((size_t)nmax * nmax);
+    for (size_t i = 0; i < A.size(); i++) {
+        A[i] = 2.0 * rand() / RAND_MAX - 1.0;
+        B[i] = 2.0 * rand() / RAND_MAX - 1.0;
+    }
+    printf("Matrices up to %d x %d, %d threads\n", nmax, nmax, omp_get_max_threads());
+
+    /***** Check the reference against direct dot products at a few positions *****/
+    blocked_gemm(nmax, A.data(), B.data(), Cref.data());
+    double err = 0.0;
+    for (int s = 0; s < 64; s++) {
+        int i = rand() % nmax, j = rand() % nmax;
+        double dot = 0.0;
+        for (int k = 0; k < nmax; k++)
+            dot += A[(long)i * nmax + k] * B[(long)k * nmax + j];
+        err = max(err, fabs(dot - Cref[(long)i * nmax + j]));
+    }
+    printf("Blocked GEMM vs dot products: max error %.1e\n", err);
+
+    /***** Tune the crossover at the largest size *****/
+    if (cross <= 0) {
+        double best = 1e30;
+        printf("\nCrossover tuning at n = %d (winograd):\n", nmax);
+        for (int c : crossovers) {
+            if (c >= nmax)
+                break;
+            arena.get(strassen_arena_size(nmax, WINOGRAD, c));
+            double t = timed(1, [&] {
+                strassen_gemm(nmax, A.data(), B.data(), C.data(), WINOGRAD, c, arena);
+            });
+            printf("  crossover %5d  padded to %5d  %8.3f s  %7.2f GFLOP/s\n", c,
+                   padded_size(nmax, c), t, 2.0 * nmax * nmax * nmax / t / 1e9);
+            if (t < best) {
+                best = t;
+                cross = c;
+            }
+        }
+        if (cross <= 0)
+            cross = nmax;
+        printf("  using crossover %d\n", cross);
+    }
+
+    /***** Sweep the sizes: blocked vs cache-oblivious vs Strassen vs Winograd *****/
+    printf("\n%6s %6s  %16s %16s %16s %16s  %s\n", "n", "padded", "blocked s (GF/s)",
+           "recursive", "strassen", "winograd", "max error");
+    int firstWin[3] = {0, 0, 0};   /* smallest n from which each method beats blocked */
+    vector<int> list(sizes, sizes + sizeof(sizes) / sizeof(sizes[0]));
+    list.erase(remove_if(list.begin(), list.end(), [&](int n) { return n >= nmax; }), list.end());
+    list.push_back(nmax);
+
+    for (int n : list) {
+        vector<double> a((size_t)n * n), b((size_t)n * n), ref((size_t)n * n), c((size_t)n * n);
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++) {
+                a[(long)i * n + j] = A[(long)i * nmax + j];
+                b[(long)i * n + j] = B[(long)i * nmax + j];
+            }
+        int reps = (n < 1024) ? 3 : 1;
+        double t[4], e = 0.0;
+        arena.get(max(strassen_arena_size(n, STRASSEN, cross),
+                      strassen_arena_size(n, WINOGRAD, cross)));
+
+        t[0] = timed(reps, [&] { blocked_gemm(n, a.data(), b.data(), ref.data()); });
+        t[1] = timed(reps, [&] { recursive_gemm(n, a.data(), b.data(), c.data()); });
+        e = max(e, max_diff((long)n * n, ref.data(), c.data()));
+        for (int v = STRASSEN; v <= WINOGRAD; v++) {
+            t[2 + v] = timed(reps, [&] {
+                strassen_gemm(n, a.data(), b.data(), c.data(), (variant)v, cross, arena);
+            });
+            e = max(e, max_diff((long)n * n, ref.data(), c.data()));
+        }
+
+        double gflop = 2.0 * n * n * n / 1e9;
+        printf("%6d %6d ", n, padded_size(n, cross));
+        for (int m = 0; m < 4; m++)
+            printf(" %8.4f (%5.1f)", t[m], gflop / t[m]);
+        printf("  %.1e\n", e);
+        for (int m = 1; m < 4; m++) {
+            if (t[m] < t[0] && firstWin[m - 1] == 0)
+                firstWin[m - 1] = n;
+            else if (t[m] >= t[0])
+                firstWin[m - 1] = 0;
+        }
+    }
+
+    printf("\nCrossover against blocked GEMM (%d threads, Strassen crossover %d):\n",
+           omp_get_max_threads(), cross);
+    const char *names[3] = {"recursive", variant_names[STRASSEN], variant_names[WINOGRAD]};
+    for (int m = 0; m < 3; m++) {
+        if (firstWin[m])
+            printf("  %-10s faster from n = %d\n", names[m], firstWin[m]);
+        else
+            printf("  %-10s not faster at n = %d\n", names[m], nmax);
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * Per-thread scratch memory that persists across parallel regions, kept in a
+ * threadprivate variable the way thread_private.cpp keeps `a` and `x`.
+ *
+ *   ScratchRegion r;                       first statement of a parallel region
+ *   ...
+ *   {
+ *       ScratchScope s;                    marks the arena
+ *       int *tmp = scratch_array<int>(n);  bump allocation, no locks, no malloc
+ *   }                                      tmp is released here
+ *
+ * Allocation moves a pointer within the calling thread's block, so threads never
+ * synchronize. A thread reserves its block itself and touches every page, so the pages
+ * are placed on the thread's own NUMA node and the page faults are paid once. If a
+ * request does not fit, it is served by malloc for now, and the arena remembers the
+ * size. When the region ends, ScratchRegion resets the arena and grows the block to the
+ * largest amount used, so later regions never call malloc.
+ *
+ * Scopes must be released in reverse order. Tied OpenMP tasks keep that order: a task
+ * that a thread starts while another task is suspended finishes first.
+ */
+
+#define SCRATCH_INITIAL   (1 << 20)  /* bytes reserved on a thread's first allocation */
+#define SCRATCH_ALIGN     64
+#define SCRATCH_PAGE      4096
+#define SCRATCH_OVERFLOW  64         /* outstanding oversize requests per thread */
+
+struct ScratchArena {
+    char *base;
+    size_t size, top;
+    size_t peak;                     /* most bytes in use at once, including overflow */
+    size_t overflow_bytes;
+    void *overflow[SCRATCH_OVERFLOW];
+    int noverflow;
+    long system_allocs;              /* calls to malloc made for this thread */
+};
+
+inline ScratchArena scratch_arena;
+#pragma omp threadprivate(scratch_arena)
+
+inline size_t scratch_round(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+/* Replace the calling thread's block by one of at least `bytes`, touched by this thread */
+inline void scratch_reserve(size_t bytes) {
+    ScratchArena &a = scratch_arena;
+    free(a.base);
+    a.size = scratch_round(bytes, SCRATCH_PAGE);
+    a.base = (char *)aligned_alloc(SCRATCH_PAGE, a.size);
+    for (size_t p = 0; p < a.size; p += SCRATCH_PAGE)
+        a.base[p] = 0;
+    a.top = 0;
+    a.system_allocs++;
+}
+
+inline void *scratch_alloc(size_t bytes, size_t align = SCRATCH_ALIGN) {
+    ScratchArena &a = scratch_arena;
+    if (a.base == nullptr)
+        scratch_reserve(bytes > SCRATCH_INITIAL ? bytes : SCRATCH_INITIAL);
+    size_t at = scratch_round(a.top, align);
+    if (at + bytes <= a.size) {
+        a.top = at + bytes;
+        if (a.top + a.overflow_bytes > a.peak)
+            a.peak = a.top + a.overflow_bytes;
+        return a.base + at;
+    }
+    if (a.noverflow == SCRATCH_OVERFLOW)
+        abort();
+    void *p = aligned_alloc(align, scratch_round(bytes, align));
+    a.overflow[a.noverflow++] = p;
+    a.overflow_bytes += scratch_round(bytes, align);
+    if (a.top + a.overflow_bytes > a.peak)
+        a.peak = a.top + a.overflow_bytes;
+    a.system_allocs++;
+    return p;
+}
+
+template <typename T>
+inline T *scratch_array(size_t n) {
+    return (T *)scratch_alloc(n * sizeof(T), alignof(T) > SCRATCH_ALIGN ? alignof(T) : SCRATCH_ALIGN);
+}
+
+/* Releases everything the calling thread allocated since the scope began */
+class ScratchScope {
+public:
+    ScratchScope() : top(scratch_arena.top), noverflow(scratch_arena.noverflow),
+                     overflow_bytes(scratch_arena.overflow_bytes) {}
+    ~ScratchScope() {
+        ScratchArena &a = scratch_arena;
+        while (a.noverflow > noverflow)
+            free(a.overflow[--a.noverflow]);
+        a.overflow_bytes = overflow_bytes;
+        a.top = top;
+    }
+    ScratchScope(const ScratchScope &) = delete;
+    ScratchScope &operator=(const ScratchScope &) = delete;
+
+private:
+    size_t top;
+    int noverflow;
+    size_t overflow_bytes;
+};
+
+/* Empty the calling thread's arena, growing its block to the peak use seen so far */
+inline void scratch_reset() {
+    ScratchArena &a = scratch_arena;
+    while (a.noverflow > 0)
+        free(a.overflow[--a.noverflow]);
+    a.overflow_bytes = 0;
+    if (a.peak > a.size)
+        scratch_reserve(a.peak + a.peak / 4);
+    a.top = 0;
+}
+
+/* Resets the arena of the thread that declared it when it goes out of scope */
+class ScratchRegion {
+public:
+    ScratchRegion() = default;
+    ~ScratchRegion() { scratch_reset(); }
+    ScratchRegion(const ScratchRegion &) = delete;
+    ScratchRegion &operator=(const ScratchRegion &) = delete;
+};
+
+/* Give the calling thread's block back to the system */
+inline void scratch_release() {
+    scratch_reset();
+    free(scratch_arena.base);
+    scratch_arena.base = nullptr;
+    scratch_arena.size = scratch_arena.top = scratch_arena.peak = 0;
+}
+
+#endif
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "scratch_arena.h"
+
+#define SORT_N      (1 << 20)   /* Elements per sort */
+#define MERGE_N     (1 << 16)   /* Elements per merge */
+#define HIST_N      (1 << 16)   /* Values per histogram */
+#define HIST_BINS   (1 << 16)   /* Bins, and so per-thread counters, of the histogram */
+#define SORT_TASK   4096        /* Smallest sort that spawns tasks */
+
+using namespace std;
+
+/*
+ * Three kernels that need temporary memory on every call, each written twice: once
+ * with malloc and free, and once on the per-thread arenas of scratch_arena.h.
+ *
+ *  sort       the task merge sort of merge_sort.cpp, with one buffer as large as the
+ *             input per sort
+ *  merge      merges two sorted halves in place: each thread merges its share of the
+ *             output, found by binary search on the merge path, into a buffer
+ *  histogram  a reduction into per-thread counters, which are then summed bin by bin
+ */
+
+atomic<long> heap_allocs(0);
+
+void *heap_alloc(size_t bytes) {
+    heap_allocs.fetch_add(1, memory_order_relaxed);
+    return malloc(bytes);
+}
+
+void merge_halves(int *X, int n, int *tmp) {
+    int i = 0, j = n / 2, k = 0;
+    while (i < n / 2 && j < n)
+        tmp[k++] = (X[i] <= X[j]) ? X[i++] : X[j++];
+    while (i < n / 2)
+        tmp[k++] = X[i++];
+    while (j < n)
+        tmp[k++] = X[j++];
+    memcpy(X, tmp, n * sizeof(int));
+}
+
+/* The recursion of merge_sort.cpp: both halves sort into the matching halves of tmp */
+void sort_tasks(int *X, int n, int *tmp) {
+    if (n < 2)
+        return;
+    #pragma omp task if (n > SORT_TASK)
+    sort_tasks(X, n / 2, tmp);
+    #pragma omp task if (n > SORT_TASK)
+    sort_tasks(X + n / 2, n - n / 2, tmp + n / 2);
+    #pragma omp taskwait
+    merge_halves(X, n, tmp);
+}
+
+void sort_heap(int *X, int n) {
+    int *tmp = (int *)heap_alloc(n * sizeof(int));
+    sort_tasks(X, n, tmp);
+    free(tmp);
+}
+
+void sort_arena(int *X, int n) {
+    ScratchScope s;
+    sort_tasks(X, n, scratch_array<int>(n));
+}
+
+/* Elements taken from A among the first k of the stable merge of A (na) and B (nb) */
+int merge_path(const int *A, int na, const int *B, int nb, int k) {
+    int lo = max(0, k - nb), hi = min(k, na);
+    while (lo < hi) {
+        int i = (lo + hi) / 2;
+        if (A[i] <= B[k - i - 1])
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/* One thread's share of merging X[0, m) with X[m, n) into buf, then copied back */
+void merge_share(int *X, int m, int n, int t, int nt, int *buf) {
+    int k0 = (int)((long)n * t / nt), k1 = (int)((long)n * (t + 1) / nt);
+    int i0 = merge_path(X, m, X + m, n - m, k0), i1 = merge_path(X, m, X + m, n - m, k1);
+    int i = i0, j = m + k0 - i0, iend = i1, jend = m + k1 - i1, k = 0;
+    while (i < iend && j < jend)
+        buf[k++] = (X[i] <= X[j]) ? X[i++] : X[j++];
+    while (i < iend)
+        buf[k++] = X[i++];
+    while (j < jend)
+        buf[k++] = X[j++];
+    #pragma omp barrier
+    memcpy(X + k0, buf, (k1 - k0) * sizeof(int));
+}
+
+void merge_heap(int *X, int m, int n) {
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        int *buf = (int *)heap_alloc((n / nt + 1) * sizeof(int));
+        merge_share(X, m, n, t, nt, buf);
+        free(buf);
+    }
+}
+
+void merge_arena(int *X, int m, int n) {
+    #pragma omp parallel
+    {
+        ScratchRegion r;
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        merge_share(X, m, n, t, nt, scratch_array<int>(n / nt + 1));
+    }
+}
+
+/* Count X into per-thread counters, then let each thread sum a range of bins */
+void histogram_share(const int *X, int n, long *hist, long *mine, long **parts) {
+    int t = omp_get_thread_num(), nt = omp_get_num_threads();
+    memset(mine, 0, HIST_BINS * sizeof(long));
+    parts[t] = mine;
+    #pragma omp for schedule(static)
+    for (int i = 0; i < n; i++)
+        mine[X[i] & (HIST_BINS - 1)]++;
+    for (int b = HIST_BINS * t / nt; b < HIST_BINS * (t + 1) / nt; b++) {
+        long s = 0;
+        for (int u = 0; u < nt; u++)
+            s += parts[u][b];
+        hist[b] = s;
+    }
+    #pragma omp barrier
+}
+
+void histogram_heap(const int *X, int n, long *hist) {
+    vector<long *> parts(omp_get_max_threads());    /* one per thread of the team below */
+    #pragma omp parallel
+    {
+        long *mine = (long *)heap_alloc(HIST_BINS * sizeof(long));
+        histogram_share(X, n, hist, mine, parts.data());
+        free(mine);
+    }
+}
+
+void histogram_arena(const int *X, int n, long *hist) {
+    vector<long *> parts(omp_get_max_threads());
+    #pragma omp parallel
+    {
+        ScratchRegion r;
+        histogram_share(X, n, hist, scratch_array<long>(HIST_BINS), parts.data());
+    }
+}
+
+/* Calls to malloc the arenas of the current team have made so far */
+long arena_allocs() {
+    long n = 0;
+    #pragma omp parallel reduction(+:n)
+    n += scratch_arena.system_allocs;
+    return n;
+}
+
+/* Microseconds per call, with the heap and arena allocations made per call after a
+   warm-up call */
+struct Result {
+    double us, heap, arena;
+};
+
+template <typename F>
+Result timed(int reps, F f) {
+    f(0);
+    long h = heap_allocs, a = arena_allocs();
+    double t = omp_get_wtime();
+    for (int r = 1; r <= reps; r++)
+        f(r);
+    t = omp_get_wtime() - t;
+    return {t / reps * 1e6, (double)(heap_allocs - h) / reps, (double)(arena_allocs() - a) / reps};
+}
+
+void report(const char *kernel, const char *variant, Result r, double base, bool ok) {
+    printf("  %-10s %-8s %12.1f %8.2fx %14.1f %14.1f   %s\n", kernel, variant, r.us,
+           base / r.us, r.heap, r.arena, ok ? "yes" : "NO");
+}
+
+int main(int argc, char *argv[]) {
+    int numThreads = (argc > 1) ? atoi(argv[1]) : omp_get_max_threads();
+    int reps = (argc > 2) ? atoi(argv[2]) : 20;
+
+    omp_set_dynamic(0);
+    omp_set_num_threads(numThreads);
+    printf("\n  %d threads, %d calls per kernel\n", numThreads, reps);
+    printf("  %-10s %-8s %12s %9s %14s %14s   %s\n", "kernel", "memory", "us per call",
+           "speedup", "mallocs/call", "arena mallocs", "correct");
+
+    unsigned s = 12345;
+    auto next = [&s] { s = s * 1103515245u + 12345u; return (int)(s >> 1); };
+    vector<int> input(SORT_N), X(SORT_N), sorted(SORT_N);
+    for (int &x : input)
+        x = next();
+    sorted = input;
+    std::sort(sorted.begin(), sorted.end());
+
+    /* Every call sorts a fresh copy of the same input */
+    bool ok = true;
+    auto sort_with = [&](void (*sort)(int *, int)) {
+        return [&, sort](int) {
+            X = input;
+            #pragma omp parallel
+            {
+                ScratchRegion r;
+                #pragma omp single
+                sort(X.data(), SORT_N);
+            }
+            ok = ok && X == sorted;
+        };
+    };
+    Result heap = timed(reps, sort_with(sort_heap));
+    report("sort", "malloc", heap, heap.us, ok);
+    ok = true;
+    Result arena = timed(reps, sort_with(sort_arena));
+    report("sort", "arena", arena, heap.us, ok);
+
+    /* Every call merges two sorted halves of a fresh copy */
+    vector<int> halves(MERGE_N);
+    for (int &x : halves)
+        x = next();
+    std::sort(halves.begin(), halves.begin() + MERGE_N / 2);
+    std::sort(halves.begin() + MERGE_N / 2, halves.end());
+    vector<int> merged = halves;
+    std::inplace_merge(merged.begin(), merged.begin() + MERGE_N / 2, merged.end());
+    auto merge_with = [&](void (*merge)(int *, int, int)) {
+        return [&, merge](int) {
+            X.assign(halves.begin(), halves.end());
+            merge(X.data(), MERGE_N / 2, MERGE_N);
+            ok = ok && X == merged;
+        };
+    };
+    ok = true;
+    heap = timed(reps * 10, merge_with(merge_heap));
+    report("merge", "malloc", heap, heap.us, ok);
+    ok = true;
+    arena = timed(reps * 10, merge_with(merge_arena));
+    report("merge", "arena", arena, heap.us, ok);
+
+    /* Every call counts the same values */
+    vector<int> values(input.begin(), input.begin() + HIST_N);
+    vector<long> hist(HIST_BINS), expect(HIST_BINS);
+    for (int v : values)
+        expect[v & (HIST_BINS - 1)]++;
+    auto hist_with = [&](void (*h)(const int *, int, long *)) {
+        return [&, h](int) {
+            h(values.data(), HIST_N, hist.data());
+            ok = ok && hist == expect;
+        };
+    };
+    ok = true;
+    heap = timed(reps * 10, hist_with(histogram_heap));
+    report("histogram", "malloc", heap, heap.us, ok);
+    ok = true;
+    arena = timed(reps * 10, hist_with(histogram_arena));
+    report("histogram", "arena", arena, heap.us, ok);
+
+    #pragma omp parallel
+    scratch_release();
+    return 0;
+}
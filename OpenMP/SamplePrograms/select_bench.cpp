@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+#include "parallel_select.h"
+
+#define N  100000000   /* Default elements, as in merge_sort.cpp */
+#define K  1000        /* Default k of the partial sort and top-k */
+
+using namespace std;
+
+/*
+ * The median and the k smallest and largest elements of an array, found by the
+ * selection routines of parallel_select.h, against a full parallel_quicksort that the
+ * same answers are then read from. Two inputs: uniform random ints, and the six keys of
+ * merge_sort.cpp's fillupRandomly(X, N, 0, 5). Every run starts from a fresh copy of
+ * the input; the copy is not timed.
+ */
+
+void report(const char *task, const char *variant, double t, double base, bool ok) {
+    printf("  %-22s %-30s %9.3f %9.2fx   %s\n", task, variant, t, base / t, ok ? "yes" : "NO");
+}
+
+/* Whether x[k] holds the k-th element of sorted and x is partitioned around it */
+bool selected(const vector<int> &x, long k, const vector<int> &sorted) {
+    int v = x[k];
+    if (v != sorted[k])
+        return false;
+    for (long i = 0; i < (long)x.size(); i++)
+        if ((i < k && x[i] > v) || (i > k && x[i] < v))
+            return false;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    long n = (argc > 1) ? atol(argv[1]) : N;
+    int numThreads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+    long k = (argc > 3) ? atol(argv[3]) : K;
+    k = min(k, n);
+
+    omp_set_dynamic(0);
+    omp_set_num_threads(numThreads);
+    printf("\n  n = %ld ints, k = %ld, %d threads\n", n, k, numThreads);
+    printf("  %-22s %-30s %9s %10s   %s\n", "task", "variant", "seconds", "speedup", "correct");
+
+    vector<int> input(n), sorted, x;
+    for (int kind = 0; kind < 2; kind++) {
+        unsigned s = 2024;
+        for (long i = 0; i < n; i++) {
+            s = s * 1103515245u + 12345u;
+            input[i] = kind == 0 ? (int)(s >> 1) : (int)((s >> 8) % 6);
+        }
+        printf("\n  %s\n", kind == 0 ? "random" : "0..5");
+
+        sorted = input;
+        double t = omp_get_wtime();
+        parallel_quicksort(sorted.data(), n);
+        double full = omp_get_wtime() - t;
+        bool ok = is_sorted(sorted.begin(), sorted.end());
+        report("full sort", "parallel_quicksort", full, full, ok);
+
+        /* The median */
+        long m = n / 2;
+        x = input;
+        t = omp_get_wtime();
+        nth_element(x.begin(), x.begin() + m, x.end());
+        t = omp_get_wtime() - t;
+        report("median", "std::nth_element (serial)", t, full, selected(x, m, sorted));
+        x = input;
+        t = omp_get_wtime();
+        parallel_nth_element(x.data(), n, m);
+        t = omp_get_wtime() - t;
+        report("median", "parallel_nth_element", t, full, selected(x, m, sorted));
+
+        /* The k smallest, in order */
+        x = input;
+        t = omp_get_wtime();
+        partial_sort(x.begin(), x.begin() + k, x.end());
+        t = omp_get_wtime() - t;
+        report("k smallest, sorted", "std::partial_sort (serial)", t, full,
+               equal(x.begin(), x.begin() + k, sorted.begin()));
+        x = input;
+        t = omp_get_wtime();
+        parallel_partial_sort(x.data(), n, k);
+        t = omp_get_wtime() - t;
+        report("k smallest, sorted", "parallel_partial_sort", t, full,
+               equal(x.begin(), x.begin() + k, sorted.begin()));
+
+        /* The k largest, largest first, without changing the input */
+        vector<int> top(k);
+        t = omp_get_wtime();
+        parallel_top_k(input.data(), n, k, top.data());
+        t = omp_get_wtime() - t;
+        report("k largest, sorted", "parallel_top_k (streaming)", t, full,
+               equal(top.begin(), top.end(), sorted.rbegin()));
+    }
+    return 0;
+}
@@ -0,0 +1,329 @@
+#ifndef SPMV_H
+#define SPMV_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+/*
+ * Sparse matrix-vector multiply y = A * x in three storage formats.
+ *
+ *  CSR         row pointers, column indices and values, row after row. Each row is a
+ *              sparse dot product: the dense dot-product loop with x gathered through
+ *              the column indices.
+ *  ELLPACK     every row padded to the longest row and stored column by column, so
+ *              consecutive rows sit in consecutive memory and vectorize across rows.
+ *              Wastes memory when row lengths vary.
+ *  SELL-C-s    rows sorted by length within windows of s rows, then cut into chunks of
+ *              C rows, each padded only to its own longest row (Kreutzer et al.).
+ *
+ * Threads get contiguous ranges of rows (or chunks) holding about the same number of
+ * nonzeros, not the same number of rows. The inner loops are `omp simd`, so compilers
+ * emit gather instructions where the target has them (e.g. -mavx2 or -mavx512f).
+ */
+
+/* Coordinate (triplet) form, as read from a Matrix Market file; indices are 0-based */
+struct Coo {
+    int nrows = 0, ncols = 0;
+    std::vector<int> row, col;
+    std::vector<double> val;
+};
+
+struct Csr {
+    int nrows = 0, ncols = 0;
+    std::vector<long> rowptr;   /* nrows + 1 */
+    std::vector<int> col;
+    std::vector<double> val;
+    std::vector<int> part;      /* row bounds per thread, balanced by nonzeros */
+};
+
+struct Ell {
+    int nrows = 0, ncols = 0, width = 0;
+    std::vector<int> col;       /* width x nrows, column-major; padding has col 0, val 0 */
+    std::vector<double> val;
+};
+
+struct Sell {
+    int nrows = 0, ncols = 0, C = 8, sigma = 1, nchunks = 0;
+    std::vector<long> chunkptr; /* start of each chunk in col/val, nchunks + 1 */
+    std::vector<int> width;     /* longest row of each chunk */
+    std::vector<int> perm;      /* original row of each sorted row, -1 for padding rows */
+    std::vector<int> col;       /* chunk by chunk, each width x C column-major */
+    std::vector<double> val;
+    std::vector<int> part;      /* chunk bounds per thread, balanced by stored entries */
+};
+
+/* Read a Matrix Market "coordinate" file (real, integer or pattern; general or
+   symmetric). Symmetric files are expanded to both triangles. Returns 0 on success. */
+inline int read_matrix_market(const char *path, Coo &a) {
+    char line[1024], object[64], format[64], field[64], symmetry[64];
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return -1;
+    }
+    if (!fgets(line, sizeof(line), f) ||
+        sscanf(line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) != 4 ||
+        strcmp(format, "coordinate") != 0 || strcmp(field, "complex") == 0) {
+        fprintf(stderr, "%s: not a real coordinate Matrix Market file\n", path);
+        fclose(f);
+        return -1;
+    }
+    bool pattern = strcmp(field, "pattern") == 0;
+    bool symmetric = strcmp(symmetry, "general") != 0;
+    long nnz = 0;
+    do {
+        if (!fgets(line, sizeof(line), f)) {
+            fclose(f);
+            return -1;
+        }
+    } while (line[0] == '%');
+    if (sscanf(line, "%d %d %ld", &a.nrows, &a.ncols, &nnz) != 3) {
+        fprintf(stderr, "%s: bad size line\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    a.row.clear(); a.col.clear(); a.val.clear();
+    a.row.reserve(symmetric ? 2 * nnz : nnz);
+    a.col.reserve(symmetric ? 2 * nnz : nnz);
+    a.val.reserve(symmetric ? 2 * nnz : nnz);
+    for (long e = 0; e < nnz; e++) {
+        int i, j;
+        double v = 1.0;
+        if (fscanf(f, "%d %d", &i, &j) != 2 || (!pattern && fscanf(f, "%lf", &v) != 1)) {
+            fprintf(stderr, "%s: entry %ld is malformed\n", path, e + 1);
+            fclose(f);
+            return -1;
+        }
+        a.row.push_back(i - 1); a.col.push_back(j - 1); a.val.push_back(v);
+        if (symmetric && i != j) {
+            a.row.push_back(j - 1); a.col.push_back(i - 1);
+            a.val.push_back(strcmp(symmetry, "skew-symmetric") == 0 ? -v : v);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+/* Split rows [0, nrows) into `parts` ranges of about equal cost, where a row costs its
+   number of entries plus one (the row itself: loading rowptr and storing y) */
+inline std::vector<int> partition_by_nnz(const std::vector<long> &ptr, int nrows, int parts) {
+    std::vector<int> bounds(parts + 1, nrows);
+    long total = ptr[nrows] + nrows;
+    bounds[0] = 0;
+    for (int t = 1; t < parts; t++) {
+        long target = total * t / parts;
+        int lo = bounds[t - 1], hi = nrows;
+        while (lo < hi) {               /* first row r with ptr[r] + r >= target */
+            int mid = lo + (hi - lo) / 2;
+            if (ptr[mid] + mid < target)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        bounds[t] = lo;
+    }
+    return bounds;
+}
+
+/* COO -> CSR by counting sort on rows; columns are sorted within each row */
+inline void coo_to_csr(const Coo &a, Csr &m) {
+    long nnz = a.val.size();
+    m.nrows = a.nrows;
+    m.ncols = a.ncols;
+    m.rowptr.assign(a.nrows + 1, 0);
+    m.col.resize(nnz);
+    m.val.resize(nnz);
+    for (long e = 0; e < nnz; e++)
+        m.rowptr[a.row[e] + 1]++;
+    for (int i = 0; i < a.nrows; i++)
+        m.rowptr[i + 1] += m.rowptr[i];
+    std::vector<long> next(m.rowptr.begin(), m.rowptr.end() - 1);
+    for (long e = 0; e < nnz; e++) {
+        long k = next[a.row[e]]++;
+        m.col[k] = a.col[e];
+        m.val[k] = a.val[e];
+    }
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < m.nrows; i++) {
+        long b = m.rowptr[i], len = m.rowptr[i + 1] - b;
+        std::vector<std::pair<int, double>> r(len);
+        for (long k = 0; k < len; k++)
+            r[k] = std::make_pair(m.col[b + k], m.val[b + k]);
+        std::sort(r.begin(), r.end(),
+                  [](const std::pair<int, double> &p, const std::pair<int, double> &q) {
+                      return p.first < q.first;
+                  });
+        for (long k = 0; k < len; k++) {
+            m.col[b + k] = r[k].first;
+            m.val[b + k] = r[k].second;
+        }
+    }
+    m.part = partition_by_nnz(m.rowptr, m.nrows, omp_get_max_threads());
+}
+
+/* Sparse dot product of one CSR row with x */
+inline double csr_row_dot(const long *rowptr, const int *col, const double *val,
+                          const double *x, int i) {
+    double sum = 0.0;
+    #pragma omp simd reduction(+ : sum)
+    for (long k = rowptr[i]; k < rowptr[i + 1]; k++)
+        sum += val[k] * x[col[k]];
+    return sum;
+}
+
+/* y = A * x, every thread taking the same number of rows */
+inline void spmv_csr_by_rows(const Csr &m, const double *x, double *y) {
+    const long *rowptr = m.rowptr.data();
+    const int *col = m.col.data();
+    const double *val = m.val.data();
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < m.nrows; i++)
+        y[i] = csr_row_dot(rowptr, col, val, x, i);
+}
+
+/* y = A * x, every thread taking rows holding the same number of nonzeros */
+inline void spmv_csr(const Csr &m, const double *x, double *y) {
+    const long *rowptr = m.rowptr.data();
+    const int *col = m.col.data();
+    const double *val = m.val.data();
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        int r0 = m.part[(long)t * (m.part.size() - 1) / nt];
+        int r1 = m.part[(long)(t + 1) * (m.part.size() - 1) / nt];
+        for (int i = r0; i < r1; i++)
+            y[i] = csr_row_dot(rowptr, col, val, x, i);
+    }
+}
+
+/* CSR -> ELLPACK; returns -1 without converting if padding would exceed `max_fill`
+   times the number of nonzeros */
+inline int csr_to_ell(const Csr &m, Ell &e, double max_fill) {
+    int width = 0;
+    for (int i = 0; i < m.nrows; i++)
+        width = std::max(width, (int)(m.rowptr[i + 1] - m.rowptr[i]));
+    if ((double)width * m.nrows > max_fill * std::max(m.rowptr[m.nrows], 1L))
+        return -1;
+    e.nrows = m.nrows;
+    e.ncols = m.ncols;
+    e.width = width;
+    e.col.assign((size_t)width * m.nrows, 0);
+    e.val.assign((size_t)width * m.nrows, 0.0);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < m.nrows; i++)
+        for (long k = m.rowptr[i]; k < m.rowptr[i + 1]; k++) {
+            e.col[(k - m.rowptr[i]) * m.nrows + i] = m.col[k];
+            e.val[(k - m.rowptr[i]) * m.nrows + i] = m.val[k];
+        }
+    return 0;
+}
+
+/* y = A * x for ELLPACK: vectorized across rows, every row has the same length */
+inline void spmv_ell(const Ell &e, const double *x, double *y) {
+    const int *col = e.col.data();
+    const double *val = e.val.data();
+    long n = e.nrows;
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < n; i++) {
+        double sum = 0.0;
+        for (int j = 0; j < e.width; j++)
+            sum += val[j * n + i] * x[col[j * n + i]];
+        y[i] = sum;
+    }
+}
+
+/* CSR -> SELL-C-sigma; sigma is rounded up to a multiple of C */
+inline void csr_to_sell(const Csr &m, Sell &s, int C, int sigma) {
+    sigma = std::max(C, (sigma + C - 1) / C * C);
+    s.nrows = m.nrows;
+    s.ncols = m.ncols;
+    s.C = C;
+    s.sigma = sigma;
+    s.nchunks = (m.nrows + C - 1) / C;
+    s.perm.assign((size_t)s.nchunks * C, -1);
+    for (int i = 0; i < m.nrows; i++)
+        s.perm[i] = i;
+
+    /* Sort rows by decreasing length inside each window of sigma rows */
+    auto len = [&](int i) { return m.rowptr[i + 1] - m.rowptr[i]; };
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int w = 0; w < m.nrows; w += sigma)
+        std::stable_sort(s.perm.begin() + w, s.perm.begin() + std::min(w + sigma, m.nrows),
+                         [&](int a, int b) { return len(a) > len(b); });
+
+    s.width.assign(s.nchunks, 0);
+    s.chunkptr.assign(s.nchunks + 1, 0);
+    for (int c = 0; c < s.nchunks; c++) {
+        for (int r = 0; r < C; r++)
+            if (s.perm[c * C + r] >= 0)
+                s.width[c] = std::max(s.width[c], (int)len(s.perm[c * C + r]));
+        s.chunkptr[c + 1] = s.chunkptr[c] + (long)s.width[c] * C;
+    }
+    s.col.assign(s.chunkptr[s.nchunks], 0);
+    s.val.assign(s.chunkptr[s.nchunks], 0.0);
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < s.nchunks; c++)
+        for (int r = 0; r < C; r++) {
+            int i = s.perm[c * C + r];
+            if (i < 0)
+                continue;
+            for (long k = m.rowptr[i]; k < m.rowptr[i + 1]; k++) {
+                long at = s.chunkptr[c] + (k - m.rowptr[i]) * C + r;
+                s.col[at] = m.col[k];
+                s.val[at] = m.val[k];
+            }
+        }
+
+    /* Chunks cost their stored entries plus their rows */
+    std::vector<long> cost(s.nchunks + 1);
+    for (int c = 0; c <= s.nchunks; c++)
+        cost[c] = s.chunkptr[c] + (long)(C - 1) * c;
+    s.part = partition_by_nnz(cost, s.nchunks, omp_get_max_threads());
+}
+
+/* y = A * x for SELL-C-sigma: C rows at a time, vectorized across the rows of a chunk */
+template <int C>
+inline void spmv_sell_c(const Sell &s, const double *x, double *y) {
+    const int *col = s.col.data(), *perm = s.perm.data();
+    const double *val = s.val.data();
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        int c0 = s.part[(long)t * (s.part.size() - 1) / nt];
+        int c1 = s.part[(long)(t + 1) * (s.part.size() - 1) / nt];
+        for (int c = c0; c < c1; c++) {
+            double sum[C] = {0.0};
+            const int *cc = col + s.chunkptr[c];
+            const double *vv = val + s.chunkptr[c];
+            for (int j = 0; j < s.width[c]; j++) {
+                #pragma omp simd
+                for (int r = 0; r < C; r++)
+                    sum[r] += vv[j * C + r] * x[cc[j * C + r]];
+            }
+            for (int r = 0; r < C; r++)
+                if (perm[c * C + r] >= 0)
+                    y[perm[c * C + r]] = sum[r];
+        }
+    }
+}
+
+/* Dispatch to a kernel compiled for the chunk height; C = 4, 8, 16 or 32 */
+inline void spmv_sell(const Sell &s, const double *x, double *y) {
+    switch (s.C) {
+    case 4:  spmv_sell_c<4>(s, x, y); break;
+    case 8:  spmv_sell_c<8>(s, x, y); break;
+    case 16: spmv_sell_c<16>(s, x, y); break;
+    case 32: spmv_sell_c<32>(s, x, y); break;
+    default:
+        fprintf(stderr, "spmv_sell: unsupported chunk height %d\n", s.C);
+        abort();
+    }
+}
+
+#endif
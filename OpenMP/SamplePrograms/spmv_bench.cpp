@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "spmv.h"
+
+#define GRID       1000      /* Default 2D Laplacian: GRID x GRID unknowns */
+#define ROWS       1000000   /* Default rows of the power-law matrix */
+#define REPS       50        /* Default multiplies timed per format */
+#define MAX_FILL   4.0       /* Skip ELLPACK when padding would store more than this x nnz */
+
+using namespace std;
+
+/* 5-point Laplacian on an n x n grid: 4 on the diagonal, -1 for each neighbour */
+void laplace2d(int n, Coo &a) {
+    a.nrows = a.ncols = n * n;
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) {
+            int r = i * n + j;
+            const int di[5] = {-1, 0, 0, 0, 1}, dj[5] = {0, -1, 0, 1, 0};
+            for (int d = 0; d < 5; d++) {
+                int ii = i + di[d], jj = j + dj[d];
+                if (ii < 0 || ii >= n || jj < 0 || jj >= n)
+                    continue;
+                a.row.push_back(r);
+                a.col.push_back(ii * n + jj);
+                a.val.push_back(d == 2 ? 4.0 : -1.0);
+            }
+        }
+}
+
+/* Row lengths from a Pareto distribution (most rows have a few entries, a few rows have
+   thousands), half of each row near the diagonal and half scattered. The longest 5% of
+   the rows come first, as in a graph numbered by degree, so equal row counts per thread
+   give very unequal work. */
+void powerlaw(int n, Coo &a) {
+    unsigned long long s = 88172645463325252ULL;
+    auto next = [&s]() {
+        s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+        return s;
+    };
+    vector<int> lens(n);
+    for (int i = 0; i < n; i++) {
+        double u = (next() % 1000000 + 1) / 1e6;
+        lens[i] = (int)min(4096.0, 2.0 / pow(u, 1.0 / 1.5));
+    }
+    nth_element(lens.begin(), lens.begin() + n / 20, lens.end(), greater<int>());
+
+    a.nrows = a.ncols = n;
+    for (int i = 0; i < n; i++) {
+        int len = lens[i];
+        a.row.push_back(i); a.col.push_back(i); a.val.push_back(len + 1.0);
+        for (int k = 1; k < len; k++) {
+            int j = (k % 2) ? (int)((i + next() % 64) % n) : (int)(next() % n);
+            a.row.push_back(i); a.col.push_back(j); a.val.push_back(-1.0 / len);
+        }
+    }
+}
+
+/* Largest share of the work of any thread over the average, for a partition of rows */
+double imbalance(const Csr &m, const vector<int> &bounds) {
+    long most = 0;
+    for (size_t t = 0; t + 1 < bounds.size(); t++)
+        most = max(most, m.rowptr[bounds[t + 1]] - m.rowptr[bounds[t]]);
+    return most / ((double)m.rowptr[m.nrows] / (bounds.size() - 1));
+}
+
+/* Average seconds per multiply over `reps` after one warm-up multiply */
+template <typename F>
+double timed(int reps, F f) {
+    f();
+    double t = omp_get_wtime();
+    for (int r = 0; r < reps; r++)
+        f();
+    return (omp_get_wtime() - t) / reps;
+}
+
+void report(const char *name, long stored, long nnz, double bytes, double t,
+            const vector<double> &y, const vector<double> &ref) {
+    double err = 0.0, scale = 0.0;
+    for (size_t i = 0; i < y.size(); i++) {
+        err = max(err, fabs(y[i] - ref[i]));
+        scale = max(scale, fabs(ref[i]));
+    }
+    printf("  %-16s %6.2f %10.3f %9.2f %9.2f   %.1e\n", name, (double)stored / nnz,
+           t * 1e3, 2.0 * nnz / t / 1e9, bytes / t / 1e9, err / max(scale, 1e-300));
+}
+
+void bench(const char *label, const Coo &a, int reps) {
+    Csr m;
+    coo_to_csr(a, m);
+    long nnz = m.rowptr[m.nrows];
+    int nt = omp_get_max_threads();
+    vector<double> x(m.ncols), y(m.nrows), ref(m.nrows);
+    for (int j = 0; j < m.ncols; j++)
+        x[j] = 1.0 + (j % 17) * 0.125;
+
+    /* Serial reference */
+    for (int i = 0; i < m.nrows; i++) {
+        double sum = 0.0;
+        for (long k = m.rowptr[i]; k < m.rowptr[i + 1]; k++)
+            sum += m.val[k] * x[m.col[k]];
+        ref[i] = sum;
+    }
+
+    vector<int> by_rows(nt + 1);
+    for (int t = 0; t <= nt; t++)
+        by_rows[t] = (int)((long)m.nrows * t / nt);
+    long maxrow = 0;
+    for (int i = 0; i < m.nrows; i++)
+        maxrow = max(maxrow, m.rowptr[i + 1] - m.rowptr[i]);
+    printf("\n%s: %d x %d, %ld nonzeros (%.1f per row, longest %ld), %d threads\n", label,
+           m.nrows, m.ncols, nnz, (double)nnz / m.nrows, maxrow, nt);
+    printf("  nonzeros on the busiest thread / average: %.2f by rows, %.2f by nonzeros\n",
+           imbalance(m, by_rows), imbalance(m, m.part));
+    printf("  %-16s %6s %10s %9s %9s   %s\n", "format", "fill", "ms", "GFLOP/s", "GB/s",
+           "rel. error");
+
+    /* Bytes each multiply must move at least: matrix storage, x once, y once */
+    double vec_bytes = 8.0 * (m.nrows + m.ncols);
+    double csr_bytes = 12.0 * nnz + 8.0 * (m.nrows + 1) + vec_bytes;
+    double t = timed(reps, [&] { spmv_csr_by_rows(m, x.data(), y.data()); });
+    report("CSR (by rows)", nnz, nnz, csr_bytes, t, y, ref);
+    t = timed(reps, [&] { spmv_csr(m, x.data(), y.data()); });
+    report("CSR (by nnz)", nnz, nnz, csr_bytes, t, y, ref);
+
+    Ell e;
+    if (csr_to_ell(m, e, MAX_FILL) == 0) {
+        long stored = (long)e.width * e.nrows;
+        t = timed(reps, [&] { spmv_ell(e, x.data(), y.data()); });
+        report("ELLPACK", stored, nnz, 12.0 * stored + vec_bytes, t, y, ref);
+    } else {
+        printf("  %-16s skipped: padding every row to %ld entries would store %.0f x nnz\n",
+               "ELLPACK", maxrow, (double)maxrow * m.nrows / nnz);
+    }
+
+    const int sigmas[3] = {1, 32, 1024};
+    for (int C : {4, 8, 16}) {
+        for (int sigma : sigmas) {
+            Sell s;
+            char name[32];
+            csr_to_sell(m, s, C, sigma);
+            long stored = s.chunkptr[s.nchunks];
+            snprintf(name, sizeof(name), "SELL-%d-%d", C, s.sigma);
+            t = timed(reps, [&] { spmv_sell(s, x.data(), y.data()); });
+            report(name, stored, nnz,
+                   12.0 * stored + 12.0 * s.nchunks + 4.0 * m.nrows + vec_bytes, t, y, ref);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *which = (argc > 1) ? argv[1] : "all";
+    int size = (argc > 2) ? atoi(argv[2]) : 0;
+    int reps = (argc > 3) ? atoi(argv[3]) : REPS;
+    int numThreads = (argc > 4) ? atoi(argv[4]) : 0;
+
+    if (numThreads > 0) {
+        omp_set_dynamic(0);
+        omp_set_num_threads(numThreads);
+    }
+
+    if (!strcmp(which, "all") || !strcmp(which, "laplace")) {
+        Coo a;
+        int n = size > 0 ? size : GRID;
+        laplace2d(n, a);
+        bench("2D Laplacian", a, reps);
+    }
+    if (!strcmp(which, "all") || !strcmp(which, "powerlaw")) {
+        Coo a;
+        powerlaw(size > 0 ? size : ROWS, a);
+        bench("Power-law rows", a, reps);
+    }
+    if (strcmp(which, "all") && strcmp(which, "laplace") && strcmp(which, "powerlaw")) {
+        Coo a;
+        if (read_matrix_market(which, a) != 0)
+            return 1;
+        bench(which, a, reps);
+    }
+    return 0;
+}
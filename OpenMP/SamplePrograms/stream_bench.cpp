@@ -0,0 +1,120 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include <string>
+#include <vector>
+#include "stream_reduce.h"
+
+#define CHUNK_MB  64         /* Default bytes per file per chunk */
+#define BLOCK     (1 << 20)  /* Doubles per write of gen */
+
+using namespace std;
+
+/*
+ * The reductions of stream_reduce.h over the vectors of dot_product.cpp, stored in files.
+ *
+ *   ./stream_bench gen DIR N                     writes DIR/x.bin and DIR/y.bin, N doubles each
+ *   ./stream_bench run DIR [chunk MB] [threads]
+ *
+ * x[i] = (i + 1) f and y[i] = 6 (i + 1) f with f = 1 / sqrt(2 n^2 + 3 n + 1), so the dot
+ * product is exactly n, and the other results have closed forms that every run is checked
+ * against. Each reduction runs four ways: read with pread or mmap, from the page cache
+ * after a warm-up pass ("cached"), or from the disk, with O_DIRECT or after the file's
+ * cached pages are dropped ("disk").
+ */
+
+double factor(long n) {
+    return 1.0 / sqrt(2.0 * n * n + 3.0 * n + 1.0);
+}
+
+int gen(const string &dir, long n) {
+    double f = factor(n);
+    for (int v = 0; v < 2; v++) {
+        string name = dir + (v == 0 ? "/x.bin" : "/y.bin");
+        FILE *out = fopen(name.c_str(), "wb");
+        if (!out) {
+            perror(name.c_str());
+            return 1;
+        }
+        vector<double> buf(BLOCK);
+        for (long i = 0; i < n; i += BLOCK) {
+            long m = min<long>(BLOCK, n - i);
+            for (long j = 0; j < m; j++)
+                buf[j] = (i + j + 1) * (v == 0 ? 1 : 6) * f;
+            if (fwrite(buf.data(), sizeof(double), m, out) != (size_t)m) {
+                perror(name.c_str());
+                fclose(out);
+                return 1;
+            }
+        }
+        if (fclose(out) != 0) {
+            perror(name.c_str());
+            return 1;
+        }
+        printf("\n  %s: %ld doubles, %.0f MiB", name.c_str(), n, n * 8.0 / (1 << 20));
+    }
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 3 && !strcmp(argv[1], "gen"))
+        return gen(argv[2], atol(argv[3]));
+    if (argc < 3 || strcmp(argv[1], "run")) {
+        fprintf(stderr, "usage: %s gen DIR N | run DIR [chunk MB] [threads]\n", argv[0]);
+        return 1;
+    }
+    string x = string(argv[2]) + "/x.bin", y = string(argv[2]) + "/y.bin";
+    size_t chunk = (size_t)((argc > 3) ? atol(argv[3]) : CHUNK_MB) << 20;
+    int numThreads = (argc > 4) ? atoi(argv[4]) : omp_get_max_threads();
+    if (numThreads < 1) {
+        fprintf(stderr, "%s: threads must be at least 1\n", argv[0]);
+        return 1;
+    }
+    omp_set_dynamic(0);
+
+    const char *sources[] = {"pread, cached", "pread, O_DIRECT", "mmap, cached", "mmap, disk"};
+    const char *ops[] = {"sum", "dot", "min", "max", "norm"};
+    bool ok_all = true;
+    for (int src = 0; src < 4; src++) {
+        StreamOptions opt = {chunk, src >= 2, src == 1, numThreads};
+        bool cached = src == 0 || src == 2;
+        StreamReport rep;
+        if (cached) {
+            stream_sum(x.c_str(), opt, rep);
+            stream_sum(y.c_str(), opt, rep);
+        }
+        if (src == 0)
+            printf("\n  n = %ld doubles per file, chunks of %zu MiB, %d threads\n", rep.n, chunk >> 20,
+                   numThreads);
+        printf("\n  %-16s %-5s %16s %8s %8s %9s %8s  %-14s %s\n", "source", "op", "value", "seconds",
+               "MiB/s", "compute", "I/O wait", "bound", "correct");
+        for (int op = 0; op < 5; op++) {
+            if (!cached) {
+                stream_drop_cache(x.c_str());
+                stream_drop_cache(y.c_str());
+            }
+            bool ok;
+            switch (op) {
+            case 0: ok = stream_sum(x.c_str(), opt, rep); break;
+            case 1: ok = stream_dot(x.c_str(), y.c_str(), opt, rep); break;
+            case 2: ok = stream_min(x.c_str(), opt, rep); break;
+            case 3: ok = stream_max(x.c_str(), opt, rep); break;
+            default: ok = stream_norm(x.c_str(), opt, rep); break;
+            }
+            double n = rep.n, f = factor(rep.n);
+            double expect[] = {f * n * (n + 1) / 2, n, f, n * f, sqrt(n / 6)};
+            ok = ok && fabs(rep.value - expect[op]) <= 1e-9 * fabs(expect[op]);
+            ok_all = ok_all && ok;
+            double mib = rep.n * 8.0 * (op == 1 ? 2 : 1) / (1 << 20);
+            printf("  %-16s %-5s %16.10g %8.3f %8.0f %9.3f %8.3f  %-14s %s\n", sources[src], ops[op],
+                   rep.value, rep.seconds, mib / rep.seconds, rep.compute_seconds, rep.io_wait_seconds,
+                   rep.io_bound ? "I/O-bound" : "compute-bound", ok ? "yes" : "NO");
+        }
+    }
+    return ok_all ? 0 : 1;
+}
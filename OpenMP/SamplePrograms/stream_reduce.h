@@ -0,0 +1,269 @@
+#ifndef STREAM_REDUCE_H
+#define STREAM_REDUCE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/*
+ * Reductions over vectors of doubles stored in binary files too large to load, done one
+ * chunk at a time while the next chunk is brought in.
+ *
+ *   StreamOptions opt = {64 << 20, false, true, 4};   chunk bytes, mmap, O_DIRECT, threads
+ *   StreamReport rep;
+ *   stream_dot("x.bin", "y.bin", opt, rep);           rep.value is the dot product
+ *
+ * stream_sum, stream_min, stream_max and stream_norm take one file. All of them run on
+ * stream_reduce, which takes any kernel over aligned chunks of one or more files of equal
+ * length. The kernels open their parallel regions with num_threads(opt.threads), at
+ * least one, and leave the caller's OpenMP settings alone; a kernel of one's own should
+ * do the same.
+ *
+ * Reading uses two buffers per file: a helper thread preads chunk i + 1 while the OpenMP
+ * threads reduce chunk i with a simd reduction. With O_DIRECT the reads bypass the page
+ * cache, and the buffers and chunk sizes are multiples of SR_ALIGN. With mmap the files
+ * are mapped whole, and the helper thread touches every page of chunk i + 1 so that its
+ * page faults, and the reads they start, happen while chunk i is reduced.
+ *
+ * The report splits the time into reducing and waiting for the helper. A run that waited
+ * for more than SR_IO_BOUND of its time was I/O-bound: a faster kernel or more threads
+ * would not have made it faster. Otherwise the I/O was hidden and it was compute-bound.
+ */
+
+#define SR_ALIGN     4096   /* O_DIRECT alignment */
+#define SR_PAGE      4096   /* Stride of the mmap helper's touches */
+#define SR_IO_BOUND  0.05   /* Fraction of the time spent waiting that makes a run I/O-bound */
+
+struct StreamOptions {
+    size_t chunk;   /* bytes per file per chunk */
+    bool use_mmap;
+    bool direct;    /* O_DIRECT for reads, ignored with mmap */
+    int threads;
+};
+
+struct StreamReport {
+    double value;
+    long n;                      /* elements per file */
+    double seconds;
+    double compute_seconds;      /* in the kernel */
+    double io_wait_seconds;      /* waiting for the next chunk */
+    bool io_bound;
+};
+
+/* Drops the cached pages of a file, so the next pass reads it from disk */
+inline void stream_drop_cache(const char *name) {
+    int fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/* Reads until `bytes` or the end of the file; returns the bytes read or -1 */
+inline ssize_t sr_pread(int fd, void *buf, size_t bytes, off_t off) {
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t r = pread(fd, (char *)buf + done, bytes - done, off + done);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        done += r;
+    }
+    return done;
+}
+
+/* kernel(const double *const *v, long m) reduces elements [0, m) of every file's chunk;
+   the caller keeps the result in whatever the kernel captures */
+template <typename Kernel>
+bool stream_reduce(const std::vector<const char *> &files, const StreamOptions &opt,
+                   Kernel kernel, StreamReport &rep) {
+    if (opt.threads <= 0) {
+        fprintf(stderr, "stream_reduce: needs at least one thread, not %d\n", opt.threads);
+        return false;
+    }
+    int k = files.size();
+    std::vector<int> fds(k, -1);
+    long n = -1;
+    bool ok = true;
+    for (int f = 0; f < k && ok; f++) {
+        fds[f] = open(files[f], O_RDONLY | (opt.direct && !opt.use_mmap ? O_DIRECT : 0));
+        struct stat st;
+        if (fds[f] < 0 || fstat(fds[f], &st) != 0) {
+            perror(files[f]);
+            ok = false;
+        } else if (st.st_size % sizeof(double) != 0 || (n >= 0 && n != (long)(st.st_size / sizeof(double)))) {
+            fprintf(stderr, "%s: size is not the same number of doubles\n", files[f]);
+            ok = false;
+        } else {
+            n = st.st_size / sizeof(double);
+        }
+    }
+    size_t chunk_bytes = std::max<size_t>(opt.chunk / SR_ALIGN * SR_ALIGN, SR_ALIGN);
+    long chunk = chunk_bytes / sizeof(double);
+    long nchunks = ok ? (n + chunk - 1) / chunk : 0;
+    auto count = [&](long c) { return std::min(chunk, n - c * chunk); };
+
+    /* The chunk i pointers of every file, and the step that prepares chunk i + 1 */
+    std::vector<const double *> cur(k);
+    std::vector<double *> bufs;
+    std::vector<const double *> maps(k, nullptr);
+    std::vector<char> read_ok(2, 1);
+    auto prepare = [&](long c) {
+        for (int f = 0; f < k; f++) {
+            if (opt.use_mmap) {
+                volatile const char *p = (const char *)(maps[f] + c * chunk);
+                long bytes = count(c) * sizeof(double);
+                char sink = 0;
+                for (long b = 0; b < bytes; b += SR_PAGE)
+                    sink ^= p[b];
+                (void)sink;
+            } else {
+                double *b = bufs[2 * f + c % 2];
+                read_ok[c % 2] = read_ok[c % 2] &&
+                    sr_pread(fds[f], b, chunk_bytes, (off_t)c * chunk_bytes) >= (ssize_t)(count(c) * sizeof(double));
+            }
+        }
+    };
+    if (ok && nchunks > 0) {
+        if (opt.use_mmap) {
+            for (int f = 0; f < k && ok; f++) {
+                void *m = mmap(nullptr, n * sizeof(double), PROT_READ, MAP_SHARED, fds[f], 0);
+                ok = m != MAP_FAILED;
+                if (ok) {
+                    maps[f] = (const double *)m;
+                    madvise(m, n * sizeof(double), MADV_SEQUENTIAL);
+                }
+            }
+        } else {
+            bufs.resize(2 * k);
+            for (double *&b : bufs)
+                b = (double *)aligned_alloc(SR_ALIGN, chunk_bytes);
+        }
+    }
+
+    double t = omp_get_wtime(), compute = 0, wait = 0;
+    if (ok && nchunks > 0) {
+        double tw = omp_get_wtime();
+        prepare(0);
+        wait += omp_get_wtime() - tw;
+    }
+    for (long c = 0; c < nchunks && ok; c++) {
+        read_ok[(c + 1) % 2] = 1;
+        std::thread helper;
+        if (c + 1 < nchunks)
+            helper = std::thread(prepare, c + 1);
+        for (int f = 0; f < k; f++)
+            cur[f] = opt.use_mmap ? maps[f] + c * chunk : bufs[2 * f + c % 2];
+        ok = read_ok[c % 2];
+        double tc = omp_get_wtime();
+        if (ok)
+            kernel(cur.data(), count(c));
+        double tw = omp_get_wtime();
+        compute += tw - tc;
+        if (helper.joinable())
+            helper.join();
+        wait += omp_get_wtime() - tw;
+    }
+    t = omp_get_wtime() - t;
+
+    for (int f = 0; f < k; f++) {
+        if (maps[f])
+            munmap((void *)maps[f], n * sizeof(double));
+        if (fds[f] >= 0)
+            close(fds[f]);
+    }
+    for (double *b : bufs)
+        free(b);
+    rep.n = n;
+    rep.seconds = t;
+    rep.compute_seconds = compute;
+    rep.io_wait_seconds = wait;
+    rep.io_bound = wait > SR_IO_BOUND * t;
+    return ok;
+}
+
+inline bool stream_sum(const char *x, const StreamOptions &opt, StreamReport &rep) {
+    double sum = 0;
+    bool ok = stream_reduce({x}, opt, [&](const double *const *v, long m) {
+        const double *a = v[0];
+        double s = 0;
+        #pragma omp parallel for simd reduction(+:s) num_threads(opt.threads)
+        for (long i = 0; i < m; i++)
+            s += a[i];
+        sum += s;
+    }, rep);
+    rep.value = sum;
+    return ok;
+}
+
+inline bool stream_dot(const char *x, const char *y, const StreamOptions &opt, StreamReport &rep) {
+    double dot = 0;
+    bool ok = stream_reduce({x, y}, opt, [&](const double *const *v, long m) {
+        const double *a = v[0], *b = v[1];
+        double s = 0;
+        #pragma omp parallel for simd reduction(+:s) num_threads(opt.threads)
+        for (long i = 0; i < m; i++)
+            s += a[i] * b[i];
+        dot += s;
+    }, rep);
+    rep.value = dot;
+    return ok;
+}
+
+inline bool stream_min(const char *x, const StreamOptions &opt, StreamReport &rep) {
+    double lo = INFINITY;
+    bool ok = stream_reduce({x}, opt, [&](const double *const *v, long m) {
+        const double *a = v[0];
+        double s = INFINITY;
+        #pragma omp parallel for simd reduction(min:s) num_threads(opt.threads)
+        for (long i = 0; i < m; i++)
+            s = std::min(s, a[i]);
+        lo = std::min(lo, s);
+    }, rep);
+    rep.value = lo;
+    return ok;
+}
+
+inline bool stream_max(const char *x, const StreamOptions &opt, StreamReport &rep) {
+    double hi = -INFINITY;
+    bool ok = stream_reduce({x}, opt, [&](const double *const *v, long m) {
+        const double *a = v[0];
+        double s = -INFINITY;
+        #pragma omp parallel for simd reduction(max:s) num_threads(opt.threads)
+        for (long i = 0; i < m; i++)
+            s = std::max(s, a[i]);
+        hi = std::max(hi, s);
+    }, rep);
+    rep.value = hi;
+    return ok;
+}
+
+/* The Euclidean norm, as sqrt of the sum of squares */
+inline bool stream_norm(const char *x, const StreamOptions &opt, StreamReport &rep) {
+    double sq = 0;
+    bool ok = stream_reduce({x}, opt, [&](const double *const *v, long m) {
+        const double *a = v[0];
+        double s = 0;
+        #pragma omp parallel for simd reduction(+:s) num_threads(opt.threads)
+        for (long i = 0; i < m; i++)
+            s += a[i] * a[i];
+        sq += s;
+    }, rep);
+    rep.value = sqrt(sq);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include <omp.h>
+#include "lockfree.h"
+
+/*
+ * A dataflow task graph. Tasks are added in program order, each with the data it reads
+ * (in), writes (out) or updates (inout), named by address. Edges follow the rules of
+ * OpenMP's depend clause:
+ *  - a reader waits for the last writer of its data;
+ *  - a writer waits for every reader since that writer, or for the writer itself if
+ *    nobody has read the data since.
+ * Tasks then run as soon as their inputs are ready, not stage by stage.
+ *
+ *  run(p)      runs the graph on p threads. Ready tasks go to a WorkBag: a thread keeps
+ *              the tasks it makes ready on its own deque and steals when it runs dry.
+ *  run_omp(p)  hands the same graph to the OpenMP runtime as tasks with depend clauses.
+ *
+ * Both record when every task ran, so report() can compare the total work with the
+ * critical path: their ratio is the most speedup any number of threads could give.
+ * Work is the sum of the tasks' wall times in the run, so it also counts the time a
+ * thread was descheduled in the middle of a task; the speedup is taken from a serial
+ * time the caller measured instead.
+ */
+
+enum DepMode { DEP_IN, DEP_OUT, DEP_INOUT };
+
+struct Dep {
+    const void *addr;
+    DepMode mode;
+};
+
+inline Dep in(const void *p) { return {p, DEP_IN}; }
+inline Dep out(const void *p) { return {p, DEP_OUT}; }
+inline Dep inout(const void *p) { return {p, DEP_INOUT}; }
+
+class TaskGraph {
+public:
+    /* Returns the new task's id; tasks must be added in an order that runs correctly
+       sequentially, as with OpenMP tasks */
+    int add(const std::string &name, std::function<void()> fn, const std::vector<Dep> &deps) {
+        int id = (int)tasks.size();
+        tasks.push_back({name, std::move(fn), {}, {}, 0.0, 0.0});
+        for (const Dep &d : deps) {
+            Access &a = last[d.addr];
+            if (d.mode == DEP_IN) {
+                edge(a.writer, id);
+                a.readers.push_back(id);
+            } else {
+                if (a.readers.empty())
+                    edge(a.writer, id);
+                for (int r : a.readers)
+                    edge(r, id);
+                a.writer = id;
+                a.readers.clear();
+            }
+        }
+        return id;
+    }
+
+    int size() const { return (int)tasks.size(); }
+
+    /* Work-stealing executor; returns the elapsed seconds */
+    double run(int nthreads) {
+        int n = size();
+        std::unique_ptr<std::atomic<int>[]> pending(new std::atomic<int>[n]);
+        for (int i = 0; i < n; i++)
+            pending[i].store((int)tasks[i].preds.size(), std::memory_order_relaxed);
+        WorkBag<int> bag(nthreads);
+        std::atomic<int> remaining(n);
+        double t0 = omp_get_wtime();
+
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int tid = omp_get_thread_num();
+            for (int i = tid; i < n; i += nthreads)
+                if (tasks[i].preds.empty())
+                    bag.add(tid, i);
+            #pragma omp barrier
+            int i;
+            while (remaining.load(std::memory_order_acquire) > 0) {
+                if (!bag.take(tid, i)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                execute(i, t0);
+                for (int s : tasks[i].succs)
+                    if (pending[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        bag.add(tid, s);
+                remaining.fetch_sub(1, std::memory_order_release);
+            }
+        }
+        return elapsed = omp_get_wtime() - t0;
+    }
+
+    /* The same graph as OpenMP tasks: task i writes done[i] and reads done[p] for each
+       predecessor p, so the runtime sees exactly the edges built above */
+    double run_omp(int nthreads) {
+        int n = size();
+        std::vector<char> flags(n);
+        [[maybe_unused]] char *done = flags.data();    /* only named in depend clauses */
+        double t0 = omp_get_wtime();
+
+        #pragma omp parallel num_threads(nthreads)
+        #pragma omp single
+        for (int i = 0; i < n; i++) {
+            const int *p = tasks[i].preds.data();
+            int np = (int)tasks[i].preds.size();
+            #pragma omp task firstprivate(i) depend(iterator(k = 0:np), in: done[p[k]]) depend(out: done[i])
+            execute(i, t0);
+        }
+        return elapsed = omp_get_wtime() - t0;
+    }
+
+    /* Elapsed time of the last run and its speedup over `serial` seconds, then the
+       total work and critical path of its tasks */
+    void report(FILE *f, const char *label, double serial) const {
+        int n = size();
+        std::vector<double> finish(n);
+        std::vector<int> via(n, -1);
+        double work = 0.0, span = 0.0;
+        int last_task = -1;
+        long edges = 0;
+        for (int i = 0; i < n; i++) {               /* ids are a topological order */
+            double start = 0.0;
+            for (int p : tasks[i].preds)
+                if (finish[p] > start) {
+                    start = finish[p];
+                    via[i] = p;
+                }
+            double dur = tasks[i].end - tasks[i].start;
+            finish[i] = start + dur;
+            work += dur;
+            edges += tasks[i].preds.size();
+            if (finish[i] > span) {
+                span = finish[i];
+                last_task = i;
+            }
+        }
+        std::vector<int> path;
+        for (int i = last_task; i >= 0; i = via[i])
+            path.push_back(i);
+        std::reverse(path.begin(), path.end());
+
+        fprintf(f, "  %-22s %8.3f ms elapsed, speedup %5.2f over serial\n", label, elapsed * 1e3,
+                serial / elapsed);
+        fprintf(f, "  %-22s %d tasks, %ld edges; work %.3f ms, critical path %.3f ms,"
+                " parallelism %.1f\n", "", n, edges, work * 1e3, span * 1e3, work / span);
+        fprintf(f, "  %-22s critical path:", "");
+        for (size_t k = 0; k < path.size(); k++)
+            fprintf(f, "%s %s", k ? " ->" : "", tasks[path[k]].name.c_str());
+        fprintf(f, "\n");
+    }
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> fn;
+        std::vector<int> preds, succs;
+        double start, end;
+    };
+    struct Access {
+        int writer = -1;
+        std::vector<int> readers;
+    };
+    std::vector<Task> tasks;
+    std::unordered_map<const void *, Access> last;
+    double elapsed = 0.0;
+
+    void edge(int from, int to) {
+        if (from < 0 || from == to)
+            return;
+        std::vector<int> &p = tasks[to].preds;
+        if (std::find(p.begin(), p.end(), from) != p.end())
+            return;
+        p.push_back(from);
+        tasks[from].succs.push_back(to);
+    }
+
+    void execute(int i, double t0) {
+        Task &t = tasks[i];
+        t.start = omp_get_wtime() - t0;
+        t.fn();
+        t.end = omp_get_wtime() - t0;
+    }
+};
+
+#endif
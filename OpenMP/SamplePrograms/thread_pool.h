@@ -0,0 +1,159 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <climits>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+ * A fork/join pool whose threads are started once and then reused, so dispatching work
+ * costs a few cache-line transfers instead of waking a team for every parallel region.
+ *
+ * run(f) calls f(tid, nthreads) on every thread of the pool, including the caller as
+ * tid 0, and returns when all calls have finished. Idle workers spin on a generation
+ * counter for POOL_SPIN iterations, which keeps dispatch well under a microsecond
+ * while work arrives back to back, and then sleep on a futex so an idle pool costs no
+ * CPU time; a pool with more threads than cores sleeps right away. Only one thread
+ * may call run() at a time, and f must not call run().
+ *
+ * parallel_reduce() adds the size-aware part: inputs below a cutoff are reduced inline
+ * on the caller, because dispatching would cost more than it saves.
+ */
+
+#define POOL_SPIN         20000   /* pause iterations before an idle worker sleeps */
+#define POOL_MAX_THREADS  256
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+class ThreadPool {
+public:
+    explicit ThreadPool(int nthreads) : n(nthreads < 1 ? 1 : nthreads) {
+        if (n > POOL_MAX_THREADS)
+            n = POOL_MAX_THREADS;
+        /* With more threads than cores a spinning thread only delays the one it waits for */
+        spin = (n <= (int)std::thread::hardware_concurrency()) ? POOL_SPIN : 0;
+        for (int t = 1; t < n; t++)
+            workers.emplace_back([this, t] { worker(t); });
+    }
+
+    ~ThreadPool() {
+        stop.store(true, std::memory_order_relaxed);
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        wake();
+        for (auto &w : workers)
+            w.join();
+    }
+
+    int size() const { return n; }
+
+    template <typename F>
+    void run(F &&f) {
+        if (n == 1) {
+            f(0, 1);
+            return;
+        }
+        ctx = (void *)&f;
+        fn = [](void *c, int t, int nt) { (*(typename std::remove_reference<F>::type *)c)(t, nt); };
+        pending.store(n - 1, std::memory_order_relaxed);
+        epoch.fetch_add(1, std::memory_order_seq_cst);   /* publishes fn, ctx, pending */
+        if (sleepers.load(std::memory_order_seq_cst) > 0)
+            wake();
+
+        f(0, n);
+        for (int spins = 0; pending.load(std::memory_order_acquire) != 0; spins++) {
+            if (spins < spin)
+                cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    /* Sum of body(begin, end) over a split of [0, len) into one range per thread; runs
+       body(0, len) on the caller when len < serial_below */
+    template <typename T, typename Body>
+    T parallel_reduce(long len, long serial_below, T zero, Body body) {
+        if (len < serial_below || n == 1)
+            return body(0, len);
+        return reduce_on_pool(len, zero, body);
+    }
+
+private:
+    int n, spin;
+    std::vector<std::thread> workers;
+    alignas(64) std::atomic<unsigned> epoch{0};   /* bumped once per run(); the futex word */
+    alignas(64) std::atomic<int> pending{0};      /* workers still busy with this run */
+    alignas(64) std::atomic<int> sleepers{0};     /* workers asleep or about to sleep */
+    std::atomic<bool> stop{false};
+    void (*fn)(void *, int, int) = nullptr;
+    void *ctx = nullptr;
+
+    /* Kept out of parallel_reduce so the inline path does not set up the slot array */
+    template <typename T, typename Body>
+    __attribute__((noinline)) T reduce_on_pool(long len, T zero, Body &body) {
+        struct alignas(64) Slot { T v; };
+        Slot part[POOL_MAX_THREADS];
+        run([&](int t, int nt) {
+            part[t].v = body(len * t / nt, len * (t + 1) / nt);
+        });
+        T sum = zero;
+        for (int t = 0; t < n; t++)
+            sum = sum + part[t].v;
+        return sum;
+    }
+
+    void wake() {
+#if defined(__linux__)
+        syscall(SYS_futex, (unsigned *)&epoch, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+    }
+
+    /* Sleep while epoch still equals `seen`. The kernel re-checks the value, and run()
+       bumps epoch before it reads sleepers, so a wake-up can never be missed. */
+    void sleep(unsigned seen) {
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+#if defined(__linux__)
+        if (epoch.load(std::memory_order_seq_cst) == seen)
+            syscall(SYS_futex, (unsigned *)&epoch, FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+#else
+        std::this_thread::yield();
+#endif
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void worker(int t) {
+        unsigned seen = 0;
+        for (;;) {
+            unsigned e;
+            int spins = 0;
+            while ((e = epoch.load(std::memory_order_acquire)) == seen) {
+                if (++spins < spin) {
+                    cpu_relax();
+                } else {
+                    sleep(seen);
+                    spins = 0;
+                }
+            }
+            seen = e;
+            if (stop.load(std::memory_order_relaxed))
+                return;
+            fn(ctx, t, n);
+            pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef VEC_EXPR_H
+#define VEC_EXPR_H
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <utility>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Elementwise vector expressions that are evaluated lazily. `a + b * c` does no
+ * arithmetic; it builds a small object that can compute element i of the result. Only
+ * an assignment evaluates it, in one OpenMP-parallel SIMD loop, so a chain of operations
+ * reads every input once and writes the output once instead of sweeping memory once per
+ * operation.
+ *
+ *   c = (a + b) * (a - b) + 2.0 * a;            one fused pass
+ *   eval(STORE_STREAM, c << a + b, d << a * b); two outputs from one pass over a and b
+ *   double s = sum((a - b) * (a - b));          a fused reduction
+ *
+ * STORE_STREAM writes the outputs with non-temporal stores, which bypass the cache.
+ * This saves the read of each output line that a normal store performs first, and is
+ * worth it when the outputs are too big to stay in cache anyway.
+ *
+ * Vec storage is aligned to 64 bytes. It is first touched with the same static
+ * partition that eval() uses, so each page sits on the NUMA node of the thread that
+ * later works on it.
+ */
+
+#define VEC_ALIGN  64
+#define VEC_BLOCK  8           /* thread ranges start on multiples of this many elements */
+#define VEC_STREAM 256         /* elements computed into L1 before they are streamed out */
+
+enum StoreMode { STORE_CACHED, STORE_STREAM };
+
+template <typename E>
+struct Expr {
+    const E &self() const { return static_cast<const E &>(*this); }
+};
+
+/* Operands as they are stored inside an expression: vectors by pointer, scalars and
+   subexpressions by value */
+struct VecRef {
+    const double *p;
+    long n;
+    double operator[](long i) const { return p[i]; }
+    long size() const { return n; }
+};
+
+struct Scalar {
+    double v;
+    double operator[](long) const { return v; }
+    long size() const { return 0; }
+};
+
+/* First element of the share of [0, n) that thread t of nt works on, a multiple of
+   VEC_BLOCK so that every share starts on a cache line */
+inline long vec_split(long n, int t, int nt) {
+    if (t == nt)
+        return n;
+    return n * t / nt / VEC_BLOCK * VEC_BLOCK;
+}
+
+class Vec : public Expr<Vec> {
+public:
+    explicit Vec(long n, double init = 0.0) : n(n) {
+        p = (double *)aligned_alloc(VEC_ALIGN, (n * sizeof(double) + VEC_ALIGN - 1) / VEC_ALIGN * VEC_ALIGN);
+        #pragma omp parallel
+        {
+            int t = omp_get_thread_num(), nt = omp_get_num_threads();
+            for (long i = vec_split(n, t, nt); i < vec_split(n, t + 1, nt); i++)
+                p[i] = init;
+        }
+    }
+    ~Vec() { free(p); }
+    Vec(const Vec &) = delete;
+    Vec &operator=(const Vec &v);
+
+    template <typename E>
+    Vec &operator=(const Expr<E> &e);
+
+    long size() const { return n; }
+    double *data() { return p; }
+    const double *data() const { return p; }
+    double &operator[](long i) { return p[i]; }
+    double operator[](long i) const { return p[i]; }
+
+private:
+    double *p;
+    long n;
+};
+
+inline VecRef operand(const Vec &v) { return {v.data(), v.size()}; }
+inline Scalar operand(double v) { return {v}; }
+template <typename E>
+inline E operand(const Expr<E> &e) { return e.self(); }
+
+template <typename Op, typename L, typename R>
+struct Binary : Expr<Binary<Op, L, R>> {
+    L l;
+    R r;
+    Binary(L l, R r) : l(l), r(r) {}
+    double operator[](long i) const { return Op::apply(l[i], r[i]); }
+    long size() const { return l.size() > r.size() ? l.size() : r.size(); }
+};
+
+template <typename Op, typename A>
+struct Unary : Expr<Unary<Op, A>> {
+    A a;
+    explicit Unary(A a) : a(a) {}
+    double operator[](long i) const { return Op::apply(a[i]); }
+    long size() const { return a.size(); }
+};
+
+struct OpAdd { static double apply(double x, double y) { return x + y; } };
+struct OpSub { static double apply(double x, double y) { return x - y; } };
+struct OpMul { static double apply(double x, double y) { return x * y; } };
+struct OpDiv { static double apply(double x, double y) { return x / y; } };
+struct OpNeg { static double apply(double x) { return -x; } };
+struct OpSqrt { static double apply(double x) { return sqrt(x); } };
+
+/* Each operator accepts two expressions, or an expression and a double on either side */
+#define VEC_BINARY_OPERATOR(sym, Op)                                                      \
+    template <typename L, typename R>                                                     \
+    inline Binary<Op, decltype(operand(std::declval<L>())), decltype(operand(std::declval<R>()))> \
+    operator sym(const Expr<L> &l, const Expr<R> &r) {                                    \
+        return {operand(l.self()), operand(r.self())};                                    \
+    }                                                                                     \
+    template <typename L>                                                                 \
+    inline Binary<Op, decltype(operand(std::declval<L>())), Scalar>                       \
+    operator sym(const Expr<L> &l, double r) {                                            \
+        return {operand(l.self()), Scalar{r}};                                            \
+    }                                                                                     \
+    template <typename R>                                                                 \
+    inline Binary<Op, Scalar, decltype(operand(std::declval<R>()))>                       \
+    operator sym(double l, const Expr<R> &r) {                                            \
+        return {Scalar{l}, operand(r.self())};                                            \
+    }
+
+VEC_BINARY_OPERATOR(+, OpAdd)
+VEC_BINARY_OPERATOR(-, OpSub)
+VEC_BINARY_OPERATOR(*, OpMul)
+VEC_BINARY_OPERATOR(/, OpDiv)
+
+template <typename A>
+inline Unary<OpNeg, decltype(operand(std::declval<A>()))> operator-(const Expr<A> &a) {
+    return Unary<OpNeg, decltype(operand(std::declval<A>()))>(operand(a.self()));
+}
+
+template <typename A>
+inline Unary<OpSqrt, decltype(operand(std::declval<A>()))> sqrt(const Expr<A> &a) {
+    return Unary<OpSqrt, decltype(operand(std::declval<A>()))>(operand(a.self()));
+}
+
+/* One output of a fused loop, written `dst << expression` */
+template <typename E>
+struct Assign {
+    double *dst;
+    long n;
+    E e;
+};
+
+template <typename E>
+inline Assign<decltype(operand(std::declval<E>()))> operator<<(Vec &dst, const Expr<E> &e) {
+    assert(e.self().size() == dst.size());
+    return {dst.data(), dst.size(), operand(e.self())};
+}
+
+/* Non-temporal stores of a.e over [lo, hi), at most VEC_STREAM elements starting at a
+   multiple of VEC_BLOCK. The values are computed by a SIMD loop into a buffer that stays
+   in L1, then copied out with streaming stores. */
+template <typename E>
+inline void stream_block(const Assign<E> &a, long lo, long hi) {
+    alignas(VEC_ALIGN) double buf[VEC_STREAM];
+    long len = hi - lo, j = 0;
+    #pragma omp simd
+    for (long k = 0; k < len; k++)
+        buf[k] = a.e[lo + k];
+#if defined(__AVX__)
+    for (; j + 4 <= len; j += 4)
+        _mm256_stream_pd(a.dst + lo + j, _mm256_load_pd(buf + j));
+#elif defined(__SSE2__)
+    for (; j + 2 <= len; j += 2)
+        _mm_stream_pd(a.dst + lo + j, _mm_load_pd(buf + j));
+#endif
+    for (; j < len; j++)
+        a.dst[lo + j] = buf[j];
+}
+
+/* One thread's share of eval(). The outputs arrive by value, so their pointers are
+   private to the thread and stay in registers. */
+template <typename... E>
+void eval_range(StoreMode mode, long lo, long hi, Assign<E>... as) {
+    if (mode == STORE_STREAM) {
+        /* Every output of a block is produced while its inputs are still in L1 */
+        for (long b = lo; b < hi; b += VEC_STREAM) {
+            long e = b + VEC_STREAM < hi ? b + VEC_STREAM : hi;
+            (stream_block(as, b, e), ...);
+        }
+#if defined(__SSE2__)
+        _mm_sfence();
+#endif
+    } else {
+        #pragma omp simd
+        for (long i = lo; i < hi; i++)
+            ((as.dst[i] = as.e[i]), ...);
+    }
+}
+
+/* Evaluate every output in one parallel pass. The outputs are computed element by
+   element in the order given, so an output may read a vector an earlier one wrote. */
+template <typename... E>
+void eval(StoreMode mode, const Assign<E> &...as) {
+    long n = 0;
+    for (long m : {as.n...}) {
+        assert(n == 0 || m == n);
+        n = m;
+    }
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        eval_range(mode, vec_split(n, t, nt), vec_split(n, t + 1, nt), as...);
+    }
+}
+
+template <typename E>
+Vec &Vec::operator=(const Expr<E> &e) {
+    eval(STORE_CACHED, *this << e);
+    return *this;
+}
+
+inline Vec &Vec::operator=(const Vec &v) {
+    eval(STORE_CACHED, *this << v);
+    return *this;
+}
+
+template <typename E>
+double sum(const Expr<E> &expr) {
+    auto e = operand(expr.self());
+    long n = e.size();
+    double s = 0.0;
+    #pragma omp parallel reduction(+:s)
+    {
+        auto mine = e;              /* a private copy keeps its pointers in registers */
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        long hi = vec_split(n, t + 1, nt);
+        #pragma omp simd reduction(+:s)
+        for (long i = vec_split(n, t, nt); i < hi; i++)
+            s += mine[i];
+    }
+    return s;
+}
+
+#endif
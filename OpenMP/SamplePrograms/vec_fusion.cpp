@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "vec_expr.h"
+
+#define N     100000000   /* Default vector length */
+#define REPS  5           /* Default timed repetitions per variant */
+
+/*
+ * Fused against unfused elementwise code. Every variant computes the same result; the
+ * unfused ones are written one loop per statement, the way sections.cpp and do_for.cpp
+ * are, and the fused ones as a single expression.
+ *
+ * The traffic column is the memory traffic a variant needs in vectors of n doubles:
+ * every input read and output written, plus one extra read per output written with
+ * normal stores, because a normal store first loads the line it writes.
+ */
+
+/* Fastest of `reps` calls after one warm-up call */
+template <typename F>
+double timed(int reps, F f) {
+    f();
+    double best = 1e30;
+    for (int r = 0; r < reps; r++) {
+        double t = omp_get_wtime();
+        f();
+        best = fmin(best, omp_get_wtime() - t);
+    }
+    return best;
+}
+
+void report(const char *name, double t, double traffic, long n, double base, double err) {
+    double bytes = traffic * 8.0 * n;
+    printf("  %-34s %9.2f %9.1f %9.2f %8.2fx   %.1e\n", name, t * 1e3, traffic,
+           bytes / t / 1e9, base / t, err);
+}
+
+/* Largest deviation of x from f(i), checked on every 997th element */
+template <typename F>
+double check(const Vec &x, F f) {
+    double err = 0.0;
+    for (long i = 0; i < x.size(); i += 997)
+        err = fmax(err, fabs(x[i] - f(i)));
+    return err;
+}
+
+int main(int argc, char *argv[]) {
+    long n = (argc > 1) ? atol(argv[1]) : N;
+    int reps = (argc > 2) ? atoi(argv[2]) : REPS;
+    int numThreads = (argc > 3) ? atoi(argv[3]) : 0;
+
+    if (numThreads > 0) {
+        omp_set_dynamic(0);
+        omp_set_num_threads(numThreads);
+    }
+
+    Vec a(n), b(n), c(n), d(n);
+    double *pa = a.data(), *pb = b.data(), *pc = c.data(), *pd = d.data();
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < n; i++) {
+        pa[i] = 1.0 + (i % 1000) * 1e-3;
+        pb[i] = 2.0 - (i % 777) * 1e-3;
+    }
+    auto A = [&](long i) { return 1.0 + (i % 1000) * 1e-3; };
+    auto B = [&](long i) { return 2.0 - (i % 777) * 1e-3; };
+
+    printf("\n  n = %ld doubles (%.0f MB per vector), %d threads\n", n, 8e-6 * n,
+           omp_get_max_threads());
+    printf("  %-34s %9s %9s %9s %9s   %s\n", "variant", "ms", "traffic", "GB/s", "speedup",
+           "max error");
+
+    /* sections.cpp: c = a + b and d = a * b */
+    printf("\n  c = a + b, d = a * b\n");
+    double t0 = timed(reps, [&] {
+        #pragma omp parallel for simd schedule(static)
+        for (long i = 0; i < n; i++)
+            pc[i] = pa[i] + pb[i];
+        #pragma omp parallel for simd schedule(static)
+        for (long i = 0; i < n; i++)
+            pd[i] = pa[i] * pb[i];
+    });
+    auto err2 = [&] {
+        return fmax(check(c, [&](long i) { return A(i) + B(i); }),
+                    check(d, [&](long i) { return A(i) * B(i); }));
+    };
+    report("two loops", t0, 8, n, t0, err2());
+    double t = timed(reps, [&] { eval(STORE_CACHED, c << a + b, d << a * b); });
+    report("fused", t, 6, n, t0, err2());
+    t = timed(reps, [&] { eval(STORE_STREAM, c << a + b, d << a * b); });
+    report("fused, streaming stores", t, 4, n, t0, err2());
+
+    /* A chain of operations with one output */
+    printf("\n  c = (a + b) * (a - b) + 2 a\n");
+    auto chain = [&](long i) { return (A(i) + B(i)) * (A(i) - B(i)) + 2.0 * A(i); };
+    t0 = timed(reps, [&] {
+        c = a + b;
+        d = a - b;
+        c = c * d;
+        d = 2.0 * a;
+        c = c + d;
+    });
+    report("one statement per operation", t0, 19, n, t0, check(c, chain));
+    t = timed(reps, [&] { c = (a + b) * (a - b) + 2.0 * a; });
+    report("fused", t, 4, n, t0, check(c, chain));
+    t = timed(reps, [&] { eval(STORE_STREAM, c << (a + b) * (a - b) + 2.0 * a); });
+    report("fused, streaming stores", t, 3, n, t0, check(c, chain));
+
+    /* A reduction over an expression */
+    printf("\n  s = sum((a - b)^2)\n");
+    double ref = 0.0;
+    for (long i = 0; i < n; i++)
+        ref += (A(i) - B(i)) * (A(i) - B(i));
+    double s = 0.0;
+    t0 = timed(reps, [&] {
+        d = a - b;
+        s = sum(d * d);
+    });
+    report("temporary d = a - b", t0, 5, n, t0, fabs(s - ref) / ref);
+    t = timed(reps, [&] { s = sum((a - b) * (a - b)); });
+    report("fused", t, 2, n, t0, fabs(s - ref) / ref);
+    return 0;
+}